@@ -4,3 +4,5 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE(FDefaultGameModuleImpl, Minesweeper3D, "Minesweeper3D");
+
+DEFINE_LOG_CATEGORY(LogMinesweeper3D);
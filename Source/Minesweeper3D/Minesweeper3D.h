@@ -3,3 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogMinesweeper3D, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("Minesweeper3D"), STATGROUP_Minesweeper3D, STATCAT_Advanced);
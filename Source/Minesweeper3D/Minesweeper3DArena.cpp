@@ -0,0 +1,148 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DArena.h"
+#include "Minesweeper3D.h"
+#include "Misc/CoreDelegates.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Arena allocations"), STAT_ArenaAllocations, STATGROUP_Minesweeper3D);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Arena bytes allocated"), STAT_ArenaBytesAllocated, STATGROUP_Minesweeper3D);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Arena heap allocations"), STAT_ArenaHeapAllocations, STATGROUP_Minesweeper3D);
+DECLARE_MEMORY_STAT(TEXT("Arena memory reserved"), STAT_ArenaMemoryReserved, STATGROUP_Minesweeper3D);
+DECLARE_CYCLE_STAT(TEXT("Arena heap allocation"), STAT_ArenaHeapAllocation, STATGROUP_Minesweeper3D);
+
+FMinesweeper3DArena::FMinesweeper3DArena(SIZE_T InBlockSize)
+	: BlockSize(InBlockSize)
+{
+}
+
+FMinesweeper3DArena::~FMinesweeper3DArena()
+{
+	FreeBlocks();
+}
+
+FMinesweeper3DArena::FMinesweeper3DArena(FMinesweeper3DArena&& Other)
+	: BlockSize(Other.BlockSize)
+{
+	*this = MoveTemp(Other);
+}
+
+FMinesweeper3DArena& FMinesweeper3DArena::operator=(FMinesweeper3DArena&& Other)
+{
+	if (this == &Other)	return *this;
+
+	//The blocks themselves don't move, so anything already handed out of Other stays where it is
+	FreeBlocks();
+	BlockSize = Other.BlockSize;
+	BytesReserved = Other.BytesReserved;
+	Blocks = MoveTemp(Other.Blocks);
+	CurrentBlock = Other.CurrentBlock;
+	Cursor = Other.Cursor;
+	End = Other.End;
+
+	Other.BytesReserved = 0;
+	Other.Blocks.Reset();
+	Other.CurrentBlock = INDEX_NONE;
+	Other.Cursor = nullptr;
+	Other.End = nullptr;
+	return *this;
+}
+
+void FMinesweeper3DArena::FreeBlocks()
+{
+	for (const FBlock& Block : Blocks)
+	{
+		FMemory::Free(Block.Data);
+	}
+	DEC_MEMORY_STAT_BY(STAT_ArenaMemoryReserved, BytesReserved);
+
+	BytesReserved = 0;
+	Blocks.Reset();
+	CurrentBlock = INDEX_NONE;
+	Cursor = nullptr;
+	End = nullptr;
+}
+
+void FMinesweeper3DArena::Reset()
+{
+	//Oversized blocks were one big request each, and a flood's worklist regrowing can leave several, so they go back to the
+	//heap rather than pin the biggest frame or board there's been. Standard blocks are kept up to the cap.
+	int32 NumKept = 0;
+	for (int32 Index = 0; Index < Blocks.Num(); Index++)
+	{
+		const FBlock& Block = Blocks[Index];
+		if (Block.Size <= BlockSize && NumKept < MaxKeptBlocks)
+		{
+			Blocks[NumKept++] = Block;
+			continue;
+		}
+
+		FMemory::Free(Block.Data);
+		BytesReserved -= Block.Size;
+		DEC_MEMORY_STAT_BY(STAT_ArenaMemoryReserved, Block.Size);
+	}
+	Blocks.SetNum(NumKept, false);
+
+	if (Blocks.Num() == 0)
+	{
+		CurrentBlock = INDEX_NONE;
+		Cursor = nullptr;
+		End = nullptr;
+		return;
+	}
+
+	CurrentBlock = 0;
+	Cursor = Blocks[0].Data;
+	End = Cursor + Blocks[0].Size;
+}
+
+void FMinesweeper3DArena::CountAlloc(SIZE_T Size)
+{
+	INC_DWORD_STAT(STAT_ArenaAllocations);
+	INC_DWORD_STAT_BY(STAT_ArenaBytesAllocated, Size);
+}
+
+//The slow path: move on to the next kept block that fits, or get a new one from the heap
+void* FMinesweeper3DArena::AllocFromNewBlock(SIZE_T Size, SIZE_T Alignment)
+{
+	const SIZE_T Needed = Size + Alignment;
+	for (int32 Next = CurrentBlock + 1; Next < Blocks.Num(); Next++)
+	{
+		if (Blocks[Next].Size < Needed)	continue;
+
+		//Skipped blocks stay where they are and come round again after the next reset
+		Swap(Blocks[CurrentBlock + 1], Blocks[Next]);
+		CurrentBlock++;
+		Cursor = Blocks[CurrentBlock].Data;
+		End = Cursor + Blocks[CurrentBlock].Size;
+		return Alloc(Size, Alignment);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ArenaHeapAllocation);
+	INC_DWORD_STAT(STAT_ArenaHeapAllocations);
+
+	//Oversized requests get a block of their own
+	FBlock Block;
+	Block.Size = FMath::Max(BlockSize, Needed);
+	Block.Data = (uint8*)FMemory::Malloc(Block.Size);
+	BytesReserved += Block.Size;
+	INC_MEMORY_STAT_BY(STAT_ArenaMemoryReserved, Block.Size);
+
+	CurrentBlock++;
+	Blocks.Insert(Block, CurrentBlock);
+	Cursor = Block.Data;
+	End = Cursor + Block.Size;
+	return Alloc(Size, Alignment);
+}
+
+FMinesweeper3DArena& FMinesweeper3DArena::GetFrame()
+{
+	check(IsInGameThread());
+
+	static FMinesweeper3DArena* FrameArena = nullptr;
+	if (!FrameArena)
+	{
+		FrameArena = new FMinesweeper3DArena();
+		FCoreDelegates::OnEndFrame.AddLambda([]() { FrameArena->Reset(); });
+	}
+	return *FrameArena;
+}
@@ -0,0 +1,149 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Bump allocator for buffers that all die together: the scratch of one game's generation, or one frame's reveal
+ * worklists. Nothing is freed on its own. Reset() rewinds to the start and keeps up to MaxKeptBlocks standard blocks, so
+ * once an arena has grown to what a frame's small allocations need, later frames never touch the heap. Requests bigger
+ * than a block get one of their own, which goes back to the heap at the next Reset().
+ * Not thread safe. An arena belongs to one thread at a time, the frame arena to the game thread.
+ */
+class FMinesweeper3DArena
+{
+public:
+	explicit FMinesweeper3DArena(SIZE_T InBlockSize = 64 * 1024);
+	~FMinesweeper3DArena();
+
+	FMinesweeper3DArena(FMinesweeper3DArena&& Other);
+	FMinesweeper3DArena& operator=(FMinesweeper3DArena&& Other);
+	FMinesweeper3DArena(const FMinesweeper3DArena&) = delete;
+	FMinesweeper3DArena& operator=(const FMinesweeper3DArena&) = delete;
+
+	FORCEINLINE void* Alloc(SIZE_T Size, SIZE_T Alignment)
+	{
+		uint8* Result = Align(Cursor, Alignment);
+		if (Result + Size > End)	return AllocFromNewBlock(Size, Alignment);
+
+		Cursor = Result + Size;
+		CountAlloc(Size);
+		return Result;
+	}
+
+	//Uninitialised space for Num elements, valid until the next Reset()
+	template<typename ElementType>
+	FORCEINLINE TArrayView<ElementType> AllocArray(int32 Num)
+	{
+		return TArrayView<ElementType>((ElementType*)Alloc(Num * sizeof(ElementType), alignof(ElementType)), Num);
+	}
+
+	//Rewinds to the first block. Everything allocated so far is gone, and oversized blocks and any past the cap with it.
+	void Reset();
+
+	//Standard blocks kept across a Reset(), so one unusually busy frame doesn't pin its peak for good
+	static constexpr int32 MaxKeptBlocks = 16;
+
+	SIZE_T GetBytesReserved() const { return BytesReserved; }
+
+	//Game thread scratch, reset at the end of every frame
+	static FMinesweeper3DArena& GetFrame();
+
+private:
+	struct FBlock
+	{
+		uint8* Data;
+		SIZE_T Size;
+	};
+
+	void* AllocFromNewBlock(SIZE_T Size, SIZE_T Alignment);
+	void CountAlloc(SIZE_T Size);
+	void FreeBlocks();
+
+	SIZE_T BlockSize;
+	SIZE_T BytesReserved = 0;
+
+	//Blocks past CurrentBlock are kept from before the last reset and are used again before anything new is allocated
+	TArray<FBlock> Blocks;
+	int32 CurrentBlock = INDEX_NONE;
+	uint8* Cursor = nullptr;
+	uint8* End = nullptr;
+};
+
+/**
+ * TArray allocator that draws from the frame arena, for worklists and cell lists that don't outlive the frame they're
+ * made in. Growing copies into fresh arena space and leaves the old space for the end of frame reset. Game thread only.
+ */
+class FMinesweeper3DFrameAllocator
+{
+public:
+	using SizeType = int32;
+
+	enum { NeedsElementType = true };
+	enum { RequireRangeCheck = true };
+
+	template<typename ElementType>
+	class ForElementType
+	{
+	public:
+		ForElementType() : Data(nullptr) {}
+
+		FORCEINLINE void MoveToEmpty(ForElementType& Other)
+		{
+			checkSlow(this != &Other);
+			Data = Other.Data;
+			Other.Data = nullptr;
+		}
+
+		FORCEINLINE ElementType* GetAllocation() const { return Data; }
+
+		void ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement)
+		{
+			checkSlow(IsInGameThread());
+
+			ElementType* OldData = Data;
+			Data = nullptr;
+			if (NumElements > 0)
+			{
+				Data = (ElementType*)FMinesweeper3DArena::GetFrame().Alloc(NumElements * NumBytesPerElement, FMath::Max<SIZE_T>(alignof(ElementType), 4));
+				if (OldData && PreviousNumElements > 0)	FMemory::Memcpy(Data, OldData, FMath::Min(PreviousNumElements, NumElements) * NumBytesPerElement);
+			}
+		}
+
+		SizeType CalculateSlackReserve(SizeType NumElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NumElements, NumBytesPerElement, false);
+		}
+
+		SizeType CalculateSlackShrink(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			//Shrinking gives nothing back to an arena, so don't bother copying
+			return NumAllocatedElements;
+		}
+
+		SizeType CalculateSlackGrow(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NumElements, NumAllocatedElements, NumBytesPerElement, false);
+		}
+
+		SIZE_T GetAllocatedSize(SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements * NumBytesPerElement;
+		}
+
+		bool HasAllocation() const { return Data != nullptr; }
+		SizeType GetInitialCapacity() const { return 0; }
+
+	private:
+		ElementType* Data;
+	};
+
+	typedef ForElementType<FScriptContainerElement> ForAnyElementType;
+};
+
+template<>
+struct TAllocatorTraits<FMinesweeper3DFrameAllocator> : TAllocatorTraitsBase<FMinesweeper3DFrameAllocator>
+{
+	enum { SupportsMove = true };
+};
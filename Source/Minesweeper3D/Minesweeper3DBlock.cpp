@@ -13,6 +13,7 @@ AMinesweeper3DBlock::AMinesweeper3DBlock()
 	struct FConstructorStatics
 	{
 		ConstructorHelpers::FObjectFinderOptional<UStaticMesh> PlaneMesh;
+		ConstructorHelpers::FObjectFinderOptional<UMaterialInterface> NumberAtlasMaterial;
 		ConstructorHelpers::FObjectFinderOptional<UMaterial> BaseMaterial;
 		ConstructorHelpers::FObjectFinderOptional<UMaterialInstance> BlueMaterial;
 		ConstructorHelpers::FObjectFinderOptional<UMaterialInstance> OrangeMaterial;
@@ -20,7 +21,9 @@ AMinesweeper3DBlock::AMinesweeper3DBlock()
 			//: PlaneMesh(TEXT("/Game/Puzzle/Meshes/PuzzleCube.PuzzleCube"))
 			//: PlaneMesh(TEXT("/Game/Geometry/Meshes/1M_Cube"))
 			//: PlaneMesh(TEXT("/Game/Geometry/Meshes/cube_1"))
-			: PlaneMesh(TEXT("/Game/Geometry/Meshes/blank_cube"))
+			//: PlaneMesh(TEXT("/Game/Geometry/Meshes/blank_cube"))
+			: PlaneMesh(TEXT("/Game/Geometry/Meshes/number_cube"))
+			, NumberAtlasMaterial(TEXT("/Game/Geometry/Materials/M_NumberAtlas.M_NumberAtlas"))
 			, BaseMaterial(TEXT("/Game/Puzzle/Meshes/BaseMaterial.BaseMaterial"))
 			, BlueMaterial(TEXT("/Game/Puzzle/Meshes/BlueMaterial.BlueMaterial"))
 			, OrangeMaterial(TEXT("/Game/Puzzle/Meshes/OrangeMaterial.OrangeMaterial"))
@@ -35,7 +38,9 @@ AMinesweeper3DBlock::AMinesweeper3DBlock()
 
 	// Create static mesh component
 	BlockMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("BlockMesh0"));
+	//Every block shares this mesh and material whatever it's showing, so they all draw as one batch
 	BlockMesh->SetStaticMesh(ConstructorStatics.PlaneMesh.Get());
+	BlockMesh->SetMaterial(0, ConstructorStatics.NumberAtlasMaterial.Get());
 	BlockMesh->SetRelativeScale3D(FVector(0.5f, 0.5f, 0.5f));	//turns out the default cube in blender is twice the size of the 1m_cube in unreal
 	BlockMesh->SetRelativeLocation(FVector(0.f,0.f,25.f));
 	//BlockMesh->SetMaterial(0, ConstructorStatics.BlueMaterial.Get());
@@ -47,9 +52,6 @@ AMinesweeper3DBlock::AMinesweeper3DBlock()
 	BaseMaterial = ConstructorStatics.BaseMaterial.Get();
 	BlueMaterial = ConstructorStatics.BlueMaterial.Get();
 	OrangeMaterial = ConstructorStatics.OrangeMaterial.Get();
-	ConstructorHelpers::FObjectFinderOptional<UStaticMesh> Flag(TEXT("/Game/Geometry/Meshes/flag_cube"));
-	FlagMesh = Flag.Get();
-	DefaultMesh = ConstructorStatics.PlaneMesh.Get();
 }
 
 void AMinesweeper3DBlock::BlockClicked(UPrimitiveComponent* ClickedComp, FKey ButtonClicked)
@@ -67,99 +69,106 @@ void AMinesweeper3DBlock::OnFingerPressedBlock(ETouchIndex::Type FingerIndex, UP
 
 void AMinesweeper3DBlock::Flag()
 {
-	if (BlockState == State::flagged)
-	{
-		BlockState = State::hidden;
-		BlockMesh->SetStaticMesh(DefaultMesh);
-		OwningGrid->MinesRemaining++;
-	}
-	else if(BlockState == State::hidden && OwningGrid->MinesRemaining > 0)
-	{
-		BlockState = State::flagged;
-		BlockMesh->SetStaticMesh(FlagMesh);
-		OwningGrid->MinesRemaining--;
-	}
+	OwningGrid->RequestFlag(this);
 }
 
 void AMinesweeper3DBlock::Reveal()
 {
 	if (BlockState == State::revealed || BlockState == State::flagged)	return;
 
-	//Generate mines on the first click so you don't immediately explode
-	if (OwningGrid->bFirstClick)
-	{
-		OwningGrid->FinishSetup(this);
-		OwningGrid->bFirstClick = false;
-	}
+	OwningGrid->RequestReveal(this);
+}
 
-	if (bIsMine)
-	{
-		if (!OwningGrid->bGameLost)
-		{
-			OwningGrid->bGameLost = true;
-			OwningGrid->RevealMines();
-		}
-		BlockMesh->SetStaticMesh(OwningGrid->NumberFaces[0]);
-		/*if (GEngine)
-		{
-			GEngine->AddOnScreenDebugMessage(-1, 2.f, FColor::Yellow, FString::Printf(TEXT("BOOM!!!!")));
-		}*/
-		BlockState = State::revealed;
-	}
-	else
-	{
-		BlockState = State::revealed;
-		BlockMesh->SetRelativeScale3D(FVector(0.25f, 0.25f, 0.25f));
-		OwningGrid->BlocksRemaining--;
+void AMinesweeper3DBlock::ShowFlagged(bool bFlagged)
+{
+	BlockState = bFlagged ? State::flagged : State::hidden;
+	RefreshCustomData();
+}
 
-		/*if (GEngine)
-		{
-			GEngine->AddOnScreenDebugMessage(-1, 2.f, FColor::Yellow, FString::Printf(TEXT("Surrounding Mines: %d"), this->NumSurroundingMines));
-		}*/
+void AMinesweeper3DBlock::ShowHidden()
+{
+	if (BlockState == State::revealed && NumSurroundingMines > 0)	OwningGrid->RemoveNumberedBlock(this);
 
-		if (NumSurroundingMines == 0)
-		{
-			RevealAdjacentBlocks();
-			this->Destroy();
-		}
-		BlockMesh->SetStaticMesh(OwningGrid->NumberFaces[NumSurroundingMines]);
-		OwningGrid->CheckForWin();
-	}
+	BlockState = State::hidden;
+	NumSurroundingMines = -1;
+	bDetailed = false;
+	RefreshCustomData();
+	RefreshVisibility();
 }
 
-void AMinesweeper3DBlock::RevealAdjacentBlocks()
+void AMinesweeper3DBlock::ResetBlock()
 {
-	for (int x = -1; x < 2; x++)
-	{
-		for (int y = -1; y < 2; y++)
-		{
-			for (int z = -1; z < 2; z++)
-			{
-				if (x == 0 && y == 0 && z == 0)	continue;	//ignore the calling block
-
-				if (OwningGrid->CheckBlockBounds(Xpos + x, Ypos + y, Zpos + z))
-				{
-					OwningGrid->Blocks[Xpos + x][Ypos + y][Zpos + z]->Reveal();
-				}
-			}
-		}
-	}
+	BlockState = State::hidden;
+	NumSurroundingMines = -1;
+	bDetailed = false;
+	bHighlighted = false;
+	View = SliceView::inSlice;
+	RefreshCustomData();
+	RefreshVisibility();
+}
+
+void AMinesweeper3DBlock::ShowRevealed(int32 SurroundingMines)
+{
+	BlockState = State::revealed;
+	NumSurroundingMines = SurroundingMines;
+	//Starts out as a flat colour, the grid's next LOD pass decides whether it's close enough for the digit
+	bDetailed = false;
+	RefreshCustomData();
+	RefreshVisibility();
+
+	if (NumSurroundingMines > 0)	OwningGrid->AddNumberedBlock(this);
+}
+
+void AMinesweeper3DBlock::SetDetailed(bool bNewDetailed)
+{
+	if (bDetailed == bNewDetailed || BlockState != State::revealed || NumSurroundingMines <= 0)	return;
+
+	bDetailed = bNewDetailed;
+	RefreshCustomData();
+}
+
+void AMinesweeper3DBlock::RefreshCustomData()
+{
+	//One write for the lot, each write marks the primitive dirty. Count is -1 for mines and for blocks we don't know yet.
+	BlockMesh->SetCustomPrimitiveDataVector4(countSlot, FVector4(
+		(float)NumSurroundingMines,
+		(float)BlockState,
+		bHighlighted ? 1.f : 0.f,
+		bDetailed ? 1.f : 0.f));
+}
+
+void AMinesweeper3DBlock::SetSliceView(SliceView NewView)
+{
+	if (View == NewView)	return;
+
+	View = NewView;
+	RefreshVisibility();
+}
+
+void AMinesweeper3DBlock::RefreshVisibility()
+{
+	//The grid has already flooded out from a revealed zero, there's nothing left to show.
+	//Hidden rather than destroyed so undo can bring it back.
+	const bool bEmpty = BlockState == State::revealed && NumSurroundingMines == 0;
+	const bool bVisible = !bEmpty && View != SliceView::outOfSlice;
+
+	SetActorHiddenInGame(!bVisible);
+	//Ghosts are only there for context, clicks go through them
+	SetActorEnableCollision(bVisible && View == SliceView::inSlice);
+
+	float Scale = (BlockState == State::revealed && NumSurroundingMines > 0) ? 0.25f : 0.5f;
+	if (View == SliceView::ghost)	Scale *= GhostScale;
+	BlockMesh->SetRelativeScale3D(FVector(Scale, Scale, Scale));
+	BlockMesh->SetCastShadow(View != SliceView::ghost);
 }
 
 void AMinesweeper3DBlock::Highlight(bool bOn)
 {
-	// Do not highlight if the block has already been activated.
-	/*if (bIsActive)
-	{
-		return;
-	}*/
+	//Focused blocks always get their full number detail
+	OwningGrid->SetFocusedBlock(this, bOn);
 
-	if (bOn)
-	{
-		//BlockMesh->SetMaterial(0, BaseMaterial);
-	}
-	else
-	{
-		//BlockMesh->SetMaterial(0, BlueMaterial);
-	}
+	//Just a data write for the atlas material, the block keeps its mesh and material so it stays in the batch
+	if (bHighlighted == bOn)	return;
+	bHighlighted = bOn;
+	RefreshCustomData();
 }
@@ -6,6 +6,24 @@
 #include "GameFramework/Actor.h"
 #include "Minesweeper3DBlock.generated.h"
 
+/**
+ * Refers to the block drawing one board cell: the cell's flat index plus the generation of the grid's slot for it.
+ * The grid bumps the generation whenever it takes the block off that cell, so a handle held past then stops resolving
+ * instead of pointing at whatever block is there now.
+ */
+struct FMinesweeper3DBlockHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Generation = 0;
+
+	FMinesweeper3DBlockHandle() {}
+	FMinesweeper3DBlockHandle(int32 InIndex, uint32 InGeneration) : Index(InIndex), Generation(InGeneration) {}
+
+	FORCEINLINE bool IsSet() const { return Index != INDEX_NONE; }
+	FORCEINLINE bool operator==(const FMinesweeper3DBlockHandle& Other) const { return Index == Other.Index && Generation == Other.Generation; }
+	FORCEINLINE bool operator!=(const FMinesweeper3DBlockHandle& Other) const { return !(*this == Other); }
+};
+
 /** A block that can be clicked */
 UCLASS(minimalapi)
 class AMinesweeper3DBlock : public AActor
@@ -28,23 +46,26 @@ public:
 
 	State BlockState = hidden;
 
-	bool bIsMine;
+	/** How the grid's slice mode wants this block drawn */
+	enum SliceView{inSlice, ghost, outOfSlice};
 
-	bool bIsRevealed;
+	SliceView View = inSlice;
 
-	//Assigned to blocks surrounding the first block clicked to ensure they don't become mines
-	bool bGenerationSafelock = false;
+	//Ghosts from neighbouring layers are drawn this much smaller than a normal block
+	static constexpr float GhostScale = 0.3f;
 
-	UPROPERTY()
-	int Xpos;
+	//Whether a revealed count is drawn with its digit or as a plain colour coded face
+	bool bDetailed = false;
 
-	UPROPERTY()
-	int Ypos;
+	bool bHighlighted = false;
 
-	UPROPERTY()
-	int Zpos;
+	/** Per-primitive data slots read by the number atlas material */
+	enum CustomData{countSlot, stateSlot, highlightSlot, detailSlot};
+
+	//The cell this block is placed on. Unset while the block is sitting in the grid's pool.
+	FMinesweeper3DBlockHandle Handle;
 
-	//Only mines should have a -1 after all the blocks are updated
+	//Only known once the grid has revealed this block. Mines are -1.
 	int NumSurroundingMines = -1;
 
 	/** Pointer to white material used on the focused block */
@@ -59,10 +80,6 @@ public:
 	UPROPERTY()
 	class UMaterialInstance* OrangeMaterial;
 
-	class UStaticMesh* FlagMesh;
-
-	class UStaticMesh* DefaultMesh;
-
 	/** Grid that owns us */
 	UPROPERTY()
 	class AMinesweeper3DBlockGrid* OwningGrid;
@@ -81,7 +98,20 @@ public:
 
 	void Highlight(bool bOn);
 
-	void RevealAdjacentBlocks();
+	//Show the result of a reveal or flag the grid has already validated
+	void ShowRevealed(int32 SurroundingMines);
+	void ShowFlagged(bool bFlagged);
+	void ShowHidden();
+	//Puts a pooled block back to a fresh hidden block, ready for the grid to place on a new board
+	void ResetBlock();
+	void SetSliceView(SliceView NewView);
+	void SetDetailed(bool bNewDetailed);
+
+	//Writes count, state, highlight and detail into the custom data the atlas material draws the face from
+	void RefreshCustomData();
+
+	//Applies visibility, collision and scale for the current state and slice view
+	void RefreshVisibility();
 
 public:
 	/** Returns DummyRoot subobject **/
@@ -1,6 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "Minesweeper3DBlockGrid.h"
+#include "Minesweeper3D.h"
 #include "Minesweeper3DBlock.h"
 #include "Components/TextRenderComponent.h"
 #include "GameFramework/SpringArmComponent.h"
@@ -9,6 +10,22 @@
 #include "Camera/CameraActor.h"
 #include "Kismet/GameplayStatics.h"
 #include "Containers/UnrealString.h"
+#include "Net/UnrealNetwork.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/Texture2D.h"
+#include "Materials/Material.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/CommandLine.h"
+#include "Async/Async.h"
+#include "ProceduralMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Board delta bytes"), STAT_BoardDeltaBytes, STATGROUP_Minesweeper3D);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Board delta cells"), STAT_BoardDeltaCells, STATGROUP_Minesweeper3D);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Detailed number blocks"), STAT_DetailedNumberBlocks, STATGROUP_Minesweeper3D);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunk builds in flight"), STAT_ChunkBuildsInFlight, STATGROUP_Minesweeper3D);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Chunk triangles"), STAT_ChunkTriangles, STATGROUP_Minesweeper3D);
+DECLARE_CYCLE_STAT(TEXT("Update block LODs"), STAT_UpdateBlockLODs, STATGROUP_Minesweeper3D);
 
 #define LOCTEXT_NAMESPACE "PuzzleBlockGrid"
 
@@ -20,10 +37,15 @@ AMinesweeper3DBlockGrid::AMinesweeper3DBlockGrid()
 	DummyRoot = CreateDefaultSubobject<USceneComponent>(TEXT("Dummy0"));
 	RootComponent = DummyRoot;
 
+	//The camera only needs to tick while it's moving, input and reveals wake it up
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
 	// Set defaults
 	BlockSpacing = 100.f;	//size of the 1M_Cube in unreal units
-	theta = 3.14f / 4;
-	phi = -3.14f / 4;
+	theta = TargetTheta = PI / 4;
+	phi = TargetPhi = -PI / 4;
+	radius = TargetRadius = 0.f;
 
 	//menu widgets
 	ConstructorHelpers::FClassFinder<UUserWidget> Settings(TEXT("/Game/Geometry/Meshes/Settings.Settings_C"));
@@ -33,27 +55,27 @@ AMinesweeper3DBlockGrid::AMinesweeper3DBlockGrid()
 	if (HUD.Class) HUDWidget = HUD.Class;
 	if (CustomSettings.Class) CustomSettingsWidget = CustomSettings.Class;
 
-	//Get materials for block faces
-	ConstructorHelpers::FObjectFinderOptional<UStaticMesh> mine(TEXT("/Game/Geometry/Meshes/mine_cube"));
-	NumberFaces.Add(mine.Get());
-
-	for (int i = 1; i <= 26; i++)
-	{
-		FString path = "/Game/Geometry/Meshes/";
-		path.Append(FString::FromInt(i));
-		path.Append("_cube");
-		ConstructorHelpers::FObjectFinderOptional<UStaticMesh> cube(*path);
-		NumberFaces.Add(cube.Get());
-	}
-
+	static ConstructorHelpers::FObjectFinder<UMaterialInterface> ChunkSurface(TEXT("/Game/Geometry/Materials/M_ChunkSurface.M_ChunkSurface"));
+	ChunkMaterial = ChunkSurface.Object;
 }
 
 void AMinesweeper3DBlockGrid::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
-	//if(!bIsFreeCam)	
-	UpdateCameraPosition();
+	//Only the player controlling this grid has a camera to move
+	if (!Camera)
+	{
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	const bool bCameraMoving = UpdateCameraPosition(DeltaSeconds);
+	if (bEndlessMode)	UpdateEndlessStreaming(false);
+	UpdateBlockLODs();
+
+	//Nothing left to animate, sleep until the next input wakes us
+	if (!bCameraMoving && !bLODDirty)	SetActorTickEnabled(false);
 	/*if (GEngine)
 	{
 		GEngine->AddOnScreenDebugMessage(-1, DeltaSeconds, FColor::Yellow, FString::Printf(TEXT("X: %f, Y: %f, Z: %f, Radius: %f"),
@@ -73,6 +95,10 @@ void AMinesweeper3DBlockGrid::SetupPlayerInputComponent(UInputComponent* PlayerI
 	InputComponent->BindAction("FreeCam", IE_Pressed, this, &AMinesweeper3DBlockGrid::EnableMousePanning);
 	InputComponent->BindAction("FreeCam", IE_Released, this, &AMinesweeper3DBlockGrid::DisableMousePanning);
 	InputComponent->BindAction("Reset", IE_Pressed, this, &AMinesweeper3DBlockGrid::StartGame);
+	InputComponent->BindAction("Undo", IE_Pressed, this, &AMinesweeper3DBlockGrid::Undo);
+	InputComponent->BindAction("Redo", IE_Pressed, this, &AMinesweeper3DBlockGrid::Redo);
+	InputComponent->BindAction("SliceMode", IE_Pressed, this, &AMinesweeper3DBlockGrid::ToggleSliceMode);
+	InputComponent->BindAction("SliceAxis", IE_Pressed, this, &AMinesweeper3DBlockGrid::CycleSliceAxis);
 
 	
 	InputComponent->BindAxis("LeftRight", this, &AMinesweeper3DBlockGrid::MoveLeftRight);
@@ -86,6 +112,42 @@ void AMinesweeper3DBlockGrid::SetupPlayerInputComponent(UInputComponent* PlayerI
 void AMinesweeper3DBlockGrid::BeginPlay()
 {
 	Super::BeginPlay();
+}
+
+void AMinesweeper3DBlockGrid::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//The history and governor are shared with any other local grid in the process, so they can outlive this one
+	History.Reset();
+	if (Governor)
+	{
+		Governor->OnQualityChanged.Remove(QualityChangedHandle);
+		Governor.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AMinesweeper3DBlockGrid::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	//Every player has their own board, nobody else needs to hear about it
+	DOREPLIFETIME_CONDITION(AMinesweeper3DBlockGrid, MinesRemaining, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AMinesweeper3DBlockGrid, ElapsedTime, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AMinesweeper3DBlockGrid, ThreeBV, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AMinesweeper3DBlockGrid, ThreeBVPerSecond, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AMinesweeper3DBlockGrid, bGameLost, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AMinesweeper3DBlockGrid, bGameWon, COND_OwnerOnly);
+}
+
+//Runs on the machine of the player controlling this grid, once they possess it. Grids the server holds for remote players never get here.
+void AMinesweeper3DBlockGrid::PawnClientRestart()
+{
+	Super::PawnClientRestart();
+
+	if (bLocalViewInitialized)	return;
+	bLocalViewInitialized = true;
+
 	bIsSettings = false;
 	ToggleSettings();
 
@@ -97,7 +159,32 @@ void AMinesweeper3DBlockGrid::BeginPlay()
 	ResetCameraPosition();
 
 	UGameplayStatics::GetPlayerController(this, 0)->SetViewTarget(Camera);
-	
+
+	History = FMinesweeper3DGameHistory::Acquire();
+	if (HasAuthority())	Journal = MakeUnique<FMinesweeper3DJournal>(FMinesweeper3DJournal::GetDefaultDirectory());
+
+	Governor = FMinesweeper3DFrameGovernor::Acquire(FrameBudgetMs);
+	QualityChangedHandle = Governor->OnQualityChanged.AddUObject(this, &AMinesweeper3DBlockGrid::OnQualityChanged);
+
+	if (bPublishSharedBoard || FParse::Param(FCommandLine::Get(), TEXT("Minesweeper3DSharedBoard")))
+	{
+		SharedBoard = MakeUnique<FMinesweeper3DSharedBoard>(SharedBoardName, SharedBoardMaxCells);
+		SharedBoard->OnCommand.BindUObject(this, &AMinesweeper3DBlockGrid::OnSharedCommand);
+		if (bEndlessMode)	SharedBoard->Clear();
+		else SharedBoard->PublishBoard(Board);
+		PublishSharedStatus();
+	}
+
+	FirstFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &AMinesweeper3DBlockGrid::OnFirstInteractiveFrame);
+}
+
+//The settings menu is up and answering input by the end of the frame our view was set up in
+void AMinesweeper3DBlockGrid::OnFirstInteractiveFrame()
+{
+	FCoreDelegates::OnEndFrame.Remove(FirstFrameHandle);
+	FirstFrameHandle.Reset();
+
+	UE_LOG(LogMinesweeper3D, Log, TEXT("Time to first interactive frame: %.3f s"), FPlatformTime::Seconds() - GStartTime);
 }
 
 /*------------- Interface -------------*/
@@ -106,11 +193,14 @@ void AMinesweeper3DBlockGrid::ToggleSettings()
 {
 	if (!bIsSettings)
 	{
-		if (UClass* SettingsWidgetClass = SettingsWidget.Get())
+		if (UUserWidget* Settings = GetOrCreateWidget(SettingsWidget))
 		{
-			ActiveWidget = CreateWidget<UUserWidget>(GetWorld(), SettingsWidgetClass);
-			ActiveWidget->AddToViewport(0);
+			HideWidget(ActiveWidget);
+			ActiveWidget = Settings;
+			ShowWidget(ActiveWidget);
 			bIsSettings = true;
+
+			if (bFirstGame)	PrewarmFirstGame();
 		}
 	}
 	else
@@ -128,25 +218,25 @@ void AMinesweeper3DBlockGrid::ChangeMenuWidget(TSubclassOf<UUserWidget> NewWidge
 
 	if (NewWidgetClass != nullptr)
 	{
-		CurrentWidget = CreateWidget<UUserWidget>(GetWorld(), NewWidgetClass);
-		if (CurrentWidget != nullptr)
-		{
-			CurrentWidget->AddToViewport();
-		}
+		CurrentWidget = GetOrCreateWidget(NewWidgetClass);
+		ShowWidget(CurrentWidget);
 	}
 }
 
 //Close the menu via the exit button
 void AMinesweeper3DBlockGrid::CloseMenu()
 {
-	ActiveWidget->RemoveFromViewport();
-	if (SecondaryWidget)	SecondaryWidget->RemoveFromViewport();
+	HideWidget(ActiveWidget);
+	HideWidget(SecondaryWidget);
 	
-	if (UClass* HUDWidgetClass = HUDWidget.Get())
+	if (UUserWidget* HUD = GetOrCreateWidget(HUDWidget))
 	{
-		ActiveWidget = CreateWidget<UUserWidget>(GetWorld(), HUDWidgetClass);
-		ActiveWidget->AddToViewport(0);
+		ActiveWidget = HUD;
+		ShowWidget(ActiveWidget);
 		bIsSettings = false;
+
+		//The HUD only hears about changes, so give it the current values when it comes back
+		BroadcastHUDState();
 	}
 
 	if (bFirstGame)
@@ -156,6 +246,31 @@ void AMinesweeper3DBlockGrid::CloseMenu()
 	}
 }
 
+UUserWidget* AMinesweeper3DBlockGrid::GetOrCreateWidget(TSubclassOf<UUserWidget> WidgetClass)
+{
+	UClass* Class = WidgetClass.Get();
+	if (!Class)	return nullptr;
+
+	if (UUserWidget** Cached = WidgetCache.Find(Class))
+	{
+		return *Cached;
+	}
+
+	UUserWidget* Widget = CreateWidget<UUserWidget>(GetWorld(), Class);
+	if (Widget)	WidgetCache.Add(Class, Widget);
+	return Widget;
+}
+
+void AMinesweeper3DBlockGrid::ShowWidget(UUserWidget* Widget)
+{
+	if (Widget && !Widget->IsInViewport())	Widget->AddToViewport(0);
+}
+
+void AMinesweeper3DBlockGrid::HideWidget(UUserWidget* Widget)
+{
+	if (Widget && Widget->IsInViewport())	Widget->RemoveFromViewport();
+}
+
 void AMinesweeper3DBlockGrid::GetActiveCheckbox(UCheckBox* box)
 {
 	/*if (GEngine)
@@ -167,36 +282,110 @@ void AMinesweeper3DBlockGrid::GetActiveCheckbox(UCheckBox* box)
 
 	if (Name == "DifficultyBoxBeginner")
 	{
-		NewSize = 5;
-		NumMines = NewSize * NewSize * NewSize * MinesPercentage;
-		if (SecondaryWidget)	SecondaryWidget->RemoveFromViewport();
+		//Presets are plain cubes, whatever wrapping or slices a custom game left behind
+		NewShape = FMinesweeper3DBoardShape(5);
+		NumMines = NewShape.Num() * MinesPercentage;
+		HideWidget(SecondaryWidget);
 	}
 	else if (Name == "DifficultyBoxIntermediate")
 	{
-		NewSize = 8;
-		NumMines = NewSize * NewSize * NewSize * MinesPercentage;
-		if (SecondaryWidget)	SecondaryWidget->RemoveFromViewport();
+		NewShape = FMinesweeper3DBoardShape(8);
+		NumMines = NewShape.Num() * MinesPercentage;
+		HideWidget(SecondaryWidget);
 	}
 	else if (Name == "DifficultyBoxExpert")
 	{
-		NewSize = 11;
-		NumMines = NewSize * NewSize * NewSize * MinesPercentage;
-		if (SecondaryWidget)	SecondaryWidget->RemoveFromViewport();
+		NewShape = FMinesweeper3DBoardShape(11);
+		NumMines = NewShape.Num() * MinesPercentage;
+		HideWidget(SecondaryWidget);
 	}
 	else if (Name == "DifficultyBoxCustom")
 	{
-		NewSize = 1;
-		if (UClass* CustomSettingsWidgetClass = CustomSettingsWidget.Get())
+		NewShape.Dims = FIntVector(1);
+		if (UUserWidget* CustomSettings = GetOrCreateWidget(CustomSettingsWidget))
 		{
-			SecondaryWidget = CreateWidget<UUserWidget>(GetWorld(), CustomSettingsWidgetClass);
-			SecondaryWidget->AddToViewport(0);
+			SecondaryWidget = CustomSettings;
+			ShowWidget(SecondaryWidget);
 		}
 	}
+
+	if (bFirstGame)	PrewarmFirstGame();
 }
 
 void AMinesweeper3DBlockGrid::ChangeSize(FString Size_in)
 {
-	NewSize = FCString::Atoi(*Size_in);
+	const int32 Size = FCString::Atoi(*Size_in);
+	ChangeDimensions(Size, Size, Size);
+}
+
+void AMinesweeper3DBlockGrid::ChangeDimensions(int32 SizeX, int32 SizeY, int32 SizeZ)
+{
+	const FMinesweeper3DBoardShape OldShape = NewShape;
+	NewShape.Dims = FIntVector(FMath::Max(SizeX, 1), FMath::Max(SizeY, 1), FMath::Max(SizeZ, 1));
+	CheckNewShape(OldShape);
+}
+
+//Custom sizes are checked as they're typed in, long before GenerateBlocks() would find out the hard way
+void AMinesweeper3DBlockGrid::CheckNewShape(const FMinesweeper3DBoardShape& OldShape)
+{
+	if (!Governor)	return;
+
+	const FMinesweeper3DBoardCost Cost = Governor->EstimateBoardCost(NewShape, BlockPool.Num());
+	const uint64 AvailableBytes = FPlatformMemory::GetStats().AvailablePhysical;
+	if (Cost.BoardBytes > MaxBoardMemoryFraction * AvailableBytes || (int64)NewShape.Dims.X * NewShape.Dims.Y * NewShape.Dims.Z * NewShape.Slices > MAX_int32)
+	{
+		const FString Warning = FString::Printf(TEXT("A %dx%dx%d board needs about %lld MB, and only %llu MB is free"),
+			NewShape.Dims.X, NewShape.Dims.Y, NewShape.Dims.Z, Cost.BoardBytes >> 20, AvailableBytes >> 20);
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("%s, keeping %dx%dx%d"), *Warning, OldShape.Dims.X, OldShape.Dims.Y, OldShape.Dims.Z);
+		NewShape = OldShape;
+		OnBoardSizeWarning.Broadcast(Warning);
+		return;
+	}
+
+	//Slices are spaced apart, which chunk meshes don't do, so a 4D board has to be drawn from blocks
+	if (NewShape.Is4D() && !CanAffordBlocks(NewShape))
+	{
+		const FString Warning = FString::Printf(TEXT("A %dx%dx%dx%d board would take about %.0f s to build from blocks"),
+			NewShape.Slices, NewShape.Dims.X, NewShape.Dims.Y, NewShape.Dims.Z, Cost.BlockSpawnSeconds);
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("%s, keeping the old size"), *Warning);
+		NewShape = OldShape;
+		OnBoardSizeWarning.Broadcast(Warning);
+		return;
+	}
+
+	if (RenderMode != EMinesweeper3DRenderMode::Chunks && !CanAffordBlocks(NewShape))
+	{
+		const FString Warning = FString::Printf(TEXT("A %dx%dx%d board would take about %.0f s to build from blocks, it'll be drawn as chunks instead"),
+			NewShape.Dims.X, NewShape.Dims.Y, NewShape.Dims.Z, Cost.BlockSpawnSeconds);
+		UE_LOG(LogMinesweeper3D, Log, TEXT("%s"), *Warning);
+		OnBoardSizeWarning.Broadcast(Warning);
+	}
+}
+
+void AMinesweeper3DBlockGrid::SetWrapAround(bool bWrapX, bool bWrapY, bool bWrapZ)
+{
+	NewShape.bWrapX = bWrapX;
+	NewShape.bWrapY = bWrapY;
+	NewShape.bWrapZ = bWrapZ;
+}
+
+void AMinesweeper3DBlockGrid::SetSlices(int32 InSlices)
+{
+	const FMinesweeper3DBoardShape OldShape = NewShape;
+	NewShape.Slices = FMath::Clamp(InSlices, 1, FMinesweeper3DBoardShape::MaxSlices);
+	CheckNewShape(OldShape);
+}
+
+bool AMinesweeper3DBlockGrid::SetDensity(const FMinesweeper3DDensity& InDensity)
+{
+	if (!InDensity.IsValid())
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Ignoring a mine density that isn't valid"));
+		return false;
+	}
+
+	Density = InDensity;
+	return true;
 }
 
 void AMinesweeper3DBlockGrid::ChangeMines(FString NewMines)
@@ -209,7 +398,7 @@ void AMinesweeper3DBlockGrid::ChangeMines(FString NewMines)
 	}
 	else if (Mines_in >= 0 && Mines_in < 1.f)
 	{
-		NumMines = Size * Size * Size * Mines_in;
+		NumMines = NewShape.Num() * Mines_in;
 	}
 
 }
@@ -229,18 +418,76 @@ void AMinesweeper3DBlockGrid::DisableMousePanning()
 	
 }
 
+//Axis bindings are called every frame whether or not the grid is ticking, so they're what wakes the camera up
 void AMinesweeper3DBlockGrid::MoveLeftRight(float AxisValue)
 {
+	if (AxisValue == 0.f)	return;
+
 	TranslationInputDirection += Camera->GetActorRightVector() * -AxisValue;
+	WakeCamera();
 }
 
 void AMinesweeper3DBlockGrid::MoveUpDown(float AxisValue)
 {
+	//In slice mode UpDown steps the slice through the cube instead of moving the camera
+	if (bSliceMode)
+	{
+		int32 Steps = ConsumeSliceSteps(AxisValue, SliceMoveAccumulator, bSliceMoveHeld);
+		Steps = FMath::Clamp(Steps, -SliceMin, GetNumSliceLayers() - 1 - SliceMax);
+		if (Steps != 0)	SetSliceRange(SliceMin + Steps, SliceMax + Steps);
+		return;
+	}
+	if (AxisValue == 0.f)	return;
+
 	TranslationInputDirection += Camera->GetActorUpVector() * AxisValue;
+	WakeCamera();
 }
 void AMinesweeper3DBlockGrid::MoveInOut(float AxisValue)
 {
+	//...and InOut makes the slice thicker or thinner
+	if (bSliceMode)
+	{
+		const int32 Steps = ConsumeSliceSteps(AxisValue, SliceThicknessAccumulator, bSliceThicknessHeld);
+		if (Steps != 0)	SetSliceRange(SliceMin, SliceMax + Steps);
+		return;
+	}
+	if (AxisValue == 0.f)	return;
+
 	TranslationInputDirection += Camera->GetActorForwardVector() * AxisValue;
+	WakeCamera();
+}
+
+void AMinesweeper3DBlockGrid::ToggleSliceMode()
+{
+	SetSliceMode(!bSliceMode);
+}
+
+void AMinesweeper3DBlockGrid::CycleSliceAxis()
+{
+	if (bSliceMode)	SetSliceAxis((SliceAxis + 1) % 3);
+}
+
+//Steps once as soon as the axis is pressed, then repeats at SliceStepsPerSecond while it's held
+int32 AMinesweeper3DBlockGrid::ConsumeSliceSteps(float AxisValue, float& Accumulator, bool& bHeld)
+{
+	if (AxisValue == 0.f)
+	{
+		Accumulator = 0.f;
+		bHeld = false;
+		return 0;
+	}
+
+	if (!bHeld)
+	{
+		Accumulator = 0.f;
+		bHeld = true;
+		return AxisValue > 0.f ? 1 : -1;
+	}
+
+	Accumulator += AxisValue * SliceStepsPerSecond * GetWorld()->GetDeltaSeconds();
+	const int32 Steps = FMath::TruncToInt(Accumulator);
+	Accumulator -= Steps;
+	return Steps;
 }
 
 //Negative AxisValue 
@@ -257,12 +504,18 @@ void AMinesweeper3DBlockGrid::ZoomOut()
 
 void AMinesweeper3DBlockGrid::ChangeTheta(float AxisVal)
 {
-	theta += 0.035f * AxisVal;
+	if (AxisVal == 0.f)	return;
+
+	TargetTheta += 0.035f * AxisVal;
+	WakeCamera();
 }
 
 void AMinesweeper3DBlockGrid::ChangePhi(float AxisVal)
 {
-	phi += 0.035f * AxisVal;
+	if (AxisVal == 0.f)	return;
+
+	TargetPhi += 0.035f * AxisVal;
+	WakeCamera();
 }
 
 void AMinesweeper3DBlockGrid::ZoomStop(){}
@@ -272,280 +525,1929 @@ void AMinesweeper3DBlockGrid::ZoomCamera(bool bZoomOut)
 	float delta = ZoomSpeed;
 	if (bZoomOut)	delta *= -2;
 
-	radius += delta;
+	TargetRadius += delta;
+	WakeCamera();
+}
+
+void AMinesweeper3DBlockGrid::WakeCamera()
+{
+	if (Camera)	SetActorTickEnabled(true);
 }
 
 void AMinesweeper3DBlockGrid::ResetCameraPosition()
 {
-	FVector CameraLoc(-1000.f, -1000.f, 1000.f + (Size * 100.f));
-	theta = 3.14f / 4;
-	phi = -3.14f / 4;
+	FVector CameraLoc(-1000.f, -1000.f, 1000.f + (Shape.GetMaxSize() * 100.f));
+	theta = TargetTheta = PI / 4;
+	phi = TargetPhi = -PI / 4;
+	TargetRadius = radius;
+	CameraVelocity = FVector::ZeroVector;
 	Camera->SetActorLocation(CameraLoc);
+
+	//Tick once so the rotation gets applied
+	WakeCamera();
+}
+
+//Keeps Target within [Min, Min + 2pi), moving Current by the same amount so smoothing never goes the long way round
+static void WrapAngle(float& Target, float& Current, float Min)
+{
+	if (Target < Min)
+	{
+		Target += 2.f * PI;
+		Current += 2.f * PI;
+	}
+	else if (Target >= Min + 2.f * PI)
+	{
+		Target -= 2.f * PI;
+		Current -= 2.f * PI;
+	}
 }
 
-void AMinesweeper3DBlockGrid::UpdateCameraPosition()
+//Eases the camera towards where input wants it. Returns whether it's still moving.
+bool AMinesweeper3DBlockGrid::UpdateCameraPosition(float DeltaSeconds)
 {
-	//Wrap theta between 0 and 2pi (as defined by the spherical coordinate system)
-	if (theta < 0)	theta += 6.28;
-	if (theta > 6.28)	theta -= 6.28;
+	//Wrap theta between 0 and 2pi (as defined by the spherical coordinate system), phi between -pi and pi
+	WrapAngle(TargetTheta, theta, 0.f);
+	WrapAngle(TargetPhi, phi, -PI);
+
+	//FInterpTo eases by a fraction of the remaining distance scaled by DeltaSeconds, so it feels the same at any frame rate
+	theta = FMath::FInterpTo(theta, TargetTheta, DeltaSeconds, CameraSmoothing);
+	phi = FMath::FInterpTo(phi, TargetPhi, DeltaSeconds, CameraSmoothing);
+
+	const float OldRadius = radius;
+	radius = FMath::FInterpTo(radius, TargetRadius, DeltaSeconds, CameraSmoothing);
 
-	if (phi < -3.14)	phi += 6.28;
-	if (phi > 3.14)	phi -= 6.28;
+	const FVector TargetVelocity = TranslationInputDirection.GetSafeNormal() * CameraMoveSpeed;
+	CameraVelocity = FMath::VInterpTo(CameraVelocity, TargetVelocity, DeltaSeconds, CameraSmoothing);
+	TranslationInputDirection = FVector::ZeroVector;
 
-	TranslationInputDirection.Normalize();
-	TranslationInputDirection *= 10.f;
-	TranslationInputDirection += Camera->GetActorLocation();
-	Camera->SetActorLocation(TranslationInputDirection);
+	//Zooming dollies the camera towards or away from what it's looking at
+	const FVector Location = Camera->GetActorLocation() + CameraVelocity * DeltaSeconds + Camera->GetActorForwardVector() * (OldRadius - radius);
 
 	//Not sure why the equation for pitch is so weird, I basically just messed around until I found something that worked. Avoids gimbal lock tho.
-	FRotator rotation((-phi * 180.f / 3.14f) - 90.f, theta * 180.f / 3.14f, 0.0f);
-	Camera->SetActorRotation(rotation);
-	
-	/*if (GEngine)
+	const FRotator Rotation(-FMath::RadiansToDegrees(phi) - 90.f, FMath::RadiansToDegrees(theta), 0.0f);
+	Camera->SetActorLocationAndRotation(Location, Rotation);
+
+	//Snap the last little bit so we can actually stop ticking
+	const bool bSettled = FMath::IsNearlyEqual(theta, TargetTheta, 1.e-4f) && FMath::IsNearlyEqual(phi, TargetPhi, 1.e-4f)
+		&& FMath::IsNearlyEqual(radius, TargetRadius, 0.1f) && TargetVelocity.IsZero() && CameraVelocity.IsNearlyZero(1.f);
+	if (bSettled)
 	{
-		GEngine->AddOnScreenDebugMessage(-1, 0.02, FColor::Yellow, FString::Printf(TEXT("Theta: %f, Phi: %f, Pitch: %f, Yaw: %f, Roll: %f"),
-			theta, phi, rotation.Pitch, rotation.Yaw, rotation.Roll));
-	}*/
+		theta = TargetTheta;
+		phi = TargetPhi;
+		radius = TargetRadius;
+		CameraVelocity = FVector::ZeroVector;
+	}
+	return !bSettled;
+}
+
+/*----------- Slice Mode ------------*/
+
+void AMinesweeper3DBlockGrid::SetSliceMode(bool bEnabled)
+{
+	if (bSliceMode == bEnabled)	return;
+
+	bSliceMode = bEnabled;
+	SliceMoveAccumulator = 0.f;
+	SliceThicknessAccumulator = 0.f;
+	bSliceMoveHeld = false;
+	bSliceThicknessHeld = false;
 
-	TranslationInputDirection = FVector(0, 0, 0);
+	//Entering or leaving slice mode touches every block once, after that only the layers that change are updated
+	UpdateSliceLayers(0, GetNumSliceLayers() - 1);
 }
 
-/*----------- Level Generation ------------*/
+void AMinesweeper3DBlockGrid::SetSliceAxis(int32 Axis)
+{
+	SliceAxis = FMath::Clamp(Axis, 0, 2);
 
-void AMinesweeper3DBlockGrid::StartGame()
+	//The new axis might be shorter than the old one
+	SliceMin = FMath::Clamp(SliceMin, 0, FMath::Max(GetNumSliceLayers() - 1, 0));
+	SliceMax = FMath::Clamp(SliceMax, SliceMin, FMath::Max(GetNumSliceLayers() - 1, 0));
+	if (bSliceMode)	UpdateSliceLayers(0, GetNumSliceLayers() - 1);
+}
+
+void AMinesweeper3DBlockGrid::SetSliceRange(int32 InMin, int32 InMax)
 {
-	//needed to finish generation when the first block is clicked
-	bFirstClick = true;
-	bGameLost = false;
-	bGameWon = false;
-	DestroyBlocks();
-	Size = NewSize;
-	CubeCenter.X = 100.f * (Size - 1) * 0.5;
-	CubeCenter.Y = 100.f * (Size - 1) * 0.5;
-	CubeCenter.Z = 100.f * (Size - 1) * 0.5;
-	radius = 150.f * Size;
-	GenerateBlocks();
-	ResetCameraPosition();
+	const int32 OldMin = SliceMin;
+	const int32 OldMax = SliceMax;
+	SliceMin = FMath::Clamp(InMin, 0, FMath::Max(GetNumSliceLayers() - 1, 0));
+	SliceMax = FMath::Clamp(InMax, SliceMin, FMath::Max(GetNumSliceLayers() - 1, 0));
 
-	ElapsedTime = 0;
-	MinesRemaining = NumMines;
-	BlocksRemaining = Size * Size * Size;
-	GetWorldTimerManager().ClearTimer(GameClockTimer);
+	if (!bSliceMode)	return;
+
+	//Layers that used to be in or next to the slice, then the ones that are now
+	UpdateSliceLayers(OldMin - SliceGhostLayers, OldMax + SliceGhostLayers);
+	UpdateSliceLayers(SliceMin - SliceGhostLayers, SliceMax + SliceGhostLayers);
 }
 
-//Spawn the 3D cube of blocks and link them to the BlockGrid
-void AMinesweeper3DBlockGrid::GenerateBlocks()
+AMinesweeper3DBlock::SliceView AMinesweeper3DBlockGrid::GetSliceView(int32 Layer) const
 {
-	//reserve 1st dimension (surely there has to be a better way to initialize a 3d array, but the constructor list is lacking)
-	Blocks.Empty();
-	BlockList.Empty();
-	Blocks.Reserve(Size);
-	for (int i = 0; i < Size; i++)
-	{
-		Blocks.Emplace();
-		Blocks[i].Reserve(Size);
-	}
+	if (!bSliceMode || (Layer >= SliceMin && Layer <= SliceMax))	return AMinesweeper3DBlock::inSlice;
+	if (Layer >= SliceMin - SliceGhostLayers && Layer <= SliceMax + SliceGhostLayers)	return AMinesweeper3DBlock::ghost;
+	return AMinesweeper3DBlock::outOfSlice;
+}
 
-	//reserve 2nd dimension
-	for (int i = 0; i < Size; i++)
+void AMinesweeper3DBlockGrid::UpdateSliceLayers(int32 FromLayer, int32 ToLayer)
+{
+	if (!HasBlocks())	return;
+
+	FromLayer = FMath::Max(FromLayer, 0);
+	ToLayer = FMath::Min(ToLayer, GetNumSliceLayers() - 1);
+
+	//Chunks leave out everything outside the slice, ghosts included, and the detail blocks follow on the next LOD pass
+	if (bChunkedBoard)
 	{
-		for (int j = 0; j < Size; j++)
-		{
-			Blocks[i].Emplace();
-			Blocks[i][j].Reserve(Size);
-		}
+		MarkChunkLayersDirty(FromLayer, ToLayer);
+		FlushChunkBuilds();
+		bLODDirty = true;
+		WakeCamera();
+		return;
 	}
 
-	//reserve 3rd dimension
-	for (int i = 0; i < Size; i++)
+	FIntVector Pos;
+	for (int32 Layer = FromLayer; Layer <= ToLayer; Layer++)
 	{
-		for (int j = 0; j < Size; j++)
+		const AMinesweeper3DBlock::SliceView View = GetSliceView(Layer);
+		Pos[SliceAxis] = Layer;
+
+		//Walk the two axes that lie in the layer
+		const int32 AxisA = (SliceAxis + 1) % 3;
+		const int32 AxisB = (SliceAxis + 2) % 3;
+		const FIntVector LayoutDims = Shape.GetLayoutDims();
+		for (Pos[AxisA] = 0; Pos[AxisA] < LayoutDims[AxisA]; Pos[AxisA]++)
 		{
-			for (int k = 0; k < Size; k++)
+			for (Pos[AxisB] = 0; Pos[AxisB] < LayoutDims[AxisB]; Pos[AxisB]++)
 			{
-				Blocks[i][j].Emplace();
+				if (AMinesweeper3DBlock* Block = BlockSlots[Board.ToIndex(Pos.X, Pos.Y, Pos.Z)])	Block->SetSliceView(View);
 			}
 		}
 	}
+}
+
+/*----------- Level Generation ------------*/
+
+void AMinesweeper3DBlockGrid::StartGame()
+{
+	//The server keeps the real board, we just keep a copy of what we've been told about it
+	if (!HasAuthority())	ServerStartGame(NewShape, NumMines, Density);
+
+	ResetGame(NewShape, NumMines);
+}
 
-	//Spawn each block
-	for (int Xpos = 0; Xpos < Size; Xpos++)
+void AMinesweeper3DBlockGrid::StartEndlessGame()
+{
+	if (!HasAuthority() || !IsLocallyControlled())
 	{
-		for (int Ypos = 0; Ypos < Size; Ypos++)
-		{
-			for (int Zpos = 0; Zpos < Size; Zpos++)
-			{
-				//Make position vector, offset from grid location
-				const FVector BlockLocation = FVector(Xpos * BlockSpacing, Ypos * BlockSpacing, Zpos * BlockSpacing); //+ GetActorLocation();
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Endless mode can only be played by the host or in a standalone game"));
+		return;
+	}
 
-				//Spawn a block
-				AMinesweeper3DBlock* NewBlock = GetWorld()->SpawnActor<AMinesweeper3DBlock>(BlockLocation, FRotator(0, 0, 0));
+	if (Journal)	Journal->EndGame();
 
-				if (NewBlock != nullptr)
-				{
-					NewBlock->OwningGrid = this;
-					Blocks[Xpos][Ypos][Zpos] = NewBlock;
-					BlockList.Add(NewBlock);
-					NewBlock->Xpos = Xpos;
-					NewBlock->Ypos = Ypos;
-					NewBlock->Zpos = Zpos;
-					NewBlock->bIsRevealed = false;
-				}
-			}
-		}
+	bFirstClick = true;
+	SetGameState(false, false);
+	ReleaseBlocks();
+	ReleaseChunks();
+	ReleaseEndless();
+	GetWorldTimerManager().ClearTimer(GameClockTimer);
+
+	bPuzzleGame = false;
+	bEndlessMode = true;
+	if (SharedBoard)	SharedBoard->Clear();
+	bChunkedBoard = true;
+	EndlessBoard.Reset(FMath::Rand(), EndlessMineDensity);
+	EndlessCellsRevealed = 0;
+	NumClicks = 0;
+	ThreeBV = 0;
+	ThreeBVPerSecond = 0.f;
+	UndoStack.Empty();
+	RedoStack.Empty();
+
+	//Frame the streamed region as if it were a board that size, centred on the chunk at the origin
+	const int32 RegionCells = (2 * EndlessStreamRadius + 1) * FMinesweeper3DChunkMesher::ChunkSize;
+	Shape = FMinesweeper3DBoardShape(RegionCells);
+	CubeCenter = FVector(0.5f * (FMinesweeper3DChunkMesher::ChunkSize - 1) * BlockSpacing);
+	radius = 150.f * RegionCells;
+	ResetCameraPosition();
+
+	SetElapsedTime(0);
+	SetMinesRemaining(0);
+
+	for (int32 Mesh = 0; Mesh < ChunkMeshes.Num(); Mesh++)
+	{
+		FreeChunkMeshes.Add(Mesh);
 	}
+	UpdateEndlessStreaming(true);
 }
 
-//Determine which blocks are mines
-void AMinesweeper3DBlockGrid::GenerateMines()
+void AMinesweeper3DBlockGrid::ResetGame(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, bool bPrepareNext, int32 InSeed)
 {
-	//Randomize mines
-	for (int i = 0; i < 5000; i++)
+	//Whatever was being played is abandoned
+	if (Journal)	Journal->EndGame();
+
+	//needed to finish generation when the first block is clicked
+	bFirstClick = true;
+	bPuzzleGame = false;
+	CurrentPuzzle = INDEX_NONE;
+	bUsedPractice = bPracticeMode;
+	SetGameState(false, false);
+	ReleaseBlocks();
+	ReleaseChunks();
+	ReleaseEndless();
+	Shape = InShape;
+	NumMines = InNumMines;
+	CubeCenter.X = 100.f * ((Shape.Dims.X * Shape.Slices - 1) + (Shape.Slices - 1) * SliceGap) * 0.5;
+	CubeCenter.Y = 100.f * (Shape.Dims.Y - 1) * 0.5;
+	CubeCenter.Z = 100.f * (Shape.Dims.Z - 1) * 0.5;
+	//Frame the longest side
+	radius = 150.f * Shape.GetMaxSize();
+	if (InSeed != INDEX_NONE || !TakeNextBoard(Shape, NumMines))
 	{
-		BlockList.Swap(FMath::RandRange(0, BlockList.Num() - 1), FMath::RandRange(0, BlockList.Num() - 1));
+		Board.Density = Density;
+		Board.Reset(Shape, NumMines, InSeed);
 	}
-
-	for (int i = 0; i < NumMines; i++)
+	NumClicks = 0;
+	ThreeBV = 0;
+	ThreeBVPerSecond = 0.f;
+	UndoStack.Empty();
+	RedoStack.Empty();
+
+	//A dedicated server, or a listen server holding another player's grid, has nothing to draw
+	if (IsLocallyControlled())
 	{
-		//Ignore the blocks surrounding the first click so more blocks are revealed when the game starts
-		if (BlockList[i]->bGenerationSafelock)
-		{
-			//Keep the first NumMines entries in BlockList as all mines so they're easy to find in RevealMines()
-			BlockList.RemoveAt(i);
-			i--;
-		}
-		else
-		{
-			BlockList[i]->bIsMine = true;
-		}
+		bChunkedBoard = UsesChunks(Shape);
+		GenerateBlocks();
+		ResetCameraPosition();
+
+		//Keep the slice where it was if it still fits
+		SetSliceRange(SliceMin, SliceMax);
+		if (bSliceMode)	UpdateSliceLayers(0, GetNumSliceLayers() - 1);
 	}
+
+	if (SharedBoard)	SharedBoard->PublishBoard(Board);
+	SetElapsedTime(0);
+	SetMinesRemaining(NumMines);
+	PublishSharedStatus();
+	GetWorldTimerManager().ClearTimer(GameClockTimer);
+
+	//Players mostly go again on the same settings, so have that board waiting
+	if (bPrepareNext)	PrepareNextBoard(Shape, NumMines);
 }
 
-//Find number of surrounding mines for each block
-void AMinesweeper3DBlockGrid::AssignSurroundingMineTotals()
+bool AMinesweeper3DBlockGrid::StartPuzzle(const FString& PackPath, int32 PuzzleIndex)
 {
-	for (int i = 0; i < Blocks.Num(); i++)
+	//The pack is on this machine, and a client's board lives on the server
+	if (!HasAuthority() || !IsLocallyControlled())
 	{
-		for (int j = 0; j < Blocks[0].Num(); j++)
-		{
-			for (int k = 0; k < Blocks[0][0].Num(); k++)
-			{
-				if (!Blocks[i][j][k]->bIsMine)
-				{
-					Blocks[i][j][k]->NumSurroundingMines = CalcSurroundingMines(i, j, k);
-				}
-			}
-		}
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Puzzles can only be played by the host or in a standalone game"));
+		return false;
+	}
+
+	FMinesweeper3DBoardShape PuzzleShape;
+	if (!OpenPuzzlePack(PackPath) || !PuzzlePack->ReadShape(PuzzleIndex, PuzzleShape))	return false;
+
+	//The puzzle is parsed straight into the board ResetGame just made, so there's no next board to get ready. That
+	//clears NumMines, so the menu's count is kept to fall back on.
+	const int32 MenuMines = NumMines;
+	ResetGame(PuzzleShape, 0, false);
+	if (!PuzzlePack->Load(PuzzleIndex, Board))
+	{
+		ResetGame(NewShape, MenuMines);
+		return false;
+	}
+
+	bPuzzleGame = true;
+	CurrentPuzzle = PuzzleIndex;
+	NumMines = Board.NumMines;
+	ThreeBV = Board.ThreeBV;
+	SetMinesRemaining(NumMines - Board.NumFlags);
+
+	//Blocks and chunks catch up with the position the puzzle starts from the same way they would with a flood reveal
+	FMinesweeper3DCellList Revealed;
+	FMinesweeper3DBoardDelta Delta;
+	for (int32 Index = 0; Index < Board.Num(); Index++)
+	{
+		if (Board.States[Index] == EMinesweeper3DCellState::Revealed)	Revealed.Add(Index);
+		else if (Board.States[Index] == EMinesweeper3DCellState::Flagged)	Delta.Flagged.Add(Index);
 	}
+	Delta.AddRevealed(Revealed, Board);
+	SendBoardDelta(Delta);
+	return true;
 }
 
-//Called when the first block is clicked
-void AMinesweeper3DBlockGrid::FinishSetup(AMinesweeper3DBlock *block)
+int32 AMinesweeper3DBlockGrid::GetNumPuzzles(const FString& PackPath)
 {
-	SafelockBlocks(block);
-	GenerateMines();
-	AssignSurroundingMineTotals();
+	return OpenPuzzlePack(PackPath) ? PuzzlePack->Num() : 0;
+}
 
-	GetWorldTimerManager().SetTimer(GameClockTimer, this, &AMinesweeper3DBlockGrid::AdvanceTimer, 1.0f, true);
+bool AMinesweeper3DBlockGrid::CanResumeGame() const
+{
+	return Journal && Journal->CanResume();
 }
 
-void AMinesweeper3DBlockGrid::DestroyBlocks()
+bool AMinesweeper3DBlockGrid::ResumeGame()
 {
-	for (int i = 0; i < Blocks.Num(); i++)
+	//Read in full before anything is set up, starting the board again ends the journal
+	FMinesweeper3DJournalResume Resume;
+	if (!Journal || !Journal->ReadResume(Resume))	return false;
+
+	const FMinesweeper3DJournalGame& Game = Resume.Game;
+	if (Game.FirstClick < 0 || Game.FirstClick >= Game.Shape.Num())	return false;
+
+	if (Game.PuzzleIndex != INDEX_NONE)
 	{
-		for (int j = 0; j < Blocks.Num(); j++)
-		{
-			for (int k = 0; k < Blocks.Num(); k++)
-			{
-				//Sometimes this pointer can be valid, but the underlying object isn't so we can't just check the pointer
-				if(Blocks[i][j][k]->IsValidLowLevel()) Blocks[i][j][k]->Destroy();
-			}
-		}
+		if (!StartPuzzle(Game.PuzzlePack, Game.PuzzleIndex) || !(Board.Shape == Game.Shape))	return false;
 	}
-}
+	else
+	{
+		if (Game.Shape.Num() <= 0 || Game.NumMines <= 0 || Game.NumMines >= Game.Shape.Num())	return false;
 
-/*---------- Utility ----------*/
+		//The journaled board, not whichever one was waiting. The first click places the same mines it did before.
+		Density = Game.Density;
+		ResetGame(Game.Shape, Game.NumMines, true, Game.Seed);
+	}
 
-//Sets a flag for all blocks surrounding block to make sure they don't become mines
-//this gives the player more information when they start the game
-void AMinesweeper3DBlockGrid::SafelockBlocks(AMinesweeper3DBlock* block)
-{
-	int Xpos = block->Xpos;
-	int Ypos = block->Ypos;
-	int Zpos = block->Zpos;
+	//Blocks and chunks catch up the same way they would with undo and flood reveals. The journal starts again from a
+	//checkpoint of the replayed board, so nothing is appended until that's queued.
+	bReplayingJournal = true;
+	bPracticeMode = Game.bPracticeMode;
+	bUsedPractice = bPracticeMode;
+	FinishSetup(Game.FirstClick);
+	bFirstClick = false;
 
-	for (int x = -1; x < 2; x++)
+	if (Resume.bHasCheckpoint && Resume.Checkpoint.States.Num() == Board.Num())
 	{
-		for (int y = -1; y < 2; y++)
-		{
-			for (int z = -1; z < 2; z++)
-			{
-				if (CheckBlockBounds(Xpos + x, Ypos + y, Zpos + z))
-				{
-					Blocks[Xpos + x][Ypos + y][Zpos + z]->bGenerationSafelock = true;
-				}
-			}
-		}
+		FMinesweeper3DBoardDelta Delta;
+		Board.RestoreSnapshot(Resume.Checkpoint, Delta);
+		SendBoardDelta(Delta);
 	}
-}
+	for (const FMinesweeper3DBoardDelta& Delta : Resume.Deltas)
+	{
+		Board.ApplyDelta(Delta);
+		SendBoardDelta(Delta);
+	}
+	bReplayingJournal = false;
 
-//Called on game loss
-void AMinesweeper3DBlockGrid::RevealMines()
-{
-	for (int i = 0; i < NumMines; i++)
+	NumClicks = Resume.Clicks;
+	GameStartTime = GetWorld()->GetTimeSeconds() - Resume.Time;
+	SetElapsedTime(FMath::FloorToInt(Resume.Time));
+	SetMinesRemaining(NumMines - Board.NumFlags);
+
+	//A practice game is still journaled after a loss, since it could have been undone
+	bool bLost = false;
+	for (int32 Mine = 0; Mine < Board.NumMines && !bLost; Mine++)
 	{
-		BlockList[i]->Reveal();
+		bLost = Board.States[Board.BlockList[Mine]] == EMinesweeper3DCellState::Revealed;
 	}
-	GetWorldTimerManager().ClearTimer(GameClockTimer);
+
+	if (bLost)
+	{
+		SetGameState(false, true);
+		GetWorldTimerManager().ClearTimer(GameClockTimer);
+	}
+	else
+	{
+		CheckForWin();
+	}
+
+	//The journal started again with the game, so it gets a checkpoint of everything replayed into it
+	if (bGameLost || bGameWon)	Journal->EndGame();
+	else Journal->Checkpoint(Board, Resume.Time, NumClicks);
+
+	UE_LOG(LogMinesweeper3D, Log, TEXT("Resumed a game after %d clicks and %.1f seconds"), NumClicks, Resume.Time);
+	return true;
 }
 
-void AMinesweeper3DBlockGrid::CheckForWin()
+bool AMinesweeper3DBlockGrid::OpenPuzzlePack(const FString& PackPath)
 {
-	bGameWon = BlocksRemaining == NumMines;
-	if(bGameWon)	GetWorldTimerManager().ClearTimer(GameClockTimer);
+	if (PuzzlePack && PuzzlePack->GetPath() == PackPath)	return true;
+
+	PuzzlePack = MakeUnique<FMinesweeper3DPuzzlePack>();
+	if (PuzzlePack->Open(PackPath))	return true;
+
+	PuzzlePack.Reset();
+	return false;
 }
 
-//When checking surrounding blocks, ensure they are not outside the bounds of the Blocks 3d array
-bool AMinesweeper3DBlockGrid::CheckBlockBounds(int Xpos, int Ypos, int Zpos)
+bool AMinesweeper3DBlockGrid::ExportPuzzle(const FString& PackPath, EMinesweeper3DPuzzleFormat Format)
 {
-	return Xpos >= 0 && Xpos < Size && Ypos >= 0 && Ypos < Size&& Zpos >= 0 && Zpos < Size;
+	//Only the authority knows where the mines are
+	if (!HasAuthority() || bEndlessMode || !Board.bGenerated)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Only a board whose mines have been placed on this machine can be exported"));
+		return false;
+	}
+
+	FMinesweeper3DPuzzlePackWriter Writer;
+	return Writer.Open(PackPath, Format) && Writer.Add(Board) && Writer.Close();
 }
 
-//Check the 26 blocks surrounding a block at a given x, y, and z coordinate to determine how many mines surround it
-int AMinesweeper3DBlockGrid::CalcSurroundingMines(int Xpos, int Ypos, int Zpos)
+void AMinesweeper3DBlockGrid::PrepareNextBoard(const FMinesweeper3DBoardShape& InShape, int32 InNumMines)
 {
-	int AdjacentMines = 0;
-	
-	for (int x = -1; x < 2; x++)
+	if (InShape.Num() <= 0)	return;
+	if (NextBoard.IsValid() && NextBoardShape == InShape && NextBoardMines == InNumMines && NextBoardDensity == Density)	return;
+
+	//Only one board in flight at a time
+	if (NextBoardTask.IsValid())	NextBoardTask.Wait();
+
+	NextBoardShape = InShape;
+	NextBoardMines = InNumMines;
+	NextBoardDensity = Density;
+	NextBoard = MakeShared<FMinesweeper3DBoard, ESPMode::ThreadSafe>();
+	NextBoard->Density = Density;
+
+	//FMath::Rand isn't safe off the game thread, so pick the seed here. Clients never place mines, so there's nothing for them to shuffle.
+	const int32 Seed = FMath::Rand();
+	const bool bShuffle = HasAuthority();
+	TSharedPtr<FMinesweeper3DBoard, ESPMode::ThreadSafe> Prepared = NextBoard;
+	NextBoardTask = Async(EAsyncExecution::ThreadPool, [Prepared, InShape, InNumMines, Seed, bShuffle]()
 	{
-		for (int y = -1; y < 2; y++)
-		{
-			for (int z = -1; z < 2; z++)
-			{
-				if (CheckBlockBounds(Xpos + x, Ypos + y, Zpos + z))
-				{
-					if (Blocks[Xpos + x][Ypos + y][Zpos + z]->bIsMine)
-					{
-						AdjacentMines++;
-					}
-				}
-			}
-		}
-	}
-	return AdjacentMines;
+		Prepared->Reset(InShape, InNumMines, Seed);
+		if (bShuffle)	Prepared->Shuffle();
+	});
 }
 
-float AMinesweeper3DBlockGrid::DistanceFromCenter()
+bool AMinesweeper3DBlockGrid::TakeNextBoard(const FMinesweeper3DBoardShape& InShape, int32 InNumMines)
 {
-	float X = Camera->GetActorLocation().X - CubeCenter.X;
-	float Y = Camera->GetActorLocation().Y - CubeCenter.Y;
-	float Z = Camera->GetActorLocation().Z - CubeCenter.Z;
-	return FMath::Sqrt(X * X + Y * Y + Z * Z);
+	if (!NextBoard.IsValid() || !(NextBoardShape == InShape) || NextBoardMines != InNumMines || !(NextBoardDensity == Density))	return false;
+
+	//Normally long finished, the worker has had the whole previous game
+	NextBoardTask.Wait();
+
+	//The prepared board's arena only held its sampler weights, keep the one this board has already grown
+	FMinesweeper3DArena GameArena = MoveTemp(Board.GameArena);
+	Board = MoveTemp(*NextBoard);
+	Board.GameArena = MoveTemp(GameArena);
+	Board.GameArena.Reset();
+	NextBoard.Reset();
+	return true;
 }
 
-void AMinesweeper3DBlockGrid::AdvanceTimer()
+void AMinesweeper3DBlockGrid::PrewarmFirstGame()
+{
+	PrepareNextBoard(NewShape, NumMines);
+	if (IsLocallyControlled())	WarmBlockPool();
+}
+
+//Spawns a frame's worth of pooled blocks, and comes back next frame until there are enough for the board picked in the menu
+void AMinesweeper3DBlockGrid::WarmBlockPool()
 {
-	ElapsedTime++;
+	if (!bFirstGame || !bIsSettings)	return;
+
+	//A chunked board only ever places blocks on the nearest numbered cells
+	const int32 Target = UsesChunks(NewShape) ? MaxDetailedBlocks : NewShape.Num();
+	const int32 BatchSize = Governor ? Governor->ScaleCount(PoolWarmBlocksPerFrame) : PoolWarmBlocksPerFrame;
+	for (int32 i = 0; i < BatchSize && BlockPool.Num() < Target; i++)
+	{
+		const double SpawnStart = FPlatformTime::Seconds();
+		AMinesweeper3DBlock* NewBlock = GetWorld()->SpawnActor<AMinesweeper3DBlock>(FVector::ZeroVector, FRotator(0, 0, 0));
+		if (!NewBlock)	break;
+		if (Governor)	Governor->RecordBlockSpawn(FPlatformTime::Seconds() - SpawnStart);
+
+		NewBlock->OwningGrid = this;
+		NewBlock->SetActorHiddenInGame(true);
+		NewBlock->SetActorEnableCollision(false);
+		BlockPool.Add(NewBlock);
+	}
+
+	if (BlockPool.Num() < Target)
+	{
+		GetWorldTimerManager().SetTimerForNextTick(this, &AMinesweeper3DBlockGrid::WarmBlockPool);
+	}
+}
+
+bool AMinesweeper3DBlockGrid::ServerStartGame_Validate(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, const FMinesweeper3DDensity& InDensity)
+{
+	if (!InDensity.IsValid())	return false;
+
+	const FIntVector& Dims = InShape.Dims;
+	return Dims.GetMin() >= 1 && Dims.GetMax() <= MaxNetSize && InShape.Slices >= 1 && InShape.Slices <= FMinesweeper3DBoardShape::MaxSlices
+		&& (int64)Dims.X * Dims.Y * Dims.Z * InShape.Slices <= MAX_int32 && InNumMines >= 0 && InNumMines <= InShape.Num();
+}
+
+void AMinesweeper3DBlockGrid::ServerStartGame_Implementation(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, const FMinesweeper3DDensity& InDensity)
+{
+	Density = InDensity;
+	ResetGame(InShape, InNumMines);
+}
+
+//Place a block on every cell and link them to the BlockGrid
+void AMinesweeper3DBlockGrid::GenerateBlocks()
+{
+	const int32 NumCells = Board.Num();
+	BlockSlots.SetNumZeroed(NumCells);
+	if (BlockGenerations.Num() < NumCells)	BlockGenerations.SetNumZeroed(NumCells);
+
+	//Chunked boards start with every slot empty, blocks are only placed on numbered cells near the camera
+	if (bChunkedBoard)
+	{
+		GenerateChunks();
+		return;
+	}
+
+	int32 NumFailed = 0;
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		//Reuse a pooled block if there is one, otherwise spawn
+		AMinesweeper3DBlock* NewBlock = AcquireBlock(GetCellLocation(Index));
+
+		if (NewBlock != nullptr)
+		{
+			NewBlock->Handle = FMinesweeper3DBlockHandle(Index, BlockGenerations[Index]);
+		}
+		else
+		{
+			NumFailed++;
+		}
+		BlockSlots[Index] = NewBlock;
+	}
+
+	//A cell with no block can't be clicked, so the board goes to chunks rather than be left with holes. 4D boards can't,
+	//their empty slots are skipped wherever blocks are updated.
+	if (NumFailed > 0)
+	{
+		UE_LOG(LogMinesweeper3D, Error, TEXT("Couldn't spawn %d of %d blocks%s"), NumFailed, NumCells, Shape.Is4D() ? TEXT("") : TEXT(", drawing the board as chunks instead"));
+		if (!Shape.Is4D())
+		{
+			ReleaseBlocks();
+			BlockSlots.SetNumZeroed(NumCells);
+			bChunkedBoard = true;
+			GenerateChunks();
+		}
+	}
+}
+
+//Blocks sit in world space, one BlockSpacing apart, rather than relative to the grid. A 4D board's slices have SliceGap between them.
+FVector AMinesweeper3DBlockGrid::GetCellLocation(int32 Index) const
+{
+	int32 Xpos, Ypos, Zpos;
+	Board.ToCoords(Index, Xpos, Ypos, Zpos);
+	const int32 Slice = Xpos / Shape.Dims.X;
+	return FVector((Xpos + Slice * SliceGap) * BlockSpacing, Ypos * BlockSpacing, Zpos * BlockSpacing);
+}
+
+//Called when the first block is clicked
+void AMinesweeper3DBlockGrid::FinishSetup(int32 Index)
+{
+	//Puzzles come with their mines already placed
+	if (!Board.bGenerated)	Board.Generate(Index);
+	ThreeBV = Board.ThreeBV;
+
+	//A painted density can leave too few cells open to take every mine asked for
+	if (NumMines != Board.NumMines)
+	{
+		NumMines = Board.NumMines;
+		SetMinesRemaining(NumMines - Board.NumFlags);
+	}
+	GameStartTime = GetWorld()->GetTimeSeconds();
+
+	GetWorldTimerManager().SetTimer(GameClockTimer, this, &AMinesweeper3DBlockGrid::AdvanceTimer, 1.0f, true);
+
+	if (Journal)
+	{
+		FMinesweeper3DJournalGame Game;
+		Game.Shape = Shape;
+		Game.NumMines = NumMines;
+		Game.Seed = Board.Seed;
+		Game.FirstClick = Index;
+		Game.Density = Board.Density;
+		Game.bPracticeMode = bPracticeMode;
+		if (bPuzzleGame && PuzzlePack)
+		{
+			Game.PuzzlePack = PuzzlePack->GetPath();
+			Game.PuzzleIndex = CurrentPuzzle;
+		}
+		Journal->BeginGame(Game, bReplayingJournal);
+	}
+}
+
+AMinesweeper3DBlock* AMinesweeper3DBlockGrid::AcquireBlock(const FVector& Location)
+{
+	while (BlockPool.Num() > 0)
+	{
+		AMinesweeper3DBlock* Block = BlockPool.Pop(false);
+		if (!IsValid(Block))	continue;
+
+		Block->SetActorLocation(Location);
+		Block->ResetBlock();
+		return Block;
+	}
+
+	const double SpawnStart = FPlatformTime::Seconds();
+	AMinesweeper3DBlock* NewBlock = GetWorld()->SpawnActor<AMinesweeper3DBlock>(Location, FRotator(0, 0, 0));
+	if (NewBlock)	NewBlock->OwningGrid = this;
+	if (NewBlock && Governor)	Governor->RecordBlockSpawn(FPlatformTime::Seconds() - SpawnStart);
+	return NewBlock;
+}
+
+//Hides the current blocks and keeps them for the next board, which is usually the same size
+void AMinesweeper3DBlockGrid::ReleaseBlocks()
+{
+	BlockPool.Reserve(BlockPool.Num() + BlockSlots.Num());
+	for (int32 Index = 0; Index < BlockSlots.Num(); Index++)
+	{
+		ReleaseBlock(Index);
+	}
+	BlockSlots.Reset();
+	NumberedCells.Reset();
+	FocusedBlock = FMinesweeper3DBlockHandle();
+}
+
+void AMinesweeper3DBlockGrid::ReleaseBlock(int32 Index)
+{
+	//Anything still holding a handle to this cell stops resolving from here on
+	BlockGenerations[Index]++;
+
+	AMinesweeper3DBlock* Block = BlockSlots[Index];
+	if (!Block)	return;
+
+	PoolBlock(Block);
+	BlockSlots[Index] = nullptr;
+}
+
+void AMinesweeper3DBlockGrid::PoolBlock(AMinesweeper3DBlock* Block)
+{
+	Block->Handle = FMinesweeper3DBlockHandle();
+	Block->SetActorHiddenInGame(true);
+	Block->SetActorEnableCollision(false);
+	BlockPool.Add(Block);
+}
+
+/*---------- Reveal / Flag ----------*/
+
+AMinesweeper3DBlock* AMinesweeper3DBlockGrid::ResolveBlock(const FMinesweeper3DBlockHandle& Handle) const
+{
+	if (!BlockSlots.IsValidIndex(Handle.Index) || BlockGenerations[Handle.Index] != Handle.Generation)	return nullptr;
+	return BlockSlots[Handle.Index];
+}
+
+void AMinesweeper3DBlockGrid::RequestReveal(AMinesweeper3DBlock* Block)
+{
+	//A click that was in flight when the board was reset lands on a block that's been released since
+	if (ResolveBlock(Block->Handle) != Block)	return;
+
+	RequestRevealCell(Block->Handle.Index);
+}
+
+void AMinesweeper3DBlockGrid::RequestFlag(AMinesweeper3DBlock* Block)
+{
+	if (ResolveBlock(Block->Handle) != Block)	return;
+
+	RequestFlagCell(Block->Handle.Index);
+}
+
+void AMinesweeper3DBlockGrid::RequestRevealCell(int32 Index)
+{
+	if (HasAuthority())	RevealCell(Index);
+	else ServerRevealBlock(Index);
+}
+
+void AMinesweeper3DBlockGrid::RequestFlagCell(int32 Index)
+{
+	if (HasAuthority())	FlagCell(Index);
+	else ServerFlagBlock(Index);
+}
+
+bool AMinesweeper3DBlockGrid::ServerRevealBlock_Validate(int32 Index)
+{
+	return Board.IsValidIndex(Index);
+}
+
+void AMinesweeper3DBlockGrid::ServerRevealBlock_Implementation(int32 Index)
+{
+	RevealCell(Index);
+}
+
+bool AMinesweeper3DBlockGrid::ServerFlagBlock_Validate(int32 Index)
+{
+	return Board.IsValidIndex(Index);
+}
+
+void AMinesweeper3DBlockGrid::ServerFlagBlock_Implementation(int32 Index)
+{
+	FlagCell(Index);
+}
+
+void AMinesweeper3DBlockGrid::RevealCell(int32 Index)
+{
+	if (bGameLost || bGameWon || !Board.IsValidIndex(Index))	return;
+	if (Board.States[Index] != EMinesweeper3DCellState::Hidden)	return;
+
+	//Generate mines on the first click so you don't immediately explode
+	if (bFirstClick)
+	{
+		FinishSetup(Index);
+		bFirstClick = false;
+	}
+
+	PushUndoStep();
+	NumClicks++;
+
+	FMinesweeper3DCellList Revealed;
+	if (Board.Reveal(Index, Revealed))
+	{
+		UpdateGameStats();
+		SetGameState(false, true);
+		Board.RevealMines(Revealed);
+		GetWorldTimerManager().ClearTimer(GameClockTimer);
+		RecordGame();
+	}
+	else
+	{
+		CheckForWin();
+	}
+
+	FMinesweeper3DBoardDelta Delta;
+	Delta.AddRevealed(Revealed, Board);
+	SendBoardDelta(Delta);
+}
+
+void AMinesweeper3DBlockGrid::FlagCell(int32 Index)
+{
+	if (bGameLost || bGameWon)	return;
+
+	//Taken before the flag changes but only kept if it does. A snapshot held on to makes the next write copy its page,
+	//so outside practice mode there isn't one.
+	FMinesweeper3DUndoStep Step;
+	if (bPracticeMode)	Step = MakeUndoStep();
+
+	bool bFlagged;
+	if (!Board.ToggleFlag(Index, bFlagged))	return;
+
+	PushUndoStep(MoveTemp(Step));
+
+	NumClicks++;
+	SetMinesRemaining(NumMines - Board.NumFlags);
+
+	FMinesweeper3DBoardDelta Delta;
+	(bFlagged ? Delta.Flagged : Delta.Unflagged).Add(Index);
+	SendBoardDelta(Delta);
+}
+
+/*---------- Undo / Redo ----------*/
+
+void AMinesweeper3DBlockGrid::SetPracticeMode(bool bEnabled)
+{
+	if (!HasAuthority())	ServerSetPracticeMode(bEnabled);
+
+	bPracticeMode = bEnabled;
+	bUsedPractice |= bEnabled;
+	UndoStack.Empty();
+	RedoStack.Empty();
+}
+
+bool AMinesweeper3DBlockGrid::ServerSetPracticeMode_Validate(bool bEnabled)
+{
+	return true;
+}
+
+void AMinesweeper3DBlockGrid::ServerSetPracticeMode_Implementation(bool bEnabled)
+{
+	SetPracticeMode(bEnabled);
+}
+
+void AMinesweeper3DBlockGrid::Undo()
+{
+	if (!bPracticeMode || bEndlessMode)	return;
+
+	if (HasAuthority())	RestoreUndoStep(UndoStack, RedoStack);
+	else ServerUndo();
+}
+
+void AMinesweeper3DBlockGrid::Redo()
+{
+	if (!bPracticeMode || bEndlessMode)	return;
+
+	if (HasAuthority())	RestoreUndoStep(RedoStack, UndoStack);
+	else ServerRedo();
+}
+
+bool AMinesweeper3DBlockGrid::ServerUndo_Validate()
+{
+	return true;
+}
+
+void AMinesweeper3DBlockGrid::ServerUndo_Implementation()
+{
+	Undo();
+}
+
+bool AMinesweeper3DBlockGrid::ServerRedo_Validate()
+{
+	return true;
+}
+
+void AMinesweeper3DBlockGrid::ServerRedo_Implementation()
+{
+	Redo();
+}
+
+FMinesweeper3DUndoStep AMinesweeper3DBlockGrid::MakeUndoStep() const
+{
+	FMinesweeper3DUndoStep Step;
+	Step.Board = Board.TakeSnapshot();
+	Step.bGameLost = bGameLost;
+	Step.bGameWon = bGameWon;
+	return Step;
+}
+
+void AMinesweeper3DBlockGrid::PushUndoStep()
+{
+	if (bPracticeMode)	PushUndoStep(MakeUndoStep());
+}
+
+void AMinesweeper3DBlockGrid::PushUndoStep(FMinesweeper3DUndoStep&& Step)
+{
+	if (!bPracticeMode)	return;
+
+	if (UndoStack.Num() >= MaxUndoSteps)	UndoStack.RemoveAt(0);
+	UndoStack.Add(MoveTemp(Step));
+	RedoStack.Reset();
+}
+
+//Swaps the live board for the top of From, saving where we were onto To
+void AMinesweeper3DBlockGrid::RestoreUndoStep(TArray<FMinesweeper3DUndoStep>& From, TArray<FMinesweeper3DUndoStep>& To)
+{
+	if (From.Num() == 0)	return;
+
+	To.Add(MakeUndoStep());
+	const FMinesweeper3DUndoStep Step = From.Pop(false);
+
+	FMinesweeper3DBoardDelta Delta;
+	Board.RestoreSnapshot(Step.Board, Delta);
+
+	const bool bWasOver = bGameLost || bGameWon;
+	SetGameState(Step.bGameWon, Step.bGameLost);
+	SetMinesRemaining(NumMines - Board.NumFlags);
+
+	//Undoing a loss or a win puts the clock back on
+	if (bWasOver && !bGameLost && !bGameWon && !bFirstClick)
+	{
+		GetWorldTimerManager().SetTimer(GameClockTimer, this, &AMinesweeper3DBlockGrid::AdvanceTimer, 1.0f, true);
+	}
+	else if (bGameLost || bGameWon)
+	{
+		GetWorldTimerManager().ClearTimer(GameClockTimer);
+	}
+
+	SendBoardDelta(Delta);
+}
+
+void AMinesweeper3DBlockGrid::SendBoardDelta(const FMinesweeper3DBoardDelta& Delta)
+{
+	if (Delta.IsEmpty())	return;
+
+	const int32 NumCells = Delta.Counts.Num();
+	INC_DWORD_STAT_BY(STAT_BoardDeltaCells, NumCells);
+
+	//Sizing a delta serializes it a second time, so it's only done for the stat or a log that's listening
+	if (STATS || UE_LOG_ACTIVE(LogMinesweeper3D, Verbose))
+	{
+		const int32 NumBytes = Delta.GetNetSize();
+		INC_DWORD_STAT_BY(STAT_BoardDeltaBytes, NumBytes);
+		UE_LOG(LogMinesweeper3D, Verbose, TEXT("Board delta: %d revealed cells in %d runs, %d bytes"), NumCells, Delta.RunStarts.Num(), NumBytes);
+	}
+
+	//Only queued, the journal's own thread writes it
+	if (Journal && !bReplayingJournal)	Journal->Append(Delta, Board, GetWorld()->GetTimeSeconds() - GameStartTime, NumClicks);
+
+	if (IsLocallyControlled())
+	{
+		UpdateBlocks(Delta);
+		if (SharedBoard)	SharedBoard->PublishDelta(Delta);
+	}
+	else
+	{
+		ClientApplyBoardDelta(Delta);
+	}
+}
+
+void AMinesweeper3DBlockGrid::ClientApplyBoardDelta_Implementation(const FMinesweeper3DBoardDelta& Delta)
+{
+	Board.ApplyDelta(Delta);
+	UpdateBlocks(Delta);
+	if (SharedBoard)	SharedBoard->PublishDelta(Delta);
+}
+
+void AMinesweeper3DBlockGrid::UpdateBlocks(const FMinesweeper3DBoardDelta& Delta)
+{
+	if (!HasBlocks())	return;
+
+	if (bChunkedBoard)
+	{
+		UpdateChunks(Delta);
+		return;
+	}
+
+	int32 CountIndex = 0;
+	for (int32 Run = 0; Run < Delta.RunStarts.Num(); Run++)
+	{
+		for (int32 i = 0; i < Delta.RunLengths[Run]; i++)
+		{
+			const int32 Index = Delta.RunStarts[Run] + i;
+			const int8 Count = Delta.Counts[CountIndex++];
+			if (!Board.IsValidIndex(Index) || !BlockSlots[Index])	continue;
+
+			BlockSlots[Index]->ShowRevealed(Count);
+		}
+	}
+
+	for (int32 Index : Delta.Flagged)
+	{
+		if (!Board.IsValidIndex(Index) || !BlockSlots[Index])	continue;
+		BlockSlots[Index]->ShowFlagged(true);
+	}
+
+	for (int32 Index : Delta.Unflagged)
+	{
+		if (!Board.IsValidIndex(Index) || !BlockSlots[Index])	continue;
+		BlockSlots[Index]->ShowFlagged(false);
+	}
+
+	for (int32 Index : Delta.Hidden)
+	{
+		if (!Board.IsValidIndex(Index) || !BlockSlots[Index])	continue;
+		BlockSlots[Index]->ShowHidden();
+	}
+}
+
+/*---------- Chunks ----------*/
+
+bool AMinesweeper3DBlockGrid::UsesChunks(const FMinesweeper3DBoardShape& InShape) const
+{
+	//Chunk meshes don't leave the gaps between slices, CheckNewShape() has already turned down 4D boards too big for blocks
+	if (InShape.Is4D())	return false;
+	if (RenderMode == EMinesweeper3DRenderMode::Chunks)	return true;
+	if (RenderMode == EMinesweeper3DRenderMode::Auto && InShape.Num() >= ChunkedRenderMinCells)	return true;
+
+	//Rather than hang in GenerateBlocks(), a board this machine can't spawn in time gets chunks even in Blocks mode
+	return !CanAffordBlocks(InShape);
+}
+
+bool AMinesweeper3DBlockGrid::CanAffordBlocks(const FMinesweeper3DBoardShape& InShape) const
+{
+	if (!Governor)	return true;
+
+	const FMinesweeper3DBoardCost Cost = Governor->EstimateBoardCost(InShape, BlockPool.Num());
+	return Cost.BlockSpawnSeconds <= MaxBlockSpawnSeconds && Cost.BoardBytes + Cost.BlockBytes <= MaxBoardMemoryFraction * FPlatformMemory::GetStats().AvailablePhysical;
+}
+
+bool AMinesweeper3DBlockGrid::CanStartChunkBuild() const
+{
+	return !Governor || ChunkBuildsInFlight < Governor->GetMaxChunkBuildsInFlight();
+}
+
+void AMinesweeper3DBlockGrid::OnQualityChanged()
+{
+	bLODDirty = true;
+	WakeCamera();
+}
+
+int32 AMinesweeper3DBlockGrid::AddChunkMesh()
+{
+	UProceduralMeshComponent* Mesh = NewObject<UProceduralMeshComponent>(this);
+	Mesh->SetupAttachment(DummyRoot);
+	//Blocks are placed in world space, so chunks are too, lifted the same as the block mesh
+	Mesh->SetAbsolute(true, true, true);
+	Mesh->SetWorldLocation(FVector(0.f, 0.f, 25.f));
+	//Collision is cooked off the game thread. Until it lands a rebuilt chunk is clicked through its old collision.
+	Mesh->bUseAsyncCooking = true;
+	Mesh->SetMaterial(0, ChunkMaterial);
+	Mesh->OnClicked.AddDynamic(this, &AMinesweeper3DBlockGrid::ChunkClicked);
+	Mesh->OnInputTouchBegin.AddDynamic(this, &AMinesweeper3DBlockGrid::ChunkTouched);
+	Mesh->RegisterComponent();
+	return ChunkMeshes.Add(Mesh);
+}
+
+void AMinesweeper3DBlockGrid::GenerateChunks()
+{
+	const int32 ChunkSize = FMinesweeper3DChunkMesher::ChunkSize;
+	NumChunks = FIntVector(
+		FMath::DivideAndRoundUp(Shape.Dims.X, ChunkSize),
+		FMath::DivideAndRoundUp(Shape.Dims.Y, ChunkSize),
+		FMath::DivideAndRoundUp(Shape.Dims.Z, ChunkSize));
+	const int32 TotalChunks = NumChunks.X * NumChunks.Y * NumChunks.Z;
+	ChunkStates.Reset();
+	ChunkStates.SetNum(TotalChunks);
+
+	//Meshes from the last chunked board are reused, only the ones we're short of get made
+	while (ChunkMeshes.Num() < TotalChunks)
+	{
+		AddChunkMesh();
+	}
+
+	for (FMinesweeper3DChunkState& State : ChunkStates)
+	{
+		State.bDirty = true;
+	}
+	FlushChunkBuilds();
+}
+
+void AMinesweeper3DBlockGrid::ReleaseChunks()
+{
+	ChunkEpoch++;
+	for (UProceduralMeshComponent* Mesh : ChunkMeshes)
+	{
+		if (Mesh)	Mesh->ClearAllMeshSections();
+	}
+	ChunkStates.Reset();
+	NumChunks = FIntVector::ZeroValue;
+	bChunkMinesShown = false;
+	SET_DWORD_STAT(STAT_ChunkTriangles, 0);
+}
+
+void AMinesweeper3DBlockGrid::MarkChunkDirty(int32 Index)
+{
+	const int32 ChunkSize = FMinesweeper3DChunkMesher::ChunkSize;
+	int32 Pos[3];
+	Board.ToCoords(Index, Pos[0], Pos[1], Pos[2]);
+
+	//A cell on the edge of its chunk also decides whether the chunk next door draws the face between them
+	int32 From[3];
+	int32 To[3];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const int32 Chunk = Pos[Axis] / ChunkSize;
+		const int32 Offset = Pos[Axis] % ChunkSize;
+		From[Axis] = (Offset == 0 && Chunk > 0) ? Chunk - 1 : Chunk;
+		To[Axis] = (Offset == ChunkSize - 1 && Chunk < NumChunks[Axis] - 1) ? Chunk + 1 : Chunk;
+	}
+
+	for (int32 x = From[0]; x <= To[0]; x++)
+	{
+		for (int32 y = From[1]; y <= To[1]; y++)
+		{
+			for (int32 z = From[2]; z <= To[2]; z++)
+			{
+				ChunkStates[(x * NumChunks.Y + y) * NumChunks.Z + z].bDirty = true;
+			}
+		}
+	}
+}
+
+void AMinesweeper3DBlockGrid::MarkChunkLayersDirty(int32 FromLayer, int32 ToLayer)
+{
+	if (ChunkStates.Num() == 0)	return;
+
+	//Layers either side lose or gain the faces that looked into the changed ones
+	const int32 ChunkSize = FMinesweeper3DChunkMesher::ChunkSize;
+	const int32 FromChunk = FMath::Max(FromLayer - 1, 0) / ChunkSize;
+	const int32 ToChunk = FMath::Min(ToLayer + 1, GetNumSliceLayers() - 1) / ChunkSize;
+
+	FIntVector Chunk;
+	for (Chunk.X = 0; Chunk.X < NumChunks.X; Chunk.X++)
+	{
+		for (Chunk.Y = 0; Chunk.Y < NumChunks.Y; Chunk.Y++)
+		{
+			for (Chunk.Z = 0; Chunk.Z < NumChunks.Z; Chunk.Z++)
+			{
+				if (Chunk[SliceAxis] < FromChunk || Chunk[SliceAxis] > ToChunk)	continue;
+				ChunkStates[(Chunk.X * NumChunks.Y + Chunk.Y) * NumChunks.Z + Chunk.Z].bDirty = true;
+			}
+		}
+	}
+}
+
+//Starts a build for every dirty chunk that isn't already building. Chunks still building pick up their changes when they land.
+void AMinesweeper3DBlockGrid::FlushChunkBuilds()
+{
+	bChunkBuildsQueued = false;
+
+	//Every chunk started here reads the same copy of the board
+	TSharedPtr<FMinesweeper3DChunkMeshInput, ESPMode::ThreadSafe> Input;
+
+	for (int32 Chunk = 0; Chunk < ChunkStates.Num(); Chunk++)
+	{
+		FMinesweeper3DChunkState& State = ChunkStates[Chunk];
+		if (!State.bDirty || State.bBuilding)	continue;
+
+		//The rest wait for a build to land, which comes back here
+		if (!CanStartChunkBuild())
+		{
+			bChunkBuildsQueued = true;
+			return;
+		}
+
+		if (!Input.IsValid())
+		{
+			Input = MakeShared<FMinesweeper3DChunkMeshInput, ESPMode::ThreadSafe>();
+			Input->Shape = Shape;
+			Input->States = Board.States;
+			if (bChunkMinesShown)	Input->Counts = Board.Counts;
+			Input->BlockSpacing = BlockSpacing;
+			Input->bSliced = bSliceMode;
+			Input->SliceAxis = SliceAxis;
+			Input->SliceMin = SliceMin;
+			Input->SliceMax = SliceMax;
+		}
+
+		State.bDirty = false;
+		State.bBuilding = true;
+		ChunkBuildsInFlight++;
+		INC_DWORD_STAT(STAT_ChunkBuildsInFlight);
+
+		const FIntVector ChunkMin = FIntVector(Chunk / (NumChunks.Y * NumChunks.Z), (Chunk / NumChunks.Z) % NumChunks.Y, Chunk % NumChunks.Z) * FMinesweeper3DChunkMesher::ChunkSize;
+		const uint32 Epoch = ChunkEpoch;
+		TWeakObjectPtr<AMinesweeper3DBlockGrid> WeakThis(this);
+		Async(EAsyncExecution::ThreadPool, [WeakThis, Input, ChunkMin, Chunk, Epoch]()
+		{
+			FMinesweeper3DChunkMeshData Data;
+			FMinesweeper3DChunkMesher::BuildChunk(*Input, ChunkMin, Data);
+
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Chunk, Epoch, Data = MoveTemp(Data)]() mutable
+			{
+				if (AMinesweeper3DBlockGrid* Grid = WeakThis.Get())	Grid->OnChunkBuilt(Chunk, Epoch, Data);
+			});
+		});
+	}
+}
+
+void AMinesweeper3DBlockGrid::OnChunkBuilt(int32 Chunk, uint32 Epoch, FMinesweeper3DChunkMeshData& Data)
+{
+	DEC_DWORD_STAT(STAT_ChunkBuildsInFlight);
+	ChunkBuildsInFlight--;
+	if (Epoch != ChunkEpoch || !ChunkStates.IsValidIndex(Chunk))
+	{
+		//A build from the last board still frees a slot for this one
+		if (bChunkBuildsQueued && bEndlessMode)	FlushEndlessChunkBuilds();
+		else if (bChunkBuildsQueued)	FlushChunkBuilds();
+		return;
+	}
+
+	FMinesweeper3DChunkState& State = ChunkStates[Chunk];
+	State.bBuilding = false;
+
+	DEC_DWORD_STAT_BY(STAT_ChunkTriangles, State.NumTriangles);
+	State.NumTriangles = Data.Triangles.Num() / 3;
+	INC_DWORD_STAT_BY(STAT_ChunkTriangles, State.NumTriangles);
+
+	UProceduralMeshComponent* Mesh = ChunkMeshes[Chunk];
+	if (Data.IsEmpty())
+	{
+		Mesh->ClearMeshSection(0);
+	}
+	else
+	{
+		Mesh->CreateMeshSection(0, Data.Vertices, Data.Triangles, Data.Normals, TArray<FVector2D>(), Data.Colors, TArray<FProcMeshTangent>(), true);
+	}
+
+	//Something changed while it was building, or other chunks were waiting on a free slot
+	if (State.bDirty || bChunkBuildsQueued)	FlushChunkBuilds();
+}
+
+void AMinesweeper3DBlockGrid::UpdateChunks(const FMinesweeper3DBoardDelta& Delta)
+{
+	int32 CountIndex = 0;
+	for (int32 Run = 0; Run < Delta.RunStarts.Num(); Run++)
+	{
+		for (int32 i = 0; i < Delta.RunLengths[Run]; i++)
+		{
+			const int32 Index = Delta.RunStarts[Run] + i;
+			const int8 Count = Delta.Counts[CountIndex++];
+			if (!Board.IsValidIndex(Index))	continue;
+
+			MarkChunkDirty(Index);
+			if (Count == FMinesweeper3DBoard::MineCount)	bChunkMinesShown = true;
+			else if (Count > 0)	NumberedCells.Add(Index);
+		}
+	}
+
+	for (int32 Index : Delta.Flagged)
+	{
+		if (Board.IsValidIndex(Index))	MarkChunkDirty(Index);
+	}
+
+	for (int32 Index : Delta.Unflagged)
+	{
+		if (Board.IsValidIndex(Index))	MarkChunkDirty(Index);
+	}
+
+	for (int32 Index : Delta.Hidden)
+	{
+		if (!Board.IsValidIndex(Index))	continue;
+
+		MarkChunkDirty(Index);
+		NumberedCells.RemoveSwap(Index);
+		if (BlockSlots[Index])	ReleaseBlock(Index);
+	}
+
+	FlushChunkBuilds();
+	bLODDirty = true;
+	WakeCamera();
+}
+
+void AMinesweeper3DBlockGrid::UpdateChunkDetailBlocks(const FVector& CameraLocation, float DetailDistanceSq)
+{
+	struct FCandidate
+	{
+		float DistanceSq;
+		int32 Index;
+	};
+	TArray<FCandidate> Candidates;
+	for (int32 Index : NumberedCells)
+	{
+		int32 Pos[3];
+		Board.ToCoords(Index, Pos[0], Pos[1], Pos[2]);
+		const float DistanceSq = FVector::DistSquared(CameraLocation, GetCellLocation(Index));
+		if (DistanceSq < DetailDistanceSq && GetSliceView(Pos[SliceAxis]) == AMinesweeper3DBlock::inSlice)
+		{
+			Candidates.Add({ DistanceSq, Index });
+		}
+		else if (BlockSlots[Index])
+		{
+			ReleaseBlock(Index);
+		}
+	}
+
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistanceSq < B.DistanceSq; });
+	const int32 MaxDetailed = GetMaxDetailedBlocks();
+	for (int32 i = 0; i < Candidates.Num(); i++)
+	{
+		const int32 Index = Candidates[i].Index;
+		if (i >= MaxDetailed)
+		{
+			if (BlockSlots[Index])	ReleaseBlock(Index);
+			continue;
+		}
+		if (BlockSlots[Index])	continue;
+
+		AMinesweeper3DBlock* Block = AcquireBlock(GetCellLocation(Index));
+		if (!Block)	continue;
+
+		Block->Handle = FMinesweeper3DBlockHandle(Index, BlockGenerations[Index]);
+		BlockSlots[Index] = Block;
+		Block->ShowRevealed(Board.Counts[Index]);
+		Block->SetDetailed(true);
+	}
+
+	SET_DWORD_STAT(STAT_DetailedNumberBlocks, FMath::Min(Candidates.Num(), MaxDetailed));
+}
+
+FIntVector AMinesweeper3DBlockGrid::GetCellFromHit(const FHitResult& Hit) const
+{
+	//Step half a cell back through the face that was hit to land in the middle of the cell it belongs to
+	const FVector Inside = Hit.Component->GetComponentTransform().InverseTransformPosition(Hit.ImpactPoint - Hit.ImpactNormal * 0.5f * BlockSpacing);
+	return FIntVector(
+		FMath::RoundToInt(Inside.X / BlockSpacing),
+		FMath::RoundToInt(Inside.Y / BlockSpacing),
+		FMath::RoundToInt(Inside.Z / BlockSpacing));
+}
+
+void AMinesweeper3DBlockGrid::ClickCell(const FIntVector& Pos, bool bReveal)
+{
+	if (bEndlessMode)
+	{
+		if (bReveal)	RevealEndlessCell(Pos);
+		else FlagEndlessCell(Pos);
+		return;
+	}
+
+	if (!Board.CheckBlockBounds(Pos.X, Pos.Y, Pos.Z))	return;
+
+	const int32 Index = Board.ToIndex(Pos.X, Pos.Y, Pos.Z);
+	if (!bReveal)	RequestFlagCell(Index);
+	else if (Board.States[Index] == EMinesweeper3DCellState::Hidden)	RequestRevealCell(Index);
+}
+
+void AMinesweeper3DBlockGrid::ChunkClicked(UPrimitiveComponent* ClickedComp, FKey ButtonClicked)
+{
+	if (bGameLost || bGameWon)	return;
+
+	//OnClicked doesn't say where, so ask for the hit the click came from
+	APlayerController* PC = Cast<APlayerController>(GetController());
+	FHitResult Hit;
+	if (!PC || !PC->GetHitResultUnderCursor(ECC_Visibility, false, Hit) || Hit.Component.Get() != ClickedComp)	return;
+
+	ClickCell(GetCellFromHit(Hit), ButtonClicked.ToString() == "LeftMouseButton");
+}
+
+void AMinesweeper3DBlockGrid::ChunkTouched(ETouchIndex::Type FingerIndex, UPrimitiveComponent* TouchedComponent)
+{
+	APlayerController* PC = Cast<APlayerController>(GetController());
+	FHitResult Hit;
+	if (!PC || !PC->GetHitResultUnderFinger(FingerIndex, ECC_Visibility, false, Hit) || Hit.Component.Get() != TouchedComponent)	return;
+
+	ClickCell(GetCellFromHit(Hit), true);
+}
+
+/*---------- Endless ----------*/
+
+void AMinesweeper3DBlockGrid::ReleaseEndless()
+{
+	for (const TPair<FIntVector, FMinesweeper3DEndlessChunk>& Pair : EndlessChunks)
+	{
+		ChunkMeshes[Pair.Value.Mesh]->ClearAllMeshSections();
+	}
+	EndlessChunks.Empty();
+	FreeChunkMeshes.Reset();
+
+	for (const TPair<FIntVector, AMinesweeper3DBlock*>& Pair : EndlessDetailBlocks)
+	{
+		if (Pair.Value)	PoolBlock(Pair.Value);
+	}
+	EndlessDetailBlocks.Empty();
+
+	EndlessBoard.Reset(0, 0.f);
+	bEndlessMode = false;
+}
+
+//Streams chunks in and out once the point the camera is looking at moves into a different chunk
+void AMinesweeper3DBlockGrid::UpdateEndlessStreaming(bool bForce)
+{
+	const int32 ChunkSize = FMinesweeper3DChunkMesher::ChunkSize;
+	const int32 StreamRadius = FMath::Max(EndlessStreamRadius, 0);
+
+	//The point the camera orbits at its current distance, which is whatever's in the middle of the screen
+	const FVector Focus = Camera ? Camera->GetActorLocation() + Camera->GetActorForwardVector() * radius : FVector::ZeroVector;
+	const FIntVector Center(
+		FMath::FloorToInt((Focus.X / BlockSpacing + 0.5f) / ChunkSize),
+		FMath::FloorToInt((Focus.Y / BlockSpacing + 0.5f) / ChunkSize),
+		FMath::FloorToInt((Focus.Z / BlockSpacing + 0.5f) / ChunkSize));
+	if (!bForce && Center == EndlessStreamCenter)	return;
+
+	const FIntVector OldCenter = EndlessStreamCenter;
+	const bool bHadRegion = EndlessChunks.Num() > 0;
+	EndlessStreamCenter = Center;
+	EndlessRegionMin = (Center - FIntVector(StreamRadius)) * ChunkSize;
+	EndlessRegionMax = (Center + FIntVector(StreamRadius + 1)) * ChunkSize - FIntVector(1);
+
+	auto IsOnShell = [StreamRadius](const FIntVector& Offset)
+	{
+		return FMath::Abs(Offset.X) == StreamRadius || FMath::Abs(Offset.Y) == StreamRadius || FMath::Abs(Offset.Z) == StreamRadius;
+	};
+
+	for (auto It = EndlessChunks.CreateIterator(); It; ++It)
+	{
+		const FIntVector Offset = It.Key() - Center;
+		if (FMath::Abs(Offset.X) > StreamRadius || FMath::Abs(Offset.Y) > StreamRadius || FMath::Abs(Offset.Z) > StreamRadius)
+		{
+			ChunkMeshes[It.Value().Mesh]->ClearAllMeshSections();
+			DEC_DWORD_STAT_BY(STAT_ChunkTriangles, It.Value().State.NumTriangles);
+			FreeChunkMeshes.Add(It.Value().Mesh);
+			It.RemoveCurrent();
+			continue;
+		}
+
+		//Chunks on the edge of the old or new region draw that edge as a wall, which has moved
+		if (IsOnShell(Offset) || (bHadRegion && IsOnShell(It.Key() - OldCenter)))	It.Value().State.bDirty = true;
+	}
+
+	FIntVector Coord;
+	for (Coord.X = Center.X - StreamRadius; Coord.X <= Center.X + StreamRadius; Coord.X++)
+	{
+		for (Coord.Y = Center.Y - StreamRadius; Coord.Y <= Center.Y + StreamRadius; Coord.Y++)
+		{
+			for (Coord.Z = Center.Z - StreamRadius; Coord.Z <= Center.Z + StreamRadius; Coord.Z++)
+			{
+				if (EndlessChunks.Contains(Coord))	continue;
+
+				FMinesweeper3DEndlessChunk& Chunk = EndlessChunks.Add(Coord);
+				Chunk.Mesh = FreeChunkMeshes.Num() > 0 ? FreeChunkMeshes.Pop(false) : AddChunkMesh();
+				Chunk.Serial = ++NextEndlessChunkSerial;
+				Chunk.State.bDirty = true;
+			}
+		}
+	}
+
+	//Floods that ran into the old edge carry on into the new ground
+	if (!bGameLost)
+	{
+		TArray<FIntVector> Revealed;
+		EndlessBoard.ContinueFlood(EndlessRegionMin, EndlessRegionMax, Revealed);
+		EndlessCellsRevealed = EndlessBoard.NumRevealed;
+		MarkEndlessCellsDirty(Revealed);
+	}
+
+	FlushEndlessChunkBuilds();
+	bLODDirty = true;
+}
+
+void AMinesweeper3DBlockGrid::MarkEndlessCellsDirty(const TArray<FIntVector>& Cells)
+{
+	const int32 Mask = FMinesweeper3DEndlessBoard::PageMask;
+	for (const FIntVector& Cell : Cells)
+	{
+		const FIntVector Chunk = FMinesweeper3DEndlessBoard::ToPage(Cell);
+		if (FMinesweeper3DEndlessChunk* Streamed = EndlessChunks.Find(Chunk))	Streamed->State.bDirty = true;
+
+		//A cell on the edge of its chunk also decides whether the chunk next door draws the face between them
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const int32 Offset = Cell[Axis] & Mask;
+			if (Offset != 0 && Offset != Mask)	continue;
+
+			FIntVector Neighbour = Chunk;
+			Neighbour[Axis] += Offset == 0 ? -1 : 1;
+			if (FMinesweeper3DEndlessChunk* Streamed = EndlessChunks.Find(Neighbour))	Streamed->State.bDirty = true;
+		}
+	}
+}
+
+void AMinesweeper3DBlockGrid::FlushEndlessChunkBuilds()
+{
+	bChunkBuildsQueued = false;
+
+	TWeakObjectPtr<AMinesweeper3DBlockGrid> WeakThis(this);
+	for (TPair<FIntVector, FMinesweeper3DEndlessChunk>& Pair : EndlessChunks)
+	{
+		FMinesweeper3DEndlessChunk& Chunk = Pair.Value;
+		if (!Chunk.State.bDirty || Chunk.State.bBuilding)	continue;
+
+		if (!CanStartChunkBuild())
+		{
+			bChunkBuildsQueued = true;
+			return;
+		}
+
+		Chunk.State.bDirty = false;
+		Chunk.State.bBuilding = true;
+		ChunkBuildsInFlight++;
+		INC_DWORD_STAT(STAT_ChunkBuildsInFlight);
+
+		//The build only sees the mine function and the pages around the chunk, so a flood writing elsewhere never waits on it
+		TSharedRef<FMinesweeper3DEndlessChunkInput, ESPMode::ThreadSafe> Input = MakeShared<FMinesweeper3DEndlessChunkInput, ESPMode::ThreadSafe>();
+		Input->Mines = EndlessBoard.Mines;
+		Input->RegionMin = EndlessRegionMin;
+		Input->RegionMax = EndlessRegionMax;
+		Input->BlockSpacing = BlockSpacing;
+		int32 Slot = 0;
+		for (int32 x = -1; x <= 1; x++)
+		{
+			for (int32 y = -1; y <= 1; y++)
+			{
+				for (int32 z = -1; z <= 1; z++)
+				{
+					Input->Pages[Slot++] = EndlessBoard.FindPage(Pair.Key + FIntVector(x, y, z));
+				}
+			}
+		}
+
+		const FIntVector Coord = Pair.Key;
+		const uint32 Serial = Chunk.Serial;
+		Async(EAsyncExecution::ThreadPool, [WeakThis, Input, Coord, Serial]()
+		{
+			FMinesweeper3DChunkMeshData Data;
+			FMinesweeper3DChunkMesher::BuildEndlessChunk(*Input, Coord * FMinesweeper3DChunkMesher::ChunkSize, Data);
+
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, Coord, Serial, Data = MoveTemp(Data)]() mutable
+			{
+				if (AMinesweeper3DBlockGrid* Grid = WeakThis.Get())	Grid->OnEndlessChunkBuilt(Coord, Serial, Data);
+			});
+		});
+	}
+}
+
+void AMinesweeper3DBlockGrid::OnEndlessChunkBuilt(const FIntVector& Coord, uint32 Serial, FMinesweeper3DChunkMeshData& Data)
+{
+	DEC_DWORD_STAT(STAT_ChunkBuildsInFlight);
+	ChunkBuildsInFlight--;
+
+	//Streamed out, or out and back in again, since the build started
+	FMinesweeper3DEndlessChunk* Chunk = EndlessChunks.Find(Coord);
+	if (!Chunk || Chunk->Serial != Serial)
+	{
+		//A build from the last board still frees a slot for this one
+		if (bChunkBuildsQueued && bEndlessMode)	FlushEndlessChunkBuilds();
+		else if (bChunkBuildsQueued)	FlushChunkBuilds();
+		return;
+	}
+
+	Chunk->State.bBuilding = false;
+	DEC_DWORD_STAT_BY(STAT_ChunkTriangles, Chunk->State.NumTriangles);
+	Chunk->State.NumTriangles = Data.Triangles.Num() / 3;
+	INC_DWORD_STAT_BY(STAT_ChunkTriangles, Chunk->State.NumTriangles);
+
+	UProceduralMeshComponent* Mesh = ChunkMeshes[Chunk->Mesh];
+	if (Data.IsEmpty())
+	{
+		Mesh->ClearMeshSection(0);
+	}
+	else
+	{
+		Mesh->CreateMeshSection(0, Data.Vertices, Data.Triangles, Data.Normals, TArray<FVector2D>(), Data.Colors, TArray<FProcMeshTangent>(), true);
+	}
+
+	if (Chunk->State.bDirty || bChunkBuildsQueued)	FlushEndlessChunkBuilds();
+}
+
+void AMinesweeper3DBlockGrid::RevealEndlessCell(const FIntVector& Pos)
+{
+	if (bGameLost || EndlessBoard.GetState(Pos) != EMinesweeper3DCellState::Hidden)	return;
+
+	//The mine function keeps the first click and its neighbours clear, so it has to know where that is before anything is revealed
+	if (bFirstClick)
+	{
+		EndlessBoard.SetFirstClick(Pos);
+		GameStartTime = GetWorld()->GetTimeSeconds();
+		GetWorldTimerManager().SetTimer(GameClockTimer, this, &AMinesweeper3DBlockGrid::AdvanceTimer, 1.0f, true);
+		bFirstClick = false;
+	}
+
+	NumClicks++;
+
+	TArray<FIntVector> Revealed;
+	if (EndlessBoard.Reveal(Pos, EndlessRegionMin, EndlessRegionMax, Revealed))
+	{
+		SetGameState(false, true);
+		EndlessBoard.PendingFlood.Empty();
+		EndlessBoard.RevealMines(EndlessRegionMin, EndlessRegionMax, Revealed);
+		GetWorldTimerManager().ClearTimer(GameClockTimer);
+	}
+	EndlessCellsRevealed = EndlessBoard.NumRevealed;
+
+	MarkEndlessCellsDirty(Revealed);
+	FlushEndlessChunkBuilds();
+	bLODDirty = true;
+	WakeCamera();
+}
+
+void AMinesweeper3DBlockGrid::FlagEndlessCell(const FIntVector& Pos)
+{
+	bool bFlagged;
+	if (bGameLost || !EndlessBoard.ToggleFlag(Pos, bFlagged))	return;
+
+	NumClicks++;
+	MarkEndlessCellsDirty({ Pos });
+	FlushEndlessChunkBuilds();
+}
+
+void AMinesweeper3DBlockGrid::UpdateEndlessDetailBlocks(const FVector& CameraLocation, float DetailDistanceSq)
+{
+	struct FCandidate
+	{
+		float DistanceSq;
+		FIntVector Pos;
+	};
+	TArray<FCandidate> Candidates;
+	for (const TPair<FIntVector, FMinesweeper3DEndlessChunk>& Pair : EndlessChunks)
+	{
+		const FMinesweeper3DEndlessBoard::FPagePtr Page = EndlessBoard.FindPage(Pair.Key);
+		if (!Page.IsValid())	continue;
+
+		const FIntVector PageMin = Pair.Key * FMinesweeper3DEndlessBoard::PageSize;
+		for (uint16 Local : Page->Numbered)
+		{
+			const FIntVector Pos = PageMin + FMinesweeper3DEndlessBoard::FromPageIndex(Local);
+			const float DistanceSq = FVector::DistSquared(CameraLocation, FVector(Pos) * BlockSpacing);
+			if (DistanceSq < DetailDistanceSq)	Candidates.Add({ DistanceSq, Pos });
+		}
+	}
+
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistanceSq < B.DistanceSq; });
+	const int32 MaxDetailed = GetMaxDetailedBlocks();
+	if (Candidates.Num() > MaxDetailed)	Candidates.SetNum(MaxDetailed, false);
+
+	//Blocks come off cells that dropped out first, so they're back in the pool for the ones coming in
+	TSet<FIntVector> Keep;
+	Keep.Reserve(Candidates.Num());
+	for (const FCandidate& Candidate : Candidates)
+	{
+		Keep.Add(Candidate.Pos);
+	}
+	for (auto It = EndlessDetailBlocks.CreateIterator(); It; ++It)
+	{
+		if (Keep.Contains(It.Key()))	continue;
+
+		if (It.Value())	PoolBlock(It.Value());
+		It.RemoveCurrent();
+	}
+
+	for (const FCandidate& Candidate : Candidates)
+	{
+		if (EndlessDetailBlocks.Contains(Candidate.Pos))	continue;
+
+		AMinesweeper3DBlock* Block = AcquireBlock(FVector(Candidate.Pos) * BlockSpacing);
+		if (!Block)	continue;
+
+		Block->ShowRevealed(EndlessBoard.Mines.CountMines(Candidate.Pos));
+		Block->SetDetailed(true);
+		EndlessDetailBlocks.Add(Candidate.Pos, Block);
+	}
+
+	SET_DWORD_STAT(STAT_DetailedNumberBlocks, EndlessDetailBlocks.Num());
+}
+
+/*---------- Utility ----------*/
+
+void AMinesweeper3DBlockGrid::CheckForWin()
+{
+	const bool bWon = Board.BlocksRemaining == NumMines;
+	if (bWon && !bGameWon)	UpdateGameStats();
+
+	SetGameState(bWon, bGameLost);
+	if (bGameWon)
+	{
+		GetWorldTimerManager().ClearTimer(GameClockTimer);
+		RecordGame();
+	}
+}
+
+/*---------- History ----------*/
+
+void AMinesweeper3DBlockGrid::RecordGame()
+{
+	//A puzzle's seed doesn't regenerate it, and its time doesn't compare with generated boards of the same size. Nor does
+	//a shaped board's, the history only knows uniform ones.
+	if (bUsedPractice || bPuzzleGame || !Board.Density.IsUniform())	return;
+
+	FMinesweeper3DGameRecord Record;
+	Record.Shape = Shape;
+	Record.NumMines = NumMines;
+	Record.Seed = Board.Seed;
+	Record.Time = GetWorld()->GetTimeSeconds() - GameStartTime;
+	Record.bWon = bGameWon;
+	Record.Clicks = NumClicks;
+	Record.ThreeBV = Board.ThreeBV;
+	Record.Date = FDateTime::UtcNow();
+
+	if (IsLocallyControlled())	AddToHistory(Record);
+	else ClientRecordGame(Record);
+}
+
+void AMinesweeper3DBlockGrid::ClientRecordGame_Implementation(const FMinesweeper3DGameRecord& Record)
+{
+	AddToHistory(Record);
+}
+
+void AMinesweeper3DBlockGrid::AddToHistory(const FMinesweeper3DGameRecord& Record)
+{
+	if (!History)	return;
+
+	History->Add(Record);
+	OnGameRecorded.Broadcast(Record);
+}
+
+bool AMinesweeper3DBlockGrid::GetBestTime(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, FMinesweeper3DGameRecord& OutRecord) const
+{
+	return History && History->GetBestTime(InShape, InNumMines, OutRecord);
+}
+
+float AMinesweeper3DBlockGrid::GetTimePercentile(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, float Time) const
+{
+	return History ? History->GetTimePercentile(InShape, InNumMines, Time) : 0.f;
+}
+
+int32 AMinesweeper3DBlockGrid::GetGamesPlayed(const FMinesweeper3DBoardShape& InShape, int32 InNumMines) const
+{
+	return History ? History->GetNumGames(InShape, InNumMines) : 0;
+}
+
+int32 AMinesweeper3DBlockGrid::GetGamesWon(const FMinesweeper3DBoardShape& InShape, int32 InNumMines) const
+{
+	return History ? History->GetNumWins(InShape, InNumMines) : 0;
+}
+
+/*---------- Minimap ----------*/
+
+FMinesweeper3DCellCounts AMinesweeper3DBlockGrid::CountCellsInBox(const FIntVector& Min, const FIntVector& Max)
+{
+	if (bEndlessMode)	return FMinesweeper3DCellCounts();
+	return Board.CountCellsInBox(Min, Max);
+}
+
+FMinesweeper3DCellCounts AMinesweeper3DBlockGrid::GetMinimapColumn(int32 Axis, int32 U, int32 V) const
+{
+	if (bEndlessMode || Axis < 0 || Axis > 2)	return FMinesweeper3DCellCounts();
+	return Board.Tally.GetColumn(Axis, U, V);
+}
+
+UTexture2D* AMinesweeper3DBlockGrid::GetMinimapTexture(int32 Axis)
+{
+	if (bEndlessMode || Axis < 0 || Axis > 2)	return nullptr;
+
+	const FIntPoint Size = Board.Tally.GetProjectionSize(Axis);
+	if (Size.X <= 0 || Size.Y <= 0)	return nullptr;
+
+	//A new board size needs a new texture, and all of it uploading
+	UTexture2D*& Texture = MinimapTextures[Axis];
+	const bool bNewTexture = !Texture || Texture->GetSizeX() != Size.X || Texture->GetSizeY() != Size.Y;
+	if (bNewTexture)
+	{
+		Texture = UTexture2D::CreateTransient(Size.X, Size.Y, PF_B8G8R8A8);
+		if (!Texture)	return nullptr;
+
+		Texture->Filter = TF_Nearest;
+		Texture->SRGB = false;
+		Texture->UpdateResource();
+	}
+
+	FIntRect Dirty;
+	if (!Board.Tally.TakeDirtyColumns(Axis, Dirty) && !bNewTexture)	return Texture;
+	if (bNewTexture)	Dirty = FIntRect(FIntPoint::ZeroValue, Size - FIntPoint(1, 1));
+
+	//U runs across the texture and V down it, as it was created. The render thread frees the texels once they're uploaded.
+	const int32 Width = Dirty.Max.X - Dirty.Min.X + 1;
+	const int32 Height = Dirty.Max.Y - Dirty.Min.Y + 1;
+	FColor* Texels = new FColor[Width * Height];
+	const int32 Length = Board.Tally.GetDims()[Axis];
+	for (int32 V = Dirty.Min.Y; V <= Dirty.Max.Y; V++)
+	{
+		for (int32 U = Dirty.Min.X; U <= Dirty.Max.X; U++)
+		{
+			const FMinesweeper3DCellCounts Column = Board.Tally.GetColumn(Axis, U, V);
+			FColor& Texel = Texels[(V - Dirty.Min.Y) * Width + U - Dirty.Min.X];
+			Texel.R = (uint8)(Column.Hidden * 255 / Length);
+			Texel.G = (uint8)(Column.Flagged * 255 / Length);
+			Texel.B = (uint8)(Column.Revealed * 255 / Length);
+			Texel.A = Column.Hidden > 0 ? 255 : 0;
+		}
+	}
+
+	FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(Dirty.Min.X, Dirty.Min.Y, 0, 0, Width, Height);
+	Texture->UpdateTextureRegions(0, 1, Region, Width * sizeof(FColor), sizeof(FColor), (uint8*)Texels,
+		[](uint8* SrcData, const FUpdateTextureRegion2D* Regions)
+	{
+		delete[] (FColor*)SrcData;
+		delete Regions;
+	});
+	return Texture;
+}
+
+/*---------- Level of Detail ----------*/
+
+void AMinesweeper3DBlockGrid::AddNumberedBlock(AMinesweeper3DBlock* Block)
+{
+	//Chunked boards track numbered cells themselves, their blocks come and go with the camera
+	if (bChunkedBoard)	return;
+
+	NumberedCells.Add(Block->Handle.Index);
+	bLODDirty = true;
+	WakeCamera();
+}
+
+void AMinesweeper3DBlockGrid::RemoveNumberedBlock(AMinesweeper3DBlock* Block)
+{
+	if (bChunkedBoard)	return;
+
+	NumberedCells.RemoveSwap(Block->Handle.Index);
+	if (FocusedBlock == Block->Handle)	FocusedBlock = FMinesweeper3DBlockHandle();
+	bLODDirty = true;
+	WakeCamera();
+}
+
+void AMinesweeper3DBlockGrid::SetFocusedBlock(AMinesweeper3DBlock* Block, bool bFocused)
+{
+	if (bFocused)	FocusedBlock = Block->Handle;
+	else if (FocusedBlock == Block->Handle)	FocusedBlock = FMinesweeper3DBlockHandle();
+	bLODDirty = true;
+	WakeCamera();
+}
+
+//Picks which numbered blocks show their digit. Only runs when the camera has moved far enough or the set of numbered blocks changed.
+void AMinesweeper3DBlockGrid::UpdateBlockLODs()
+{
+	const FVector CameraLocation = Camera->GetActorLocation();
+	if (!bLODDirty && FVector::DistSquared(CameraLocation, LastLODCameraLocation) < LODUpdateDistance * LODUpdateDistance)	return;
+
+	SCOPE_CYCLE_COUNTER(STAT_UpdateBlockLODs);
+	bLODDirty = false;
+	LastLODCameraLocation = CameraLocation;
+
+	//Measure from the front of the cube, so the detailed shell is the same thickness however far out the camera is zoomed
+	const float HalfDiagonal = 0.5f * BlockSpacing * FVector(Shape.GetLayoutDims()).Size();
+	const float DetailDistance = FMath::Max(DistanceFromCenter() - HalfDiagonal, 0.f) + GetDetailDepth();
+	const float DetailDistanceSq = DetailDistance * DetailDistance;
+
+	if (bEndlessMode)
+	{
+		UpdateEndlessDetailBlocks(CameraLocation, DetailDistanceSq);
+		return;
+	}
+	if (bChunkedBoard)
+	{
+		UpdateChunkDetailBlocks(CameraLocation, DetailDistanceSq);
+		return;
+	}
+
+	struct FCandidate
+	{
+		float DistanceSq;
+		AMinesweeper3DBlock* Block;
+	};
+	TArray<FCandidate> Candidates;
+	for (int32 Index : NumberedCells)
+	{
+		AMinesweeper3DBlock* Block = BlockSlots[Index];
+		const bool bFocused = Block->Handle == FocusedBlock;
+		const float DistanceSq = FVector::DistSquared(CameraLocation, Block->GetActorLocation());
+		if (DistanceSq < DetailDistanceSq && !bFocused)
+		{
+			Candidates.Add({ DistanceSq, Block });
+		}
+		else
+		{
+			Block->SetDetailed(bFocused);
+		}
+	}
+
+	Candidates.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistanceSq < B.DistanceSq; });
+	const int32 MaxDetailed = GetMaxDetailedBlocks();
+	for (int32 i = 0; i < Candidates.Num(); i++)
+	{
+		Candidates[i].Block->SetDetailed(i < MaxDetailed);
+	}
+
+	int32 Detailed = 0;
+	for (int32 Index : NumberedCells)
+	{
+		if (BlockSlots[Index]->bDetailed)	Detailed++;
+	}
+	SET_DWORD_STAT(STAT_DetailedNumberBlocks, Detailed);
+}
+
+float AMinesweeper3DBlockGrid::DistanceFromCenter()
+{
+	float X = Camera->GetActorLocation().X - CubeCenter.X;
+	float Y = Camera->GetActorLocation().Y - CubeCenter.Y;
+	float Z = Camera->GetActorLocation().Z - CubeCenter.Z;
+	return FMath::Sqrt(X * X + Y * Y + Z * Z);
+}
+
+void AMinesweeper3DBlockGrid::AdvanceTimer()
+{
+	SetElapsedTime(ElapsedTime + 1);
+}
+
+/*---------- HUD ----------*/
+
+void AMinesweeper3DBlockGrid::SetMinesRemaining(int32 NewMinesRemaining)
+{
+	if (MinesRemaining == NewMinesRemaining)	return;
+
+	MinesRemaining = NewMinesRemaining;
+	OnMinesRemainingChanged.Broadcast(MinesRemaining);
+	PublishSharedStatus();
+}
+
+void AMinesweeper3DBlockGrid::SetElapsedTime(int32 NewElapsedTime)
+{
+	if (ElapsedTime == NewElapsedTime)	return;
+
+	ElapsedTime = NewElapsedTime;
+	OnTimerTick.Broadcast(ElapsedTime);
+	PublishSharedStatus();
+}
+
+void AMinesweeper3DBlockGrid::SetGameState(bool bNewGameWon, bool bNewGameLost)
+{
+	if (bGameWon == bNewGameWon && bGameLost == bNewGameLost)	return;
+
+	bGameWon = bNewGameWon;
+	bGameLost = bNewGameLost;
+	OnGameStateChanged.Broadcast(bGameWon, bGameLost);
+	PublishSharedStatus();
+
+	//Nothing left to resume. Practice mode can undo its way back, so keeps journaling.
+	if (Journal && (bGameWon || bGameLost) && !bUsedPractice)	Journal->EndGame();
+}
+
+void AMinesweeper3DBlockGrid::UpdateGameStats()
+{
+	const float Time = GetWorld()->GetTimeSeconds() - GameStartTime;
+	const int32 Solved3BV = Board.BlocksRemaining == NumMines ? Board.ThreeBV : Board.CalcSolved3BV();
+	ThreeBVPerSecond = Time > 0.f ? Solved3BV / Time : 0.f;
+}
+
+void AMinesweeper3DBlockGrid::BroadcastHUDState()
+{
+	OnMinesRemainingChanged.Broadcast(MinesRemaining);
+	OnTimerTick.Broadcast(ElapsedTime);
+	OnGameStateChanged.Broadcast(bGameWon, bGameLost);
+}
+
+//Replicated values on a client arrive without going through the setters, so broadcast from here
+void AMinesweeper3DBlockGrid::OnRep_MinesRemaining()
+{
+	OnMinesRemainingChanged.Broadcast(MinesRemaining);
+	PublishSharedStatus();
+}
+
+void AMinesweeper3DBlockGrid::OnRep_ElapsedTime()
+{
+	OnTimerTick.Broadcast(ElapsedTime);
+	PublishSharedStatus();
+}
+
+void AMinesweeper3DBlockGrid::OnRep_GameState()
+{
+	OnGameStateChanged.Broadcast(bGameWon, bGameLost);
+	PublishSharedStatus();
+}
+
+/*---------- Shared board ----------*/
+
+void AMinesweeper3DBlockGrid::PublishSharedStatus()
+{
+	if (SharedBoard)	SharedBoard->PublishStatus(NumMines, MinesRemaining, ElapsedTime, bGameWon, bGameLost);
+}
+
+//Moves from outside take the same path as clicks, so they're checked the same way, on the server if we're a client
+void AMinesweeper3DBlockGrid::OnSharedCommand(EMinesweeper3DSharedCommand Command, int32 Index)
+{
+	if (bEndlessMode || !Board.IsValidIndex(Index))	return;
+
+	if (Command == EMinesweeper3DSharedCommand::Reveal)	RequestRevealCell(Index);
+	else RequestFlagCell(Index);
 }
 
 #undef LOCTEXT_NAMESPACE
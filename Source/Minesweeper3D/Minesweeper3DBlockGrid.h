@@ -6,11 +6,67 @@
 #include "GameFramework/Pawn.h"
 #include "Containers/Array.h"
 #include "Minesweeper3DBlock.h"
+#include "Minesweeper3DBoard.h"
+#include "Minesweeper3DGameHistory.h"
+#include "Minesweeper3DJournal.h"
+#include "Minesweeper3DSharedBoard.h"
+#include "Minesweeper3DChunkMesher.h"
+#include "Minesweeper3DEndlessBoard.h"
+#include "Minesweeper3DPuzzlePack.h"
+#include "Minesweeper3DFrameGovernor.h"
+#include "Async/Future.h"
 #include "Camera/CameraComponent.h"
 #include "Blueprint/UserWidget.h"
 #include "Components/CheckBox.h"
 #include "Minesweeper3DBlockGrid.generated.h"
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnMinesRemainingChanged, int32, MinesRemaining);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnTimerTick, int32, ElapsedTime);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnGameStateChanged, bool, bGameWon, bool, bGameLost);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnGameRecorded, const FMinesweeper3DGameRecord&, Record);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnBoardSizeWarning, const FString&, Warning);
+
+/** How the board is drawn */
+UENUM(BlueprintType)
+enum class EMinesweeper3DRenderMode : uint8
+{
+	//One block actor per cell
+	Blocks,
+	//The unrevealed volume as greedy meshed chunks, with block actors only for the numbered cells nearest the camera
+	Chunks,
+	//Chunks once the board has at least ChunkedRenderMinCells cells, blocks below that
+	Auto
+};
+
+/** Build bookkeeping for one chunk of a chunked board */
+struct FMinesweeper3DChunkState
+{
+	//Something in or next to the chunk changed since its last build was started
+	bool bDirty = false;
+	//A worker is building it right now. It isn't started again until that lands.
+	bool bBuilding = false;
+	//What its mesh section has now, for the triangle stat
+	int32 NumTriangles = 0;
+};
+
+/** A streamed in chunk of an endless board */
+struct FMinesweeper3DEndlessChunk
+{
+	//Index into ChunkMeshes
+	int32 Mesh = INDEX_NONE;
+	//Never reused, so a build started before the chunk streamed out (and maybe back in) is recognised when it lands
+	uint32 Serial = 0;
+	FMinesweeper3DChunkState State;
+};
+
+/** One entry on the practice mode undo/redo stacks */
+struct FMinesweeper3DUndoStep
+{
+	FMinesweeper3DBoardSnapshot Board;
+	bool bGameLost = false;
+	bool bGameWon = false;
+};
+
 /** Class used to spawn blocks and manage score */
 UCLASS(minimalapi)
 class AMinesweeper3DBlockGrid : public APawn
@@ -24,57 +80,309 @@ class AMinesweeper3DBlockGrid : public APawn
 public:
 	AMinesweeper3DBlockGrid();
 
-	/** Number of blocks along each side of grid */
+	/** Number of blocks along each axis of the grid, and which axes wrap around */
 	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadOnly)
-	int32 Size = 0;
+	FMinesweeper3DBoardShape Shape;
 
-	//The size of the next grid to be generated -- we can't update the regular Size parameter until DestroyBlocks() is finished or we'll go out of bounds
-	int32 NewSize = 0;
+	//The shape of the next grid to be generated -- we can't update the regular Shape parameter until ReleaseBlocks() is finished or we'll go out of bounds
+	FMinesweeper3DBoardShape NewShape;
 
 	float MinesPercentage = 0.068;
 	int NumMines = 0;
 
-	//The number displaying how many mines the player has yet to find
+	//Where the mines of the next game go. Uniform unless a custom game picks a shape or paints one.
 	UPROPERTY(BlueprintReadOnly)
-	int MinesRemaining = 0;
+	FMinesweeper3DDensity Density;
 
-	//Used to check win condition (blocks remaining = num mines)
-	int BlocksRemaining = 0;
+	//The number displaying how many mines the player has yet to find
+	UPROPERTY(ReplicatedUsing = OnRep_MinesRemaining, BlueprintReadOnly)
+	int MinesRemaining = 0;
 
-	UPROPERTY(BlueprintReadOnly)
+	UPROPERTY(ReplicatedUsing = OnRep_ElapsedTime, BlueprintReadOnly)
 	int ElapsedTime = 0;
 
+	//Difficulty of the current board, known once the first click has placed the mines
+	UPROPERTY(Replicated, BlueprintReadOnly)
+	int32 ThreeBV = 0;
+
+	//3BV cleared per second, set when the game ends. A loss only counts the part of the board that was cleared.
+	UPROPERTY(Replicated, BlueprintReadOnly)
+	float ThreeBVPerSecond = 0.f;
+
+	//The HUD binds to these instead of polling the values above every frame, so it only repaints when something changed
+	UPROPERTY(BlueprintAssignable, Category = "UMG Game")
+	FOnMinesRemainingChanged OnMinesRemainingChanged;
+
+	UPROPERTY(BlueprintAssignable, Category = "UMG Game")
+	FOnTimerTick OnTimerTick;
+
+	UPROPERTY(BlueprintAssignable, Category = "UMG Game")
+	FOnGameStateChanged OnGameStateChanged;
+
+	//Fired on the owning player's machine once a finished game is in the history, after the indexes include it
+	UPROPERTY(BlueprintAssignable, Category = "UMG Game")
+	FOnGameRecorded OnGameRecorded;
+
+	//Fired when a custom size is turned down, or will be drawn as chunks, because this machine can't take it as asked
+	UPROPERTY(BlueprintAssignable, Category = "UMG Game")
+	FOnBoardSizeWarning OnBoardSizeWarning;
+
 	/** Spacing of blocks */
 	UPROPERTY(Category=Grid, EditAnywhere, BlueprintReadOnly)
 	float BlockSpacing;
 
-	//3D array of all the blocks this grid manages
-	TArray< TArray< TArray< AMinesweeper3DBlock*> > > Blocks;
+	//Extra space between the 3D slices of a 4D board, in blocks
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadOnly)
+	float SliceGap = 2.f;
+
+	//The block on each board cell, by flat cell index. Only the locally controlled grid spawns blocks, a dedicated server has none.
+	UPROPERTY()
+	TArray<AMinesweeper3DBlock*> BlockSlots;
+
+	//Generation of each slot, bumped every time its block is released. Never shrinks, so a handle from a bigger board stays stale too.
+	TArray<uint32> BlockGenerations;
+
+	//Flat board state and the Reveal/Flag rules. Mines are only ever placed on the authority's copy.
+	FMinesweeper3DBoard Board;
+
+	//The board after this one, reset and shuffled on a worker thread while the current game is played, so starting it is a swap
+	TSharedPtr<FMinesweeper3DBoard, ESPMode::ThreadSafe> NextBoard;
+	TFuture<void> NextBoardTask;
+	FMinesweeper3DBoardShape NextBoardShape;
+	int32 NextBoardMines = 0;
+	FMinesweeper3DDensity NextBoardDensity;
+
+	//Block actors from earlier boards, hidden and waiting to be placed on the next one instead of spawning new actors
+	UPROPERTY()
+	TArray<AMinesweeper3DBlock*> BlockPool;
+
+	//While the settings menu is up before the first game, this many blocks a frame are spawned into the pool
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	int32 PoolWarmBlocksPerFrame = 256;
+
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	EMinesweeper3DRenderMode RenderMode = EMinesweeper3DRenderMode::Auto;
+
+	//Boards this big or bigger are drawn as chunks in Auto mode. 32^3 by default.
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	int32 ChunkedRenderMinCells = 32768;
+
+	//Whether the current board is drawn as chunks, picked when it's reset
+	UPROPERTY(BlueprintReadOnly)
+	bool bChunkedBoard = false;
+
+	//Vertex coloured material for the chunk surfaces
+	UPROPERTY()
+	class UMaterialInterface* ChunkMaterial;
+
+	//One mesh per chunk so rebuilding a chunk only recreates its own render proxy. Kept between boards like the blocks are.
+	UPROPERTY()
+	TArray<class UProceduralMeshComponent*> ChunkMeshes;
+
+	TArray<FMinesweeper3DChunkState> ChunkStates;
+	FIntVector NumChunks = FIntVector::ZeroValue;
+
+	//Bumped whenever the chunks are released, so builds still running for an old board are thrown away when they land
+	uint32 ChunkEpoch = 0;
+
+	//Set once a delta has revealed a mine, from then on chunk builds need the counts to keep mines solid
+	bool bChunkMinesShown = false;
+
+	//Endless mode has no size. Mines are a hash of the seed and coordinates, and chunks stream in and out around the camera.
+	UPROPERTY(BlueprintReadOnly)
+	bool bEndlessMode = false;
+
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	float EndlessMineDensity = 0.12f;
+
+	//Chunks streamed in either side of the one the camera is looking at
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	int32 EndlessStreamRadius = 2;
+
+	//Cells revealed so far this endless game, its score
+	UPROPERTY(BlueprintReadOnly)
+	int32 EndlessCellsRevealed = 0;
+
+	FMinesweeper3DEndlessBoard EndlessBoard;
+	TMap<FIntVector, FMinesweeper3DEndlessChunk> EndlessChunks;
+	uint32 NextEndlessChunkSerial = 0;
+
+	//ChunkMeshes not used by a streamed in chunk
+	TArray<int32> FreeChunkMeshes;
+
+	//Chunk the streamed region is centred on, and the cells it covers
+	FIntVector EndlessStreamCenter = FIntVector::ZeroValue;
+	FIntVector EndlessRegionMin = FIntVector::ZeroValue;
+	FIntVector EndlessRegionMax = FIntVector::ZeroValue;
+
+	//Blocks showing digits on the nearest revealed cells of an endless board. There's no flat index to keep them in BlockSlots by.
+	UPROPERTY()
+	TMap<FIntVector, AMinesweeper3DBlock*> EndlessDetailBlocks;
+
+	//Whether the current board came out of a puzzle pack rather than being generated
+	UPROPERTY(BlueprintReadOnly)
+	bool bPuzzleGame = false;
+
+	//The last pack a puzzle was played from, kept open with its index so moving on to the next puzzle is a seek
+	TUniquePtr<FMinesweeper3DPuzzlePack> PuzzlePack;
+
+	//Which puzzle in PuzzlePack is being played, while bPuzzleGame
+	int32 CurrentPuzzle = INDEX_NONE;
+
+	//Practice mode lets the player undo reveals (including whole flood reveals) and flags
+	UPROPERTY(BlueprintReadOnly)
+	bool bPracticeMode = false;
+
+	//Whether practice mode was on at any point this game. Turning it off again doesn't make the result count.
+	bool bUsedPractice = false;
+
+	//Snapshots share board pages with each other and the live board, so each step only costs the pages it changed
+	TArray<FMinesweeper3DUndoStep> UndoStack;
+	TArray<FMinesweeper3DUndoStep> RedoStack;
+
+	//Oldest steps are dropped past this many
+	static constexpr int32 MaxUndoSteps = 1024;
+
+	//Reveals and flags accepted this game, and when the first one landed (world time, so pausing stops it)
+	int32 NumClicks = 0;
+	float GameStartTime = 0.f;
+
+	//Past games on this machine. Only locally controlled grids hold it, and they all share the one store in the process.
+	TSharedPtr<FMinesweeper3DGameHistory> History;
+
+	//The game in progress, so it can be picked up again after a crash. Only a grid that's both local and the authority
+	//has one, since it needs the mines. Endless games aren't journaled.
+	TUniquePtr<FMinesweeper3DJournal> Journal;
+
+	//Set while a resumed game's changes are replayed, so they aren't journaled a second time
+	bool bReplayingJournal = false;
+
+	//Scales LOD, chunk builds and pool warming to hold FrameBudgetMs. Only locally controlled grids hold it, and they all
+	//share the one governor in the process.
+	TSharedPtr<FMinesweeper3DFrameGovernor> Governor;
+	FDelegateHandle QualityChangedHandle;
+
+	//Read once, when the governor is made, so with several local grids it's the first one's
+	UPROPERTY(Category = Performance, EditAnywhere)
+	float FrameBudgetMs = 1000.f / 60.f;
+
+	//The board as the player sees it, in shared memory for bots and analysis tools, which can send moves back. Only the
+	//locally controlled grid has one, and only with bPublishSharedBoard set or -Minesweeper3DSharedBoard on the command line.
+	TUniquePtr<FMinesweeper3DSharedBoard> SharedBoard;
+
+	UPROPERTY(Category = Tools, EditAnywhere)
+	bool bPublishSharedBoard = false;
+
+	UPROPERTY(Category = Tools, EditAnywhere)
+	FString SharedBoardName = TEXT("Minesweeper3D");
+
+	//Boards with more cells than this aren't published. Read once, when the segment is made.
+	UPROPERTY(Category = Tools, EditAnywhere)
+	int32 SharedBoardMaxCells = 128 * 128 * 128;
+
+	//Boards that would take longer than this to spawn as blocks are drawn as chunks, whatever RenderMode says
+	UPROPERTY(Category = Performance, EditAnywhere, BlueprintReadWrite)
+	float MaxBlockSpawnSeconds = 2.f;
+
+	//Custom sizes needing more than this fraction of the free physical memory are turned down
+	UPROPERTY(Category = Performance, EditAnywhere, BlueprintReadWrite)
+	float MaxBoardMemoryFraction = 0.5f;
 
-	//Used to randomize all the blocks and choose some number to be mines
-	TArray<AMinesweeper3DBlock*> BlockList;
+	//Chunk builds on the thread pool right now, capped by the governor so a big flood can't queue hundreds at once
+	int32 ChunkBuildsInFlight = 0;
+	//Set when a flush left dirty chunks unstarted for want of a slot, so the next build to land starts them
+	bool bChunkBuildsQueued = false;
 
-	//List of meshes for each case of 1-26 mines surrounding a block. Index 0 is the mesh for a mine, all the others are assigned numerically
-	TArray<UStaticMesh*> NumberFaces;
+	//Slice mode only draws (and lets the player click) layers SliceMin..SliceMax along SliceAxis
+	UPROPERTY(BlueprintReadOnly)
+	bool bSliceMode = false;
+
+	//0 = X, 1 = Y, 2 = Z
+	UPROPERTY(BlueprintReadOnly)
+	int32 SliceAxis = 2;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 SliceMin = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 SliceMax = 0;
+
+	//Minimap projections down X, Y and Z, made the first time the HUD asks for each
+	UPROPERTY(Transient)
+	class UTexture2D* MinimapTextures[3];
+
+	//Layers either side of the slice drawn as ghosts for context
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	int32 SliceGhostLayers = 1;
+
+	//How fast holding UpDown/InOut steps through layers in slice mode
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	float SliceStepsPerSecond = 6.f;
+
+	float SliceMoveAccumulator = 0.f;
+	float SliceThicknessAccumulator = 0.f;
+
+	//Whether each axis was already held last frame, so the first frame of a press steps straight away
+	bool bSliceMoveHeld = false;
+	bool bSliceThicknessHeld = false;
+
+	FDelegateHandle FirstFrameHandle;
+
+	//Numbered blocks within this distance of the front of the cube (as seen from the camera) show their digit
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	float LODDetailDepth = 400.f;
+
+	//Never draw more than this many numbered blocks with their digit, so the atlas sampling cost stays flat as the board grows
+	UPROPERTY(Category = Grid, EditAnywhere, BlueprintReadWrite)
+	int32 MaxDetailedBlocks = 256;
+
+	//How far the camera has to move before LODs are picked again
+	float LODUpdateDistance = 50.f;
+	FVector LastLODCameraLocation;
+	bool bLODDirty = false;
+
+	//Cells whose revealed block shows a count of 1..26, the only ones with a detail level to pick
+	TArray<int32> NumberedCells;
+
+	//The block under the cursor always shows its digit
+	FMinesweeper3DBlockHandle FocusedBlock;
 
 	//Reference to the camera we grab from the scene in BeginPlay
 	AActor* Camera;
 
-	//Camera location and rotation variables
+	//Camera location and rotation variables. The Target values are where input wants the camera, the others ease towards them.
 	float theta;
 	float phi;
 	float radius;
+	float TargetTheta;
+	float TargetPhi;
+	float TargetRadius;
 	FVector CubeCenter;
 
 	FVector TranslationInputDirection;
+	FVector CameraVelocity = FVector::ZeroVector;
+
+	//Units per second the camera flies at with a translation axis held
+	UPROPERTY(Category = Camera, EditAnywhere, BlueprintReadWrite)
+	float CameraMoveSpeed = 600.f;
+
+	//Interpolation speed for orbiting, zooming and starting/stopping, higher is snappier
+	UPROPERTY(Category = Camera, EditAnywhere, BlueprintReadWrite)
+	float CameraSmoothing = 12.f;
 
 	//Overlay widgets
 	TSubclassOf<UUserWidget> SettingsWidget;
 	TSubclassOf<UUserWidget> HUDWidget;
 	TSubclassOf<UUserWidget> CustomSettingsWidget;
+	UPROPERTY()
 	UUserWidget* ActiveWidget;
+	UPROPERTY()
 	UUserWidget* SecondaryWidget;
 
+	//Every widget we've shown, created once and reused each time its menu opens again
+	UPROPERTY()
+	TMap<UClass*, UUserWidget*> WidgetCache;
+
 	FTimerHandle GameClockTimer;
 
 	//The rate at which the camera zooms, used in ZoomCamera()
@@ -86,31 +394,175 @@ public:
 	//Whether we're in the settings menu or using the HUD
 	bool bIsSettings;
 	//Whether the game has been lost yet or not
-	UPROPERTY(BlueprintReadOnly)
+	UPROPERTY(ReplicatedUsing = OnRep_GameState, BlueprintReadOnly)
 	bool bGameLost = false;
 	//Whether the game has been won or not
-	UPROPERTY(BlueprintReadOnly)
+	UPROPERTY(ReplicatedUsing = OnRep_GameState, BlueprintReadOnly)
 	bool bGameWon = false;
 	
 	bool bIsFreeCam = false;
+	//Whether the camera and menus have been set up for the player controlling this grid
+	bool bLocalViewInitialized = false;
+
+	//Largest board a client is allowed to ask the server for
+	static constexpr int32 MaxNetSize = 64;
 
 protected:
 	// Begin AActor interface
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	// End AActor interface
 
+	// Begin APawn interface
+	virtual void PawnClientRestart() override;
+	// End APawn interface
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "UMG Game")
 	TSubclassOf<UUserWidget> StartingWidgetClass;
 
 	UPROPERTY()
 	UUserWidget* CurrentWidget;
 
+	UFUNCTION()
+	void OnRep_MinesRemaining();
+
+	UFUNCTION()
+	void OnRep_ElapsedTime();
+
+	UFUNCTION()
+	void OnRep_GameState();
+
 private:
+	//HUD values only change through these, so the delegates fire exactly when something changed
+	void SetMinesRemaining(int32 NewMinesRemaining);
+	void SetElapsedTime(int32 NewElapsedTime);
+	void SetGameState(bool bNewGameWon, bool bNewGameLost);
+	//Works out ThreeBVPerSecond for a game that's just ended. Called before SetGameState so the HUD sees it with the result.
+	void UpdateGameStats();
+	void BroadcastHUDState();
+	void PublishSharedStatus();
+	void OnSharedCommand(EMinesweeper3DSharedCommand Command, int32 Index);
+
+	UUserWidget* GetOrCreateWidget(TSubclassOf<UUserWidget> WidgetClass);
+	void ShowWidget(UUserWidget* Widget);
+	void HideWidget(UUserWidget* Widget);
+
 	void GenerateBlocks();
-	void GenerateMines();
-	void AssignSurroundingMineTotals();
-	void DestroyBlocks();
-	void SafelockBlocks(AMinesweeper3DBlock* block);
+	void ReleaseBlocks();
+	AMinesweeper3DBlock* AcquireBlock(const FVector& Location);
+	void ReleaseBlock(int32 Index);
+	void PoolBlock(AMinesweeper3DBlock* Block);
+	FORCEINLINE bool HasBlocks() const { return BlockSlots.Num() > 0 && BlockSlots.Num() == Board.Num(); }
+	FVector GetCellLocation(int32 Index) const;
+
+	//Chunked rendering. Chunks are rebuilt on the thread pool and swapped in on the game thread as each one lands.
+	bool UsesChunks(const FMinesweeper3DBoardShape& InShape) const;
+	//Whether spawning a block per cell fits in MaxBlockSpawnSeconds and the free memory
+	bool CanAffordBlocks(const FMinesweeper3DBoardShape& InShape) const;
+	//Turns NewShape down if it won't fit in memory, and warns if it's going to be drawn as chunks instead of blocks
+	void CheckNewShape(const FMinesweeper3DBoardShape& OldShape);
+	bool CanStartChunkBuild() const;
+	//Governed versions of the LOD settings
+	float GetDetailDepth() const { return Governor ? Governor->ScaleDistance(LODDetailDepth) : LODDetailDepth; }
+	int32 GetMaxDetailedBlocks() const { return Governor ? Governor->ScaleCount(MaxDetailedBlocks) : MaxDetailedBlocks; }
+	void OnQualityChanged();
+	int32 AddChunkMesh();
+	void GenerateChunks();
+	void ReleaseChunks();
+	void MarkChunkDirty(int32 Index);
+	void MarkChunkLayersDirty(int32 FromLayer, int32 ToLayer);
+	void FlushChunkBuilds();
+	void OnChunkBuilt(int32 Chunk, uint32 Epoch, FMinesweeper3DChunkMeshData& Data);
+	//Gives the numbered cells nearest the camera a block actor to show their digit, and takes it back from the rest
+	void UpdateChunkDetailBlocks(const FVector& CameraLocation, float DetailDistanceSq);
+	//Updates chunks and detail blocks to match a delta that's already been applied to Board
+	void UpdateChunks(const FMinesweeper3DBoardDelta& Delta);
+	//The cell whose surface was hit. Not bounds checked, endless boards don't have any.
+	FIntVector GetCellFromHit(const FHitResult& Hit) const;
+	//Routes a click on a chunk to the cell under it, on whichever kind of board is up
+	void ClickCell(const FIntVector& Pos, bool bReveal);
+
+	//Endless mode. Only played on the machine that owns the board, there's no fixed size to replicate it with.
+	void ReleaseEndless();
+	void UpdateEndlessStreaming(bool bForce);
+	void MarkEndlessCellsDirty(const TArray<FIntVector>& Cells);
+	void FlushEndlessChunkBuilds();
+	void OnEndlessChunkBuilt(const FIntVector& Coord, uint32 Serial, FMinesweeper3DChunkMeshData& Data);
+	void RevealEndlessCell(const FIntVector& Pos);
+	void FlagEndlessCell(const FIntVector& Pos);
+	void UpdateEndlessDetailBlocks(const FVector& CameraLocation, float DetailDistanceSq);
+
+	UFUNCTION()
+	void ChunkClicked(UPrimitiveComponent* ClickedComp, FKey ButtonClicked);
+
+	UFUNCTION()
+	void ChunkTouched(ETouchIndex::Type FingerIndex, UPrimitiveComponent* TouchedComponent);
+
+	//Shared by blocks and chunks once they've worked out which cell was clicked
+	void RequestRevealCell(int32 Index);
+	void RequestFlagCell(int32 Index);
+
+	//Starts getting the next board ready in the background. Nothing happens if it's already on its way.
+	void PrepareNextBoard(const FMinesweeper3DBoardShape& InShape, int32 InNumMines);
+	//Swaps the prepared board in if it matches. Returns false if there isn't one, so the caller has to reset Board itself.
+	bool TakeNextBoard(const FMinesweeper3DBoardShape& InShape, int32 InNumMines);
+	//Gets the first game ready while the player is still in the settings menu
+	void PrewarmFirstGame();
+	void WarmBlockPool();
+	//A seed starts that exact board rather than whichever one was prepared
+	void ResetGame(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, bool bPrepareNext = true, int32 InSeed = INDEX_NONE);
+	//Opens a pack unless it's the one already open
+	bool OpenPuzzlePack(const FString& PackPath);
+
+	//Authority side of the Reveal/Flag rules
+	void RevealCell(int32 Index);
+	void FlagCell(int32 Index);
+
+	//Sends a finished game to the owning player's history. Practice games and puzzles don't count.
+	void RecordGame();
+	void AddToHistory(const FMinesweeper3DGameRecord& Record);
+
+	//Practice mode history, run on the authority
+	FMinesweeper3DUndoStep MakeUndoStep() const;
+	void PushUndoStep();
+	void PushUndoStep(FMinesweeper3DUndoStep&& Step);
+	void RestoreUndoStep(TArray<FMinesweeper3DUndoStep>& From, TArray<FMinesweeper3DUndoStep>& To);
+
+	//Slice mode helpers. Only the layers passed in are touched, so stepping costs the cells in and around the slice.
+	AMinesweeper3DBlock::SliceView GetSliceView(int32 Layer) const;
+	int32 GetNumSliceLayers() const { return Shape.GetLayoutDims()[SliceAxis]; }
+	void UpdateSliceLayers(int32 FromLayer, int32 ToLayer);
+	int32 ConsumeSliceSteps(float AxisValue, float& Accumulator, bool& bHeld);
+
+	//Hands a delta to the owning player, either directly or through ClientApplyBoardDelta
+	void SendBoardDelta(const FMinesweeper3DBoardDelta& Delta);
+	//Updates block actors to match a delta that's already been applied to Board
+	void UpdateBlocks(const FMinesweeper3DBoardDelta& Delta);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRevealBlock(int32 Index);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFlagBlock(int32 Index);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerStartGame(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, const FMinesweeper3DDensity& InDensity);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerSetPracticeMode(bool bEnabled);
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerUndo();
+
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerRedo();
+
+	UFUNCTION(Client, Reliable)
+	void ClientApplyBoardDelta(const FMinesweeper3DBoardDelta& Delta);
+
+	UFUNCTION(Client, Reliable)
+	void ClientRecordGame(const FMinesweeper3DGameRecord& Record);
 
 public:
 
@@ -126,8 +578,19 @@ public:
 	void ZoomStop();
 	void ZoomCamera(bool bZoomOut);
 	void ResetCameraPosition();
-	void UpdateCameraPosition();
+	bool UpdateCameraPosition(float DeltaSeconds);
+	void WakeCamera();
 	float DistanceFromCenter();
+	void OnFirstInteractiveFrame();
+	void UpdateBlockLODs();
+	void AddNumberedBlock(AMinesweeper3DBlock* Block);
+	void RemoveNumberedBlock(AMinesweeper3DBlock* Block);
+	void SetFocusedBlock(AMinesweeper3DBlock* Block, bool bFocused);
+
+	//The block a handle refers to, or null if it has gone stale. Only an integer compare, no object lookups.
+	AMinesweeper3DBlock* ResolveBlock(const FMinesweeper3DBlockHandle& Handle) const;
+	//The frame governor, or null unless this grid is locally controlled
+	FMinesweeper3DFrameGovernor* GetGovernor() const { return Governor.Get(); }
 	void ChangeTheta(float AxisValue);
 	void ChangePhi(float AxisValue);
 	void MoveUpDown(float AxisValue);
@@ -135,6 +598,8 @@ public:
 	void MoveInOut(float AxisValue);
 	void EnableMousePanning();
 	void DisableMousePanning();
+	void ToggleSliceMode();
+	void CycleSliceAxis();
 
 	void AdvanceTimer();
 
@@ -153,18 +618,101 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "UMG Game")
 	void StartGame();
 
+	//Starts an endless game. Only the player hosting (or playing standalone) can, a client's board lives on the server.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void StartEndlessGame();
+
+	//Plays one puzzle from a pack file, from whatever position it was saved in. Host or standalone only, like endless mode.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	bool StartPuzzle(const FString& PackPath, int32 PuzzleIndex);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	int32 GetNumPuzzles(const FString& PackPath);
+
+	//Whether a game was left unfinished last time, by a crash or by quitting. Host or standalone only.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	bool CanResumeGame() const;
+
+	//Sets the unfinished game up again and replays its last checkpoint and the moves journaled since
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	bool ResumeGame();
+
+	//Saves the board as it stands as a one puzzle pack. Needs the mines placed, so not before the first click.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	bool ExportPuzzle(const FString& PackPath, EMinesweeper3DPuzzleFormat Format);
+
 	UFUNCTION(BlueprintCallable, Category = "UMG Game")
 	void ChangeSize(FString Size_in);
 
 	UFUNCTION(BlueprintCallable, Category = "UMG Game")
 	void ChangeMines(FString NewMines);
+
+	//Custom games can have a different length along each axis
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void ChangeDimensions(int32 SizeX, int32 SizeY, int32 SizeZ);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void SetWrapAround(bool bWrapX, bool bWrapY, bool bWrapZ);
+
+	//Length of the fourth axis. More than 1 plays a 4D board, shown as that many 3D slices side by side.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void SetSlices(int32 InSlices);
+
+	//Shapes where the mines of custom games go. Returns false, keeping the old density, if InDensity doesn't make sense.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	bool SetDensity(const FMinesweeper3DDensity& InDensity);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void SetPracticeMode(bool bEnabled);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void SetSliceMode(bool bEnabled);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void SetSliceAxis(int32 Axis);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void SetSliceRange(int32 InMin, int32 InMax);
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void Undo();
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	void Redo();
+
+	//History queries for the HUD, answered from this machine's history
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	bool GetBestTime(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, FMinesweeper3DGameRecord& OutRecord) const;
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	float GetTimePercentile(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, float Time) const;
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	int32 GetGamesPlayed(const FMinesweeper3DBoardShape& InShape, int32 InNumMines) const;
+
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	int32 GetGamesWon(const FMinesweeper3DBoardShape& InShape, int32 InNumMines) const;
+
+	//Minimap queries, answered from the board's running tally. Cells are in layout coordinates, a 4D board's slices along X.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	FMinesweeper3DCellCounts CountCellsInBox(const FIntVector& Min, const FIntVector& Max);
+
+	//Counts along one column of the projection down Axis. U and V are the other two axes, in order.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	FMinesweeper3DCellCounts GetMinimapColumn(int32 Axis, int32 U, int32 V) const;
+
+	//The projection down Axis, a texel per column: hidden, flagged and revealed shares in R, G and B, and A set while any
+	//cell in the column is still hidden. Only the columns that changed since the last call are uploaded.
+	UFUNCTION(BlueprintCallable, Category = "UMG Game")
+	class UTexture2D* GetMinimapTexture(int32 Axis);
 	
 
-	bool CheckBlockBounds(int Xpos, int Ypos, int Zpos);
-	int CalcSurroundingMines(int Xpos, int Ypos, int Zpos);
-	void FinishSetup(AMinesweeper3DBlock *block);
+	//Called by blocks when they're clicked. Validated on the server when we're a client.
+	void RequestReveal(AMinesweeper3DBlock* Block);
+	void RequestFlag(AMinesweeper3DBlock* Block);
+
+	void FinishSetup(int32 Index);
 	void CheckForWin();
-	void RevealMines();
 
 	
 };
@@ -0,0 +1,920 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DBoard.h"
+#include "Serialization/BitWriter.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	//Upper bound on cells in a single delta, and on the cell indices its runs cover, so a malformed packet can't make the
+	//client allocate forever or index past what an int32 holds
+	constexpr uint32 MaxDeltaCells = 1 << 24;
+
+	//Counts go over the wire offset by one so mines (-1) fit: 0..27 needs 5 bits. 4D counts go up to 80, and a delta
+	//holding any says so with a bit up front, so 3D deltas don't pay for the wider range.
+	constexpr uint32 NetCountRange = 28;
+	constexpr uint32 WideNetCountRange = FMinesweeper3DBoard::MaxNeighbours + 2;
+
+	void SerializeIndexList(FArchive& Ar, TArray<int32>& Indices)
+	{
+		uint32 Num = Indices.Num();
+		Ar.SerializeIntPacked(Num);
+		if (Ar.IsLoading())
+		{
+			if (Num > MaxDeltaCells)
+			{
+				Ar.SetError();
+				return;
+			}
+			Indices.SetNumUninitialized(Num);
+		}
+
+		for (uint32 i = 0; i < Num && !Ar.IsError(); i++)
+		{
+			uint32 Index = Indices[i];
+			Ar.SerializeIntPacked(Index);
+			Indices[i] = Index;
+		}
+	}
+
+	//Cells per ParallelFor task when labelling openings
+	constexpr int32 LabelChunkSize = 4096;
+
+	//Lock-free union-find over zero cells. Parents only ever point at smaller indices, so halving the path with a CAS is
+	//safe while other threads are linking, and the root of a set is always its smallest cell.
+	int32 FindOpeningRoot(TArrayView<int32> Parent, int32 Cell)
+	{
+		while (true)
+		{
+			const int32 Up = FPlatformAtomics::AtomicRead(&Parent[Cell]);
+			if (Up == Cell)	return Cell;
+
+			const int32 UpUp = FPlatformAtomics::AtomicRead(&Parent[Up]);
+			if (UpUp != Up)	FPlatformAtomics::InterlockedCompareExchange(&Parent[Cell], UpUp, Up);
+			Cell = Up;
+		}
+	}
+
+	void UnionOpenings(TArrayView<int32> Parent, int32 A, int32 B)
+	{
+		while (true)
+		{
+			A = FindOpeningRoot(Parent, A);
+			B = FindOpeningRoot(Parent, B);
+			if (A == B)	return;
+
+			//Hang the larger root under the smaller one. If someone else moved it first, look again.
+			if (A < B)	Swap(A, B);
+			if (FPlatformAtomics::InterlockedCompareExchange(&Parent[A], B, A) == A)	return;
+		}
+	}
+}
+
+/*---------- Delta ----------*/
+
+void FMinesweeper3DBoardDelta::AddRevealed(FMinesweeper3DCellList& Revealed, const FMinesweeper3DBoard& Board)
+{
+	Revealed.Sort();
+
+	for (int32 i = 0; i < Revealed.Num(); i++)
+	{
+		const int32 Index = Revealed[i];
+		if (RunStarts.Num() > 0 && RunStarts.Last() + RunLengths.Last() == Index)
+		{
+			RunLengths.Last()++;
+		}
+		else
+		{
+			RunStarts.Add(Index);
+			RunLengths.Add(1);
+		}
+		Counts.Add(Board.Counts[Index]);
+	}
+}
+
+int32 FMinesweeper3DBoardDelta::GetNetSize() const
+{
+	FBitWriter Writer(0, true);
+	bool bSuccess = true;
+	const_cast<FMinesweeper3DBoardDelta*>(this)->NetSerialize(Writer, nullptr, bSuccess);
+	return Writer.GetNumBytes();
+}
+
+bool FMinesweeper3DBoardDelta::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 NumRuns = RunStarts.Num();
+	Ar.SerializeIntPacked(NumRuns);
+	if (Ar.IsLoading())
+	{
+		if (NumRuns > MaxDeltaCells)
+		{
+			bOutSuccess = false;
+			return true;
+		}
+		RunStarts.SetNumUninitialized(NumRuns);
+		RunLengths.SetNumUninitialized(NumRuns);
+	}
+
+	//Run starts are stored as the gap after the previous run, so a flood reveal costs a byte or two per run
+	uint32 PrevEnd = 0;
+	uint32 TotalCells = 0;
+	for (uint32 i = 0; i < NumRuns && !Ar.IsError(); i++)
+	{
+		uint32 Gap = RunStarts[i] - PrevEnd;
+		uint32 Length = RunLengths[i];
+		Ar.SerializeIntPacked(Gap);
+		Ar.SerializeIntPacked(Length);
+
+		//Checked run by run, so wire gaps and lengths can't wrap a run's end round past the cap. Runs don't overlap, so
+		//that caps the total as well. No board a delta is made for has more cells than the cap.
+		if (Ar.IsLoading() && (Gap > MaxDeltaCells - PrevEnd || Length > MaxDeltaCells - PrevEnd - Gap))
+		{
+			bOutSuccess = false;
+			return true;
+		}
+
+		RunStarts[i] = PrevEnd + Gap;
+		RunLengths[i] = Length;
+		PrevEnd = RunStarts[i] + Length;
+		TotalCells += Length;
+	}
+
+	if (Ar.IsLoading())
+	{
+		Counts.SetNumUninitialized(TotalCells);
+	}
+
+	uint8 bWideCounts = 0;
+	if (Ar.IsSaving())
+	{
+		for (int8 Count : Counts)
+		{
+			bWideCounts |= Count + 1 >= (int32)NetCountRange;
+		}
+	}
+	Ar.SerializeBits(&bWideCounts, 1);
+	const uint32 CountRange = bWideCounts ? WideNetCountRange : NetCountRange;
+
+	for (uint32 i = 0; i < TotalCells && !Ar.IsError(); i++)
+	{
+		uint32 Packed = Counts[i] + 1;
+		Ar.SerializeInt(Packed, CountRange);
+		Counts[i] = (int8)Packed - 1;
+	}
+
+	SerializeIndexList(Ar, Flagged);
+	SerializeIndexList(Ar, Unflagged);
+	SerializeIndexList(Ar, Hidden);
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+/*---------- Shape ----------*/
+
+//Slices - 1 goes in the top five bits of the wrap byte, which 3D boards always left clear, so files and records written
+//before 4D boards existed read back unchanged and stay the same size
+FArchive& operator<<(FArchive& Ar, FMinesweeper3DBoardShape& Shape)
+{
+	uint8 WrapMask = (Shape.bWrapX ? 1 : 0) | (Shape.bWrapY ? 2 : 0) | (Shape.bWrapZ ? 4 : 0) | (uint8)(FMath::Clamp(Shape.Slices, 1, FMinesweeper3DBoardShape::MaxSlices) - 1) << 3;
+	Ar << Shape.Dims.X << Shape.Dims.Y << Shape.Dims.Z << WrapMask;
+	Shape.bWrapX = (WrapMask & 1) != 0;
+	Shape.bWrapY = (WrapMask & 2) != 0;
+	Shape.bWrapZ = (WrapMask & 4) != 0;
+	Shape.Slices = (WrapMask >> 3) + 1;
+	return Ar;
+}
+
+/*---------- Cell tally ----------*/
+
+void FMinesweeper3DCellTally::Reset(const FIntVector& InDims)
+{
+	Dims = InDims;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const FIntPoint Size = GetProjectionSize(Axis);
+		Projections[Axis].Reset();
+		Projections[Axis].SetNum(Size.X * Size.Y);
+	}
+	MarkAllDirty();
+
+	//A point update walks log2 of each axis per tree
+	const int32 NumCells = Dims.X * Dims.Y * Dims.Z;
+	const int32 UpdateCost = (FMath::FloorLog2(FMath::Max(Dims.X, 1)) + 1) * (FMath::FloorLog2(FMath::Max(Dims.Y, 1)) + 1) * (FMath::FloorLog2(FMath::Max(Dims.Z, 1)) + 1);
+	MaxPending = NumCells / UpdateCost;
+
+	//Nobody has asked for a box yet unless the trees exist, so there's nothing to keep up with until they do
+	Pending.Reset();
+	if (FlaggedTree.IsInitialized())
+	{
+		FlaggedTree.Init(Dims);
+		RevealedTree.Init(Dims);
+		bTreesValid = true;
+	}
+}
+
+void FMinesweeper3DCellTally::Rebuild(const FMinesweeper3DCellStates& States)
+{
+	Reset(Dims);
+
+	//Cheaper to build the trees again on the next query than to queue every cell
+	bTreesValid = false;
+	for (int32 Index = 0; Index < States.Num(); Index++)
+	{
+		if (States[Index] != EMinesweeper3DCellState::Hidden)	Change(Index, EMinesweeper3DCellState::Hidden, States[Index]);
+	}
+}
+
+void FMinesweeper3DCellTally::MarkAllDirty()
+{
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		DirtyColumns[Axis] = FIntRect(FIntPoint::ZeroValue, GetProjectionSize(Axis) - FIntPoint(1, 1));
+	}
+}
+
+void FMinesweeper3DCellTally::BuildTrees(const FMinesweeper3DCellStates& States)
+{
+	if (!FlaggedTree.IsInitialized())
+	{
+		FlaggedTree.Init(Dims);
+		RevealedTree.Init(Dims);
+	}
+	FlaggedTree.Build([&States](int32 Index) { return States[Index] == EMinesweeper3DCellState::Flagged ? 1 : 0; });
+	RevealedTree.Build([&States](int32 Index) { return States[Index] == EMinesweeper3DCellState::Revealed ? 1 : 0; });
+	bTreesValid = true;
+	Pending.Reset();
+}
+
+FMinesweeper3DCellCounts FMinesweeper3DCellTally::CountBox(const FIntVector& Min, const FIntVector& Max, const FMinesweeper3DCellStates& States)
+{
+	FMinesweeper3DCellCounts Counts;
+	const FIntVector Lo(FMath::Max(Min.X, 0), FMath::Max(Min.Y, 0), FMath::Max(Min.Z, 0));
+	const FIntVector Hi(FMath::Min(Max.X, Dims.X - 1), FMath::Min(Max.Y, Dims.Y - 1), FMath::Min(Max.Z, Dims.Z - 1));
+	if (Lo.X > Hi.X || Lo.Y > Hi.Y || Lo.Z > Hi.Z)	return Counts;
+
+	if (!bTreesValid)
+	{
+		BuildTrees(States);
+	}
+	else
+	{
+		for (const FPendingChange& Change : Pending)
+		{
+			const int32 Zpos = Change.Index % Dims.Z;
+			const int32 Ypos = (Change.Index / Dims.Z) % Dims.Y;
+			const int32 Xpos = Change.Index / (Dims.Y * Dims.Z);
+			if (Change.FlaggedDelta)	FlaggedTree.Add(Xpos, Ypos, Zpos, Change.FlaggedDelta);
+			if (Change.RevealedDelta)	RevealedTree.Add(Xpos, Ypos, Zpos, Change.RevealedDelta);
+		}
+		Pending.Reset();
+	}
+
+	Counts.Flagged = FlaggedTree.SumBox(Lo, Hi);
+	Counts.Revealed = RevealedTree.SumBox(Lo, Hi);
+	Counts.Hidden = (Hi.X - Lo.X + 1) * (Hi.Y - Lo.Y + 1) * (Hi.Z - Lo.Z + 1) - Counts.Flagged - Counts.Revealed;
+	return Counts;
+}
+
+FMinesweeper3DCellCounts FMinesweeper3DCellTally::GetColumn(int32 Axis, int32 U, int32 V) const
+{
+	FMinesweeper3DCellCounts Counts;
+	const FIntPoint Size = GetProjectionSize(Axis);
+	if (U < 0 || U >= Size.X || V < 0 || V >= Size.Y)	return Counts;
+
+	const FColumn& Column = Projections[Axis][U * Size.Y + V];
+	Counts.Flagged = Column.Flagged;
+	Counts.Revealed = Column.Revealed;
+	Counts.Hidden = Dims[Axis] - Column.Flagged - Column.Revealed;
+	return Counts;
+}
+
+bool FMinesweeper3DCellTally::TakeDirtyColumns(int32 Axis, FIntRect& OutRect)
+{
+	FIntRect& Dirty = DirtyColumns[Axis];
+	if (Dirty.Min.X > Dirty.Max.X || Dirty.Min.Y > Dirty.Max.Y)	return false;
+
+	OutRect = Dirty;
+	Dirty = FIntRect(FIntPoint(MAX_int32, MAX_int32), FIntPoint(MIN_int32, MIN_int32));
+	return true;
+}
+
+/*---------- Board ----------*/
+
+void FMinesweeper3DBoard::Reset(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, int32 InSeed)
+{
+	Shape = InShape;
+	Seed = InSeed != INDEX_NONE ? InSeed : FMath::Rand();
+	const int32 NumCells = Shape.Num();
+
+	NumMines = InNumMines;
+	NumFlags = 0;
+	BlocksRemaining = NumCells;
+	bGenerated = false;
+	bShuffled = false;
+	ThreeBV = 0;
+	CellOpening = TArrayView<int32>();
+	OpeningStarts = TArrayView<int32>();
+	OpeningCells = TArrayView<int32>();
+	GameArena.Reset();
+	MineSampler.Empty();
+
+	Mines.Init(false, NumCells);
+	Counts.Init(MineCount, NumCells);
+	States.Init(EMinesweeper3DCellState::Hidden, NumCells);
+	Tally.Reset(Shape.GetLayoutDims());
+	GenerationSafelock.Init(false, NumCells);
+
+	BlockList.Reset(NumCells);
+	for (int32 i = 0; i < NumCells; i++)
+	{
+		BlockList.Add(i);
+	}
+
+	BuildNeighbourTables();
+}
+
+void FMinesweeper3DBoard::BuildNeighbourTables()
+{
+	const FIntVector& Dims = Shape.Dims;
+	if (Shape.Is4D())
+	{
+		Lattice4D.Init({ Shape.Slices, Dims.X, Dims.Y, Dims.Z }, { false, Shape.bWrapX, Shape.bWrapY, Shape.bWrapZ });
+	}
+	else
+	{
+		Lattice3D.Init({ Dims.X, Dims.Y, Dims.Z }, { Shape.bWrapX, Shape.bWrapY, Shape.bWrapZ });
+	}
+}
+
+//Called when the first cell is clicked
+void FMinesweeper3DBoard::Generate(int32 FirstIndex)
+{
+	if (!bShuffled)	Shuffle();
+	SafelockBlocks(FirstIndex);
+	GenerateMines();
+	AssignSurroundingMineTotals();
+	LabelOpenings();
+	bGenerated = true;
+}
+
+void FMinesweeper3DBoard::FinishLoading()
+{
+	const int32 NumCells = Num();
+	NumMines = 0;
+	NumFlags = 0;
+	BlocksRemaining = NumCells;
+
+	//Mines go first in BlockList, the same as GenerateMines leaves it, so RevealMines() still finds them
+	BlockList.Reset();
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (Mines[Index])	BlockList.Add(Index);
+
+		NumFlags += States[Index] == EMinesweeper3DCellState::Flagged;
+		BlocksRemaining -= States[Index] == EMinesweeper3DCellState::Revealed;
+	}
+	NumMines = BlockList.Num();
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (!Mines[Index])	BlockList.Add(Index);
+	}
+
+	Tally.Rebuild(States);
+	AssignSurroundingMineTotals();
+	LabelOpenings();
+	bShuffled = true;
+	bGenerated = true;
+}
+
+//Sets a flag for all cells surrounding the first click to make sure they don't become mines
+//this gives the player more information when they start the game
+void FMinesweeper3DBoard::SafelockBlocks(int32 Index)
+{
+	GenerationSafelock[Index] = true;
+	ForEachNeighbour(Index, [this](int32 Neighbour)
+	{
+		GenerationSafelock[Neighbour] = true;
+	});
+}
+
+void FMinesweeper3DBoard::Shuffle()
+{
+	//A shaped board draws its mines when they're placed, from a sampler built here ahead of time
+	MineSampler.Empty();
+	if (!Density.IsUniform() && BuildMineSampler(false, GameArena.AllocArray<float>(Num())))
+	{
+		bShuffled = true;
+		return;
+	}
+
+	//Randomize mines. Only the front of BlockList is ever used: the mines, plus room for the cells the first click's
+	//safelock takes out of it, so a partial Fisher-Yates over that much is as good as shuffling the lot.
+	FRandomStream Stream(Seed);
+	const int32 NumShuffled = FMath::Min(NumMines + MaxNeighbours + 1, BlockList.Num() - 1);
+	for (int32 i = 0; i < NumShuffled; i++)
+	{
+		BlockList.Swap(i, Stream.RandRange(i, BlockList.Num() - 1));
+	}
+	bShuffled = true;
+}
+
+//Determine which cells are mines
+void FMinesweeper3DBoard::GenerateMines()
+{
+	if (!MineSampler.IsEmpty())
+	{
+		GenerateShapedMines();
+		return;
+	}
+
+	for (int i = 0; i < NumMines && i < BlockList.Num(); i++)
+	{
+		//Ignore the cells surrounding the first click so more cells are revealed when the game starts
+		if (GenerationSafelock[BlockList[i]])
+		{
+			//Keep the first NumMines entries in BlockList as all mines so they're easy to find in RevealMines()
+			BlockList.RemoveAt(i);
+			i--;
+		}
+		else
+		{
+			Mines[BlockList[i]] = true;
+		}
+	}
+}
+
+bool FMinesweeper3DBoard::BuildMineSampler(bool bOnlyFreeCells, TArrayView<float> Weights)
+{
+	const FIntVector LayoutDims = Shape.GetLayoutDims();
+	check(Weights.Num() == Num());
+
+	int32 Index = 0;
+	for (int32 X = 0; X < LayoutDims.X; X++)
+	{
+		for (int32 Y = 0; Y < LayoutDims.Y; Y++)
+		{
+			for (int32 Z = 0; Z < LayoutDims.Z; Z++, Index++)
+			{
+				const bool bTaken = bOnlyFreeCells && (Mines[Index] || GenerationSafelock[Index]);
+				Weights[Index] = bTaken ? 0.f : Density.GetWeight(Shape, X, Y, Z);
+			}
+		}
+	}
+	return MineSampler.Build(Weights);
+}
+
+void FMinesweeper3DBoard::GenerateShapedMines()
+{
+	//The sampler starts over from the free cells once most draws are landing on taken ones, so heavy regions filling up
+	//never leave it spinning. This many rejections in a row are allowed before that's considered.
+	constexpr int32 MinRejectionsBeforeRebuild = 1024;
+
+	//Generation scratch, LabelOpenings() takes the arena over afterwards. Nothing in the arena is freed before then, so
+	//every rebuild refills the same weights rather than taking more.
+	TArrayView<float> Weights;
+
+	FRandomStream Stream(Seed);
+	int32 Placed = 0;
+	int32 Accepted = 0;
+	int32 Rejected = 0;
+	while (Placed < NumMines)
+	{
+		const int32 Cell = MineSampler.Sample(Stream);
+		if (Mines[Cell] || GenerationSafelock[Cell])
+		{
+			if (++Rejected > Accepted + MinRejectionsBeforeRebuild)
+			{
+				//Nothing left with any weight, the same as the uniform path running out of BlockList
+				if (Weights.Num() == 0)	Weights = GameArena.AllocArray<float>(Num());
+				if (!BuildMineSampler(true, Weights))	break;
+				Accepted = 0;
+				Rejected = 0;
+			}
+			continue;
+		}
+
+		Mines[Cell] = true;
+		Placed++;
+		Accepted++;
+	}
+	MineSampler.Empty();
+
+	//Mines first in BlockList, as RevealMines() expects
+	const int32 NumCells = Num();
+	NumMines = Placed;
+	BlockList.Reset();
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (Mines[Index])	BlockList.Add(Index);
+	}
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (!Mines[Index])	BlockList.Add(Index);
+	}
+}
+
+//Find number of surrounding mines for each cell
+void FMinesweeper3DBoard::AssignSurroundingMineTotals()
+{
+	if (Shape.Is4D())
+	{
+		if (Shape.IsWrapped())	AssignSurroundingMineTotalsIn<4, true>();
+		else AssignSurroundingMineTotalsIn<4, false>();
+	}
+	else
+	{
+		if (Shape.IsWrapped())	AssignSurroundingMineTotalsIn<3, true>();
+		else AssignSurroundingMineTotalsIn<3, false>();
+	}
+}
+
+template<int32 D, bool bWrapped>
+void FMinesweeper3DBoard::AssignSurroundingMineTotalsIn()
+{
+	for (int32 Index = 0; Index < Num(); Index++)
+	{
+		if (Mines[Index])
+		{
+			Counts[Index] = MineCount;
+			continue;
+		}
+
+		int8 AdjacentMines = 0;
+		ForEachNeighbourIn<D, bWrapped>(Index, [this, &AdjacentMines](int32 Neighbour)
+		{
+			AdjacentMines += Mines[Neighbour];
+		});
+		Counts[Index] = AdjacentMines;
+	}
+}
+
+//Check the cells surrounding a cell to determine how many mines surround it
+int32 FMinesweeper3DBoard::CalcSurroundingMines(int32 Index) const
+{
+	int32 AdjacentMines = 0;
+	ForEachNeighbour(Index, [this, &AdjacentMines](int32 Neighbour)
+	{
+		AdjacentMines += Mines[Neighbour];
+	});
+	return AdjacentMines;
+}
+
+bool FMinesweeper3DBoard::Reveal(int32 Index, FMinesweeper3DCellList& OutRevealed)
+{
+	if (!IsValidIndex(Index) || States[Index] != EMinesweeper3DCellState::Hidden)	return false;
+
+	if (Mines[Index])
+	{
+		SetState(Index, EMinesweeper3DCellState::Revealed);
+		OutRevealed.Add(Index);
+		return true;
+	}
+
+	//A zero cell's flood is already known, it's the opening it was labelled with
+	if (CellOpening.IsValidIndex(Index) && CellOpening[Index] != INDEX_NONE && RevealOpening(CellOpening[Index], OutRevealed))
+	{
+		return false;
+	}
+
+	//Flood out from zero cells with a worklist rather than recursing through every neighbour
+	FMinesweeper3DCellList Pending;
+	Pending.Add(Index);
+	SetState(Index, EMinesweeper3DCellState::Revealed);
+
+	if (Shape.Is4D())
+	{
+		if (Shape.IsWrapped())	FloodRevealIn<4, true>(Pending, OutRevealed);
+		else FloodRevealIn<4, false>(Pending, OutRevealed);
+	}
+	else
+	{
+		if (Shape.IsWrapped())	FloodRevealIn<3, true>(Pending, OutRevealed);
+		else FloodRevealIn<3, false>(Pending, OutRevealed);
+	}
+	return false;
+}
+
+template<int32 D, bool bWrapped>
+void FMinesweeper3DBoard::FloodRevealIn(FMinesweeper3DCellList& Pending, FMinesweeper3DCellList& OutRevealed)
+{
+	while (Pending.Num() > 0)
+	{
+		const int32 Current = Pending.Pop(false);
+		OutRevealed.Add(Current);
+		BlocksRemaining--;
+
+		if (Counts[Current] != 0)	continue;
+
+		ForEachNeighbourIn<D, bWrapped>(Current, [this, &Pending](int32 Neighbour)
+		{
+			if (States[Neighbour] == EMinesweeper3DCellState::Hidden)
+			{
+				SetState(Neighbour, EMinesweeper3DCellState::Revealed);
+				Pending.Add(Neighbour);
+			}
+		});
+	}
+}
+
+void FMinesweeper3DBoard::RevealMines(FMinesweeper3DCellList& OutRevealed)
+{
+	for (int i = 0; i < NumMines && i < BlockList.Num(); i++)
+	{
+		const int32 Index = BlockList[i];
+		//Correctly flagged mines keep their flag
+		if (States[Index] == EMinesweeper3DCellState::Hidden)
+		{
+			SetState(Index, EMinesweeper3DCellState::Revealed);
+			OutRevealed.Add(Index);
+		}
+	}
+}
+
+bool FMinesweeper3DBoard::RevealOpening(int32 Opening, FMinesweeper3DCellList& OutRevealed)
+{
+	const int32 Start = OpeningStarts[Opening];
+	const int32 End = OpeningStarts[Opening + 1];
+
+	//A flagged cell stops a flood, which could leave part of the opening hidden
+	for (int32 i = Start; i < End; i++)
+	{
+		if (States[OpeningCells[i]] == EMinesweeper3DCellState::Flagged)	return false;
+	}
+
+	for (int32 i = Start; i < End; i++)
+	{
+		const int32 Cell = OpeningCells[i];
+		if (States[Cell] != EMinesweeper3DCellState::Hidden)	continue;
+
+		SetState(Cell, EMinesweeper3DCellState::Revealed);
+		OutRevealed.Add(Cell);
+		BlocksRemaining--;
+	}
+	return true;
+}
+
+int32 FMinesweeper3DBoard::CalcSolved3BV() const
+{
+	if (!bGenerated)	return 0;
+
+	int32 Solved = 0;
+	for (int32 Opening = 0; Opening < NumOpenings(); Opening++)
+	{
+		bool bCleared = true;
+		for (int32 i = OpeningStarts[Opening]; i < OpeningStarts[Opening + 1] && bCleared; i++)
+		{
+			bCleared = States[OpeningCells[i]] == EMinesweeper3DCellState::Revealed;
+		}
+		Solved += bCleared;
+	}
+
+	//Numbered cells no opening reaches count once they're revealed
+	for (int32 Index = 0; Index < Num(); Index++)
+	{
+		if (Counts[Index] <= 0 || States[Index] != EMinesweeper3DCellState::Revealed)	continue;
+
+		bool bIsolated = true;
+		ForEachNeighbour(Index, [this, &bIsolated](int32 Neighbour)
+		{
+			bIsolated &= Counts[Neighbour] != 0;
+		});
+		Solved += bIsolated;
+	}
+	return Solved;
+}
+
+//Labels the openings and works out ThreeBV. Called once mines are counted.
+void FMinesweeper3DBoard::LabelOpenings()
+{
+	if (Shape.Is4D())
+	{
+		if (Shape.IsWrapped())	LabelOpeningsIn<4, true>();
+		else LabelOpeningsIn<4, false>();
+	}
+	else
+	{
+		if (Shape.IsWrapped())	LabelOpeningsIn<3, true>();
+		else LabelOpeningsIn<3, false>();
+	}
+}
+
+template<int32 D, bool bWrapped>
+void FMinesweeper3DBoard::LabelOpeningsIn()
+{
+	const int32 NumCells = Num();
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumCells, LabelChunkSize);
+
+	//Everything here lives in the game arena, which only ever holds one labelling
+	GameArena.Reset();
+	const TArrayView<int32> Parent = GameArena.AllocArray<int32>(NumCells);
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		Parent[Index] = Index;
+	}
+
+	//Every zero cell joins the zero neighbours before it, which covers each pair once
+	ParallelFor(NumChunks, [this, Parent, NumCells](int32 Chunk)
+	{
+		const int32 ChunkEnd = FMath::Min((Chunk + 1) * LabelChunkSize, NumCells);
+		for (int32 Index = Chunk * LabelChunkSize; Index < ChunkEnd; Index++)
+		{
+			if (Counts[Index] != 0)	continue;
+
+			ForEachNeighbourIn<D, bWrapped>(Index, [this, Parent, Index](int32 Neighbour)
+			{
+				if (Neighbour < Index && Counts[Neighbour] == 0)	UnionOpenings(Parent, Index, Neighbour);
+			});
+		}
+	});
+
+	//Roots are the smallest cell of their opening, so walking in index order numbers each opening before any of its other cells need it
+	int32 NumOpen = 0;
+	CellOpening = GameArena.AllocArray<int32>(NumCells);
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (Counts[Index] != 0)
+		{
+			CellOpening[Index] = INDEX_NONE;
+			continue;
+		}
+
+		const int32 Root = FindOpeningRoot(Parent, Index);
+		CellOpening[Index] = Root == Index ? NumOpen++ : CellOpening[Root];
+	}
+
+	//Numbered cells can border several openings, so gather the distinct ones around each cell
+	auto GatherBorderingOpenings = [this](int32 Index, TArray<int32, TInlineAllocator<MaxNeighbours>>& OutOpenings)
+	{
+		OutOpenings.Reset();
+		ForEachNeighbourIn<D, bWrapped>(Index, [this, &OutOpenings](int32 Neighbour)
+		{
+			if (CellOpening[Neighbour] != INDEX_NONE)	OutOpenings.AddUnique(CellOpening[Neighbour]);
+		});
+	};
+
+	//Count each opening's cells, then lay them out back to back
+	int32 NumIsolated = 0;
+	TArray<int32, TInlineAllocator<MaxNeighbours>> Bordering;
+	OpeningStarts = GameArena.AllocArray<int32>(NumOpen + 1);
+	FMemory::Memzero(OpeningStarts.GetData(), OpeningStarts.Num() * sizeof(int32));
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (Counts[Index] == 0)
+		{
+			OpeningStarts[CellOpening[Index] + 1]++;
+		}
+		else if (Counts[Index] != MineCount)
+		{
+			GatherBorderingOpenings(Index, Bordering);
+			for (int32 Opening : Bordering)
+			{
+				OpeningStarts[Opening + 1]++;
+			}
+			NumIsolated += Bordering.Num() == 0;
+		}
+	}
+
+	for (int32 Opening = 0; Opening < NumOpen; Opening++)
+	{
+		OpeningStarts[Opening + 1] += OpeningStarts[Opening];
+	}
+
+	const TArrayView<int32> Fill = GameArena.AllocArray<int32>(NumOpen);
+	FMemory::Memcpy(Fill.GetData(), OpeningStarts.GetData(), NumOpen * sizeof(int32));
+	OpeningCells = GameArena.AllocArray<int32>(OpeningStarts[NumOpen]);
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		if (Counts[Index] == 0)
+		{
+			OpeningCells[Fill[CellOpening[Index]]++] = Index;
+		}
+		else if (Counts[Index] != MineCount)
+		{
+			GatherBorderingOpenings(Index, Bordering);
+			for (int32 Opening : Bordering)
+			{
+				OpeningCells[Fill[Opening]++] = Index;
+			}
+		}
+	}
+
+	ThreeBV = NumOpen + NumIsolated;
+}
+
+bool FMinesweeper3DBoard::ToggleFlag(int32 Index, bool& bOutFlagged)
+{
+	if (!IsValidIndex(Index))	return false;
+
+	if (States[Index] == EMinesweeper3DCellState::Flagged)
+	{
+		SetState(Index, EMinesweeper3DCellState::Hidden);
+		NumFlags--;
+		bOutFlagged = false;
+		return true;
+	}
+	else if (States[Index] == EMinesweeper3DCellState::Hidden && NumFlags < NumMines)
+	{
+		SetState(Index, EMinesweeper3DCellState::Flagged);
+		NumFlags++;
+		bOutFlagged = true;
+		return true;
+	}
+	return false;
+}
+
+void FMinesweeper3DBoard::ApplyDelta(const FMinesweeper3DBoardDelta& Delta)
+{
+	int32 CountIndex = 0;
+	for (int32 Run = 0; Run < Delta.RunStarts.Num(); Run++)
+	{
+		for (int32 i = 0; i < Delta.RunLengths[Run]; i++)
+		{
+			const int32 Index = Delta.RunStarts[Run] + i;
+			const int8 Count = Delta.Counts[CountIndex++];
+			if (!IsValidIndex(Index))	continue;
+
+			if (States[Index] == EMinesweeper3DCellState::Flagged)	NumFlags--;
+			if (Count != MineCount)	BlocksRemaining--;
+			SetState(Index, EMinesweeper3DCellState::Revealed);
+			Counts[Index] = Count;
+		}
+	}
+
+	for (int32 Index : Delta.Flagged)
+	{
+		if (IsValidIndex(Index) && States[Index] == EMinesweeper3DCellState::Hidden)
+		{
+			SetState(Index, EMinesweeper3DCellState::Flagged);
+			NumFlags++;
+		}
+	}
+
+	for (int32 Index : Delta.Unflagged)
+	{
+		if (IsValidIndex(Index) && States[Index] == EMinesweeper3DCellState::Flagged)
+		{
+			SetState(Index, EMinesweeper3DCellState::Hidden);
+			NumFlags--;
+		}
+	}
+
+	for (int32 Index : Delta.Hidden)
+	{
+		if (!IsValidIndex(Index))	continue;
+
+		if (States[Index] == EMinesweeper3DCellState::Flagged)	NumFlags--;
+		if (States[Index] == EMinesweeper3DCellState::Revealed && Counts[Index] != MineCount)	BlocksRemaining++;
+		SetState(Index, EMinesweeper3DCellState::Hidden);
+	}
+}
+
+FMinesweeper3DBoardSnapshot FMinesweeper3DBoard::TakeSnapshot() const
+{
+	FMinesweeper3DBoardSnapshot Snapshot;
+	Snapshot.States = States;
+	Snapshot.NumFlags = NumFlags;
+	Snapshot.BlocksRemaining = BlocksRemaining;
+	return Snapshot;
+}
+
+void FMinesweeper3DBoard::RestoreSnapshot(const FMinesweeper3DBoardSnapshot& Snapshot, FMinesweeper3DBoardDelta& OutDelta)
+{
+	FMinesweeper3DCellList Revealed;
+	for (int32 Page = 0; Page < States.NumPages(); Page++)
+	{
+		if (States.SharesPage(Snapshot.States, Page))	continue;
+
+		const int32 PageStart = Page * FMinesweeper3DCellStates::PageSize;
+		const int32 PageEnd = FMath::Min(PageStart + FMinesweeper3DCellStates::PageSize, Num());
+		for (int32 Index = PageStart; Index < PageEnd; Index++)
+		{
+			const EMinesweeper3DCellState OldState = States[Index];
+			const EMinesweeper3DCellState NewState = Snapshot.States[Index];
+			if (OldState == NewState)	continue;
+			Tally.Change(Index, OldState, NewState);
+
+			if (NewState == EMinesweeper3DCellState::Revealed)
+			{
+				Revealed.Add(Index);
+			}
+			else if (NewState == EMinesweeper3DCellState::Flagged)
+			{
+				OutDelta.Flagged.Add(Index);
+			}
+			else if (OldState == EMinesweeper3DCellState::Flagged)
+			{
+				OutDelta.Unflagged.Add(Index);
+			}
+			else
+			{
+				OutDelta.Hidden.Add(Index);
+			}
+		}
+	}
+
+	States = Snapshot.States;
+	NumFlags = Snapshot.NumFlags;
+	BlocksRemaining = Snapshot.BlocksRemaining;
+	OutDelta.AddRevealed(Revealed, *this);
+}
@@ -0,0 +1,434 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Minesweeper3DPagedArray.h"
+#include "Minesweeper3DLattice.h"
+#include "Minesweeper3DArena.h"
+#include "Minesweeper3DFenwick.h"
+#include "Minesweeper3DDensity.h"
+#include "Minesweeper3DBoard.generated.h"
+
+struct FMinesweeper3DBoard;
+
+/**
+ * Board dimensions, and which axes wrap around so the far face touches the near one.
+ * A board with more than one slice is four dimensional. Its slices are laid side by side along X, so cell coordinates
+ * run across the whole strip: slice W holds X = W * Dims.X .. (W + 1) * Dims.X - 1, and the fourth axis never wraps.
+ */
+USTRUCT(BlueprintType)
+struct FMinesweeper3DBoardShape
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite)
+	FIntVector Dims = FIntVector::ZeroValue;
+
+	UPROPERTY(BlueprintReadWrite)
+	bool bWrapX = false;
+
+	UPROPERTY(BlueprintReadWrite)
+	bool bWrapY = false;
+
+	UPROPERTY(BlueprintReadWrite)
+	bool bWrapZ = false;
+
+	//Length of the fourth axis, 1 for an ordinary 3D board
+	UPROPERTY(BlueprintReadWrite)
+	int32 Slices = 1;
+
+	//Slices are stored alongside the wrap flags in a byte, so this many fit
+	static constexpr int32 MaxSlices = 32;
+
+	FMinesweeper3DBoardShape() {}
+	explicit FMinesweeper3DBoardShape(int32 InSize) : Dims(InSize) {}
+
+	FORCEINLINE int32 Num() const { return Dims.X * Dims.Y * Dims.Z * Slices; }
+	FORCEINLINE bool Is4D() const { return Slices > 1; }
+
+	//Extent of the cell coordinates, every slice included
+	FORCEINLINE FIntVector GetLayoutDims() const { return FIntVector(Dims.X * Slices, Dims.Y, Dims.Z); }
+	FORCEINLINE int32 GetMaxSize() const { return GetLayoutDims().GetMax(); }
+	FORCEINLINE bool Wraps(int32 Axis) const { return Axis == 0 ? bWrapX : (Axis == 1 ? bWrapY : bWrapZ); }
+	FORCEINLINE bool IsWrapped() const { return bWrapX || bWrapY || bWrapZ; }
+
+	bool operator==(const FMinesweeper3DBoardShape& Other) const
+	{
+		return Dims == Other.Dims && bWrapX == Other.bWrapX && bWrapY == Other.bWrapY && bWrapZ == Other.bWrapZ && Slices == Other.Slices;
+	}
+
+	friend uint32 GetTypeHash(const FMinesweeper3DBoardShape& Shape)
+	{
+		return HashCombine(GetTypeHash(Shape.Dims), (Shape.bWrapX ? 1 : 0) | (Shape.bWrapY ? 2 : 0) | (Shape.bWrapZ ? 4 : 0) | (Shape.Slices - 1) << 3);
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FMinesweeper3DBoardShape& Shape);
+};
+
+//Cells touched by one reveal. Frame scratch, so only ever a local.
+typedef TArray<int32, FMinesweeper3DFrameAllocator> FMinesweeper3DCellList;
+
+/** State of a single cell, shared by the authoritative board and the client's copy of it */
+enum class EMinesweeper3DCellState : uint8
+{
+	Hidden,
+	Revealed,
+	Flagged
+};
+
+/**
+ * Board changes sent from the server to the owning client.
+ * Revealed cells are sent as sorted runs of flat indices plus one count per cell, never as actors.
+ */
+USTRUCT()
+struct FMinesweeper3DBoardDelta
+{
+	GENERATED_BODY()
+
+	//Revealed cells are RunStarts[i] .. RunStarts[i] + RunLengths[i] - 1
+	TArray<int32> RunStarts;
+	TArray<int32> RunLengths;
+
+	//Surrounding mine count for each revealed cell, in run order. Revealed mines are -1. Up to 26 on a 3D board, 80 on a 4D one.
+	TArray<int8> Counts;
+
+	//Cells that gained or lost a flag
+	TArray<int32> Flagged;
+	TArray<int32> Unflagged;
+
+	//Revealed or flagged cells that went back to hidden, from undo
+	TArray<int32> Hidden;
+
+	//Sorts Revealed and packs it into runs, reading each cell's count from Board
+	void AddRevealed(FMinesweeper3DCellList& Revealed, const FMinesweeper3DBoard& Board);
+
+	bool IsEmpty() const { return RunStarts.Num() == 0 && Flagged.Num() == 0 && Unflagged.Num() == 0 && Hidden.Num() == 0; }
+
+	//Number of bytes this delta costs on the wire
+	int32 GetNetSize() const;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FMinesweeper3DBoardDelta> : public TStructOpsTypeTraitsBase2<FMinesweeper3DBoardDelta>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+typedef TMinesweeper3DPagedArray<EMinesweeper3DCellState> FMinesweeper3DCellStates;
+
+/** Everything Reveal/Flag can change. Cheap to take, since the state pages are shared until the board writes to them. */
+struct FMinesweeper3DBoardSnapshot
+{
+	FMinesweeper3DCellStates States;
+	int32 NumFlags = 0;
+	int32 BlocksRemaining = 0;
+};
+
+/** How many cells of each state are in part of the board */
+USTRUCT(BlueprintType)
+struct FMinesweeper3DCellCounts
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 Hidden = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 Flagged = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 Revealed = 0;
+};
+
+/**
+ * Cell counts kept up to date as the board changes, so the minimap and box queries never scan the board.
+ * Each axis has a projection holding, for every column of cells along that axis, how many are flagged and revealed.
+ * Those move in O(1) per changed cell. Box counts come from two 3D Fenwick trees that are only built the first time a
+ * box is asked for, then catch up with queued point updates, or rebuild if a flood queued more than that would cost.
+ * Coordinates are the layout ones, so a 4D board's slices run along X.
+ */
+class FMinesweeper3DCellTally
+{
+public:
+	struct FColumn
+	{
+		int32 Flagged = 0;
+		int32 Revealed = 0;
+	};
+
+	//Every cell hidden
+	void Reset(const FIntVector& InDims);
+
+	//Starts again from States, for cells that were written without going through Change()
+	void Rebuild(const FMinesweeper3DCellStates& States);
+
+	FORCEINLINE void Change(int32 Index, EMinesweeper3DCellState OldState, EMinesweeper3DCellState NewState)
+	{
+		const int32 FlaggedDelta = (NewState == EMinesweeper3DCellState::Flagged) - (OldState == EMinesweeper3DCellState::Flagged);
+		const int32 RevealedDelta = (NewState == EMinesweeper3DCellState::Revealed) - (OldState == EMinesweeper3DCellState::Revealed);
+
+		const int32 Zpos = Index % Dims.Z;
+		const int32 Ypos = (Index / Dims.Z) % Dims.Y;
+		const int32 Xpos = Index / (Dims.Y * Dims.Z);
+		ChangeColumn(0, Ypos, Zpos, FlaggedDelta, RevealedDelta);
+		ChangeColumn(1, Xpos, Zpos, FlaggedDelta, RevealedDelta);
+		ChangeColumn(2, Xpos, Ypos, FlaggedDelta, RevealedDelta);
+
+		if (!bTreesValid)	return;
+		if (Pending.Num() < MaxPending)
+		{
+			Pending.Add({ Index, (int8)FlaggedDelta, (int8)RevealedDelta });
+		}
+		else
+		{
+			bTreesValid = false;
+			Pending.Reset();
+		}
+	}
+
+	//Cells in Min .. Max inclusive, clamped to the board. States is only read if the trees have to be built.
+	FMinesweeper3DCellCounts CountBox(const FIntVector& Min, const FIntVector& Max, const FMinesweeper3DCellStates& States);
+
+	//The projection along Axis has a column for every cell of the other two axes, in order, U slowest
+	FORCEINLINE FIntPoint GetProjectionSize(int32 Axis) const
+	{
+		return Axis == 0 ? FIntPoint(Dims.Y, Dims.Z) : (Axis == 1 ? FIntPoint(Dims.X, Dims.Z) : FIntPoint(Dims.X, Dims.Y));
+	}
+
+	FMinesweeper3DCellCounts GetColumn(int32 Axis, int32 U, int32 V) const;
+
+	//Columns of the projection along Axis that changed since it was last asked, as an inclusive rect. False if none did.
+	bool TakeDirtyColumns(int32 Axis, FIntRect& OutRect);
+
+	const FIntVector& GetDims() const { return Dims; }
+
+private:
+	struct FPendingChange
+	{
+		int32 Index;
+		int8 FlaggedDelta;
+		int8 RevealedDelta;
+	};
+
+	FORCEINLINE void ChangeColumn(int32 Axis, int32 U, int32 V, int32 FlaggedDelta, int32 RevealedDelta)
+	{
+		FColumn& Column = Projections[Axis][U * GetProjectionSize(Axis).Y + V];
+		Column.Flagged += FlaggedDelta;
+		Column.Revealed += RevealedDelta;
+
+		FIntRect& Dirty = DirtyColumns[Axis];
+		Dirty.Min = Dirty.Min.ComponentMin(FIntPoint(U, V));
+		Dirty.Max = Dirty.Max.ComponentMax(FIntPoint(U, V));
+	}
+
+	void BuildTrees(const FMinesweeper3DCellStates& States);
+	void MarkAllDirty();
+
+	FIntVector Dims = FIntVector::ZeroValue;
+	TArray<FColumn> Projections[3];
+	//Empty while Min > Max
+	FIntRect DirtyColumns[3];
+
+	FMinesweeper3DFenwick3D FlaggedTree;
+	FMinesweeper3DFenwick3D RevealedTree;
+	//Whether the trees plus Pending are up to date. Once built the trees are kept, and zeroed, across resets.
+	bool bTreesValid = false;
+	TArray<FPendingChange> Pending;
+	//Past this many queued changes a linear rebuild is cheaper than the point updates
+	int32 MaxPending = 0;
+};
+
+/**
+ * Flat board data and the Reveal/Flag rules.
+ * The server (or a standalone game) owns the real mines. A client's board only ever learns counts through deltas.
+ */
+struct FMinesweeper3DBoard
+{
+	/** Count stored for mines, and for cells the client hasn't been told about yet */
+	static constexpr int8 MineCount = -1;
+
+	FMinesweeper3DBoardShape Shape;
+	int32 NumMines = 0;
+	int32 NumFlags = 0;
+
+	//Mines are shuffled from this, so a game can be replayed from its seed and first click
+	int32 Seed = 0;
+
+	//Used to check win condition (blocks remaining = num mines)
+	int32 BlocksRemaining = 0;
+
+	//Whether mines have been placed. Only ever true on the authority.
+	bool bGenerated = false;
+
+	//Whether BlockList has already been shuffled from Seed
+	bool bShuffled = false;
+
+	//Mines and counts never change once generated, so only the states need to be paged for undo
+	TArray<bool> Mines;
+	TArray<int8> Counts;
+	FMinesweeper3DCellStates States;
+
+	//Shuffled cell indices; after generation the first NumMines entries are the mines so they're easy to find in RevealMines()
+	TArray<int32> BlockList;
+
+	//Assigned to cells surrounding the first cell clicked to ensure they don't become mines
+	TArray<bool> GenerationSafelock;
+
+	//Where mines are likelier to go. Set before Shuffle(), which builds the sampler for it.
+	FMinesweeper3DDensity Density;
+
+	//Most neighbours a cell can have, on a 4D board
+	static constexpr int32 MaxNeighbours = TMinesweeper3DLattice<4>::NumNeighbours;
+
+	//Minimum left clicks to clear the board: one per opening (connected zeros plus their border) and one per numbered cell outside every opening
+	int32 ThreeBV = 0;
+
+	//Which opening each zero cell belongs to, INDEX_NONE for every other cell
+	TArrayView<int32> CellOpening;
+
+	//Opening i is OpeningCells[OpeningStarts[i] .. OpeningStarts[i + 1] - 1], its zero cells and the numbered cells bordering them
+	TArrayView<int32> OpeningStarts;
+	TArrayView<int32> OpeningCells;
+
+	//Cell counts by column and box, for the minimap. Every state change goes through SetState() to keep it current.
+	FMinesweeper3DCellTally Tally;
+
+	//Holds the openings and the scratch used to label them. Reset with the board, which hands the per cell arrays of a
+	//large board back to the heap rather than keep the biggest board there's been.
+	FMinesweeper3DArena GameArena;
+
+	//Picks a new random seed unless one is passed in
+	void Reset(const FMinesweeper3DBoardShape& InShape, int32 InNumMines, int32 InSeed = INDEX_NONE);
+
+	FORCEINLINE int32 Num() const { return States.Num(); }
+	FORCEINLINE bool IsValidIndex(int32 Index) const { return States.IsValidIndex(Index); }
+	FORCEINLINE int32 ToIndex(int32 Xpos, int32 Ypos, int32 Zpos) const { return (Xpos * Shape.Dims.Y + Ypos) * Shape.Dims.Z + Zpos; }
+	FORCEINLINE void ToCoords(int32 Index, int32& Xpos, int32& Ypos, int32& Zpos) const
+	{
+		Zpos = Index % Shape.Dims.Z;
+		Ypos = (Index / Shape.Dims.Z) % Shape.Dims.Y;
+		Xpos = Index / (Shape.Dims.Y * Shape.Dims.Z);
+	}
+
+	//When checking surrounding cells, ensure they are not outside the bounds of the board. X runs across every slice.
+	FORCEINLINE bool CheckBlockBounds(int32 Xpos, int32 Ypos, int32 Zpos) const
+	{
+		return Xpos >= 0 && Xpos < Shape.Dims.X * Shape.Slices && Ypos >= 0 && Ypos < Shape.Dims.Y && Zpos >= 0 && Zpos < Shape.Dims.Z;
+	}
+
+	//Calls Func(NeighbourIndex) once for each distinct cell touching Index, never Index itself
+	template<typename FuncType>
+	FORCEINLINE void ForEachNeighbour(int32 Index, FuncType&& Func) const
+	{
+		if (Shape.Is4D())
+		{
+			if (Shape.IsWrapped())	ForEachNeighbourIn<4, true>(Index, Func);
+			else ForEachNeighbourIn<4, false>(Index, Func);
+		}
+		else
+		{
+			if (Shape.IsWrapped())	ForEachNeighbourIn<3, true>(Index, Func);
+			else ForEachNeighbourIn<3, false>(Index, Func);
+		}
+	}
+
+	//Shuffles BlockList from Seed. Doesn't depend on the first click, so it can be done ahead of time on any thread.
+	void Shuffle();
+
+	//Places the mines around the first cell clicked and counts every cell's neighbours. Shuffles first if that hasn't been done.
+	void Generate(int32 FirstIndex);
+
+	//For a board whose Mines and States were written in directly, as a loaded puzzle's are. Counts and labels it and
+	//works out the totals, with no shuffle or safelock, and marks it generated.
+	void FinishLoading();
+
+	int32 CalcSurroundingMines(int32 Index) const;
+
+	//Reveals a cell, flooding out from zero cells. Appends every newly revealed cell to OutRevealed. Returns true if a mine was hit.
+	bool Reveal(int32 Index, FMinesweeper3DCellList& OutRevealed);
+
+	//Called on game loss
+	void RevealMines(FMinesweeper3DCellList& OutRevealed);
+
+	FORCEINLINE int32 NumOpenings() const { return FMath::Max(OpeningStarts.Num() - 1, 0); }
+
+	//How much of ThreeBV the player has already cleared
+	int32 CalcSolved3BV() const;
+
+	//Flags a hidden cell or unflags a flagged one. Returns false if the rules don't allow it.
+	bool ToggleFlag(int32 Index, bool& bOutFlagged);
+
+	//Brings a client's copy of the board up to date
+	void ApplyDelta(const FMinesweeper3DBoardDelta& Delta);
+
+	FMinesweeper3DBoardSnapshot TakeSnapshot() const;
+
+	//Rolls the board back (or forward) to Snapshot. Only pages that aren't shared with it are compared, and every cell that changed goes into OutDelta.
+	void RestoreSnapshot(const FMinesweeper3DBoardSnapshot& Snapshot, FMinesweeper3DBoardDelta& OutDelta);
+
+	//Cells of each state in Min .. Max inclusive, in layout coordinates. O(log^3 N) once the tally's trees are built.
+	FORCEINLINE FMinesweeper3DCellCounts CountCellsInBox(const FIntVector& Min, const FIntVector& Max) { return Tally.CountBox(Min, Max, States); }
+
+private:
+	FORCEINLINE void SetState(int32 Index, EMinesweeper3DCellState NewState)
+	{
+		Tally.Change(Index, States[Index], NewState);
+		States.Set(Index, NewState);
+	}
+
+	/**
+	 * Neighbour kernel, specialised on dimension and topology so both checks are made once per loop rather than once per
+	 * cell. The lattice does the work: bounded boards step straight through precomputed index offsets for interior cells
+	 * and only fall back to the axis tables on the faces, wrapped boards always read the tables.
+	 */
+	template<int32 D, bool bWrapped, typename FuncType>
+	FORCEINLINE void ForEachNeighbourIn(int32 Index, FuncType&& Func) const
+	{
+		GetLattice<D>().template ForEachNeighbour<bWrapped>(Index, Func);
+	}
+
+	template<int32 D>
+	const TMinesweeper3DLattice<D>& GetLattice() const;
+
+	template<int32 D, bool bWrapped>
+	void AssignSurroundingMineTotalsIn();
+
+	template<int32 D, bool bWrapped>
+	void FloodRevealIn(FMinesweeper3DCellList& Pending, FMinesweeper3DCellList& OutRevealed);
+
+	template<int32 D, bool bWrapped>
+	void LabelOpeningsIn();
+
+	//Reveals a whole precomputed opening in one pass. Returns false without touching anything if a flag inside it means a flood has to decide.
+	bool RevealOpening(int32 Opening, FMinesweeper3DCellList& OutRevealed);
+
+	void BuildNeighbourTables();
+	void SafelockBlocks(int32 Index);
+	void GenerateMines();
+	//Shaped densities draw each mine from MineSampler. Cells that are already mines, or safelocked, are redrawn.
+	void GenerateShapedMines();
+	//Over every cell, or only those still free to become mines. Weights is one float per cell of scratch to fill.
+	//Returns false if none of them can.
+	bool BuildMineSampler(bool bOnlyFreeCells, TArrayView<float> Weights);
+	void AssignSurroundingMineTotals();
+	void LabelOpenings();
+
+	//Built by Shuffle() for a shaped density, and dropped once the mines are placed
+	FMinesweeper3DAliasTable MineSampler;
+
+	//Only the one matching Shape.Slices is set up. The 4D lattice's axes are W, X, Y, Z.
+	TMinesweeper3DLattice<3> Lattice3D;
+	TMinesweeper3DLattice<4> Lattice4D;
+};
+
+template<>
+FORCEINLINE const TMinesweeper3DLattice<3>& FMinesweeper3DBoard::GetLattice<3>() const { return Lattice3D; }
+
+template<>
+FORCEINLINE const TMinesweeper3DLattice<4>& FMinesweeper3DBoard::GetLattice<4>() const { return Lattice4D; }
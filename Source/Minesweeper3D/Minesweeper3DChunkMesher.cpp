@@ -0,0 +1,233 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DChunkMesher.h"
+#include "Minesweeper3D.h"
+
+DECLARE_CYCLE_STAT(TEXT("Build chunk mesh"), STAT_BuildChunkMesh, STATGROUP_Minesweeper3D);
+
+const FColor FMinesweeper3DChunkMesher::HiddenColor(40, 90, 200);
+const FColor FMinesweeper3DChunkMesher::FlaggedColor(230, 120, 20);
+const FColor FMinesweeper3DChunkMesher::MineColor(200, 20, 20);
+
+namespace
+{
+	enum EFaceType : uint8
+	{
+		NoFace,
+		HiddenFace,
+		FlaggedFace,
+		MineFace
+	};
+
+	//What a cell shows the outside world. NoFace means there's nothing there: revealed, off the board or outside the slice.
+	uint8 GetFaceType(const FMinesweeper3DChunkMeshInput& Input, const FIntVector& Pos)
+	{
+		const FIntVector& Dims = Input.Shape.Dims;
+		if (Pos.X < 0 || Pos.X >= Dims.X * Input.Shape.Slices || Pos.Y < 0 || Pos.Y >= Dims.Y || Pos.Z < 0 || Pos.Z >= Dims.Z)	return NoFace;
+		if (Input.bSliced && (Pos[Input.SliceAxis] < Input.SliceMin || Pos[Input.SliceAxis] > Input.SliceMax))	return NoFace;
+
+		const int32 Index = (Pos.X * Dims.Y + Pos.Y) * Dims.Z + Pos.Z;
+		switch (Input.States[Index])
+		{
+		case EMinesweeper3DCellState::Hidden:	return HiddenFace;
+		case EMinesweeper3DCellState::Flagged:	return FlaggedFace;
+		default:	return Input.Counts.Num() > 0 && Input.Counts[Index] == FMinesweeper3DBoard::MineCount ? MineFace : NoFace;
+		}
+	}
+
+	static_assert(FMinesweeper3DChunkMesher::ChunkSize == FMinesweeper3DEndlessBoard::PageSize, "Endless chunks are built a page at a time");
+
+	//Chunks are filled with a one cell border so every face check stays inside the array
+	constexpr int32 Padded = FMinesweeper3DChunkMesher::ChunkSize + 2;
+	constexpr int32 PaddedVolume = Padded * Padded * Padded;
+
+	FORCEINLINE int32 VolumeIndex(const FIntVector& Pos)
+	{
+		return ((Pos.X + 1) * Padded + (Pos.Y + 1)) * Padded + (Pos.Z + 1);
+	}
+
+	FColor GetFaceColor(uint8 Face)
+	{
+		switch (Face)
+		{
+		case FlaggedFace:	return FMinesweeper3DChunkMesher::FlaggedColor;
+		case MineFace:	return FMinesweeper3DChunkMesher::MineColor;
+		default:	return FMinesweeper3DChunkMesher::HiddenColor;
+		}
+	}
+
+	//Greedy meshes a filled volume into OutData
+	void MeshVolume(const uint8* Volume, const FIntVector& Size, const FIntVector& ChunkMin, float BlockSpacing, FMinesweeper3DChunkMeshData& OutData)
+	{
+		constexpr int32 ChunkSize = FMinesweeper3DChunkMesher::ChunkSize;
+		FIntVector Pos;
+		uint8 Mask[ChunkSize * ChunkSize];
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			//The two axes that lie in a layer, in the order that makes U x V point along +Axis
+			const int32 U = (Axis + 1) % 3;
+			const int32 V = (Axis + 2) % 3;
+
+			for (int32 Side = -1; Side <= 1; Side += 2)
+			{
+				FVector Normal = FVector::ZeroVector;
+				Normal[Axis] = Side;
+
+				//Unreal treats a triangle as front facing when (C - A) x (B - A) points out of it, so U, U + V, V only works facing -Axis
+				const bool bFlipWinding = Side > 0;
+
+				for (int32 Layer = 0; Layer < Size[Axis]; Layer++)
+				{
+					//Faces on this layer that look out into an empty cell
+					Pos[Axis] = Layer;
+					for (int32 j = 0; j < Size[V]; j++)
+					{
+						for (int32 i = 0; i < Size[U]; i++)
+						{
+							Pos[U] = i;
+							Pos[V] = j;
+							FIntVector Beyond = Pos;
+							Beyond[Axis] += Side;
+
+							const uint8 Face = Volume[VolumeIndex(Pos)];
+							Mask[j * ChunkSize + i] = (Face != NoFace && Volume[VolumeIndex(Beyond)] == NoFace) ? Face : NoFace;
+						}
+					}
+
+					//Grow each face along U as far as it goes, then along V while every row below matches, and clear what was used
+					for (int32 j = 0; j < Size[V]; j++)
+					{
+						for (int32 i = 0; i < Size[U];)
+						{
+							const uint8 Face = Mask[j * ChunkSize + i];
+							if (Face == NoFace)
+							{
+								i++;
+								continue;
+							}
+
+							int32 Width = 1;
+							while (i + Width < Size[U] && Mask[j * ChunkSize + i + Width] == Face)	Width++;
+
+							int32 Height = 1;
+							for (; j + Height < Size[V]; Height++)
+							{
+								bool bRowMatches = true;
+								for (int32 k = 0; k < Width && bRowMatches; k++)
+								{
+									bRowMatches = Mask[(j + Height) * ChunkSize + i + k] == Face;
+								}
+								if (!bRowMatches)	break;
+							}
+
+							for (int32 Row = j; Row < j + Height; Row++)
+							{
+								FMemory::Memzero(&Mask[Row * ChunkSize + i], Width);
+							}
+
+							//Cells are centred on their coordinates, so faces sit half a cell either side
+							FVector Origin;
+							Origin[Axis] = ChunkMin[Axis] + Layer + 0.5f * Side;
+							Origin[U] = ChunkMin[U] + i - 0.5f;
+							Origin[V] = ChunkMin[V] + j - 0.5f;
+							FVector DeltaU = FVector::ZeroVector;
+							DeltaU[U] = Width;
+							FVector DeltaV = FVector::ZeroVector;
+							DeltaV[V] = Height;
+
+							const int32 Base = OutData.Vertices.Num();
+							OutData.Vertices.Add(Origin * BlockSpacing);
+							OutData.Vertices.Add((Origin + DeltaU) * BlockSpacing);
+							OutData.Vertices.Add((Origin + DeltaU + DeltaV) * BlockSpacing);
+							OutData.Vertices.Add((Origin + DeltaV) * BlockSpacing);
+
+							const FColor Color = GetFaceColor(Face);
+							for (int32 Corner = 0; Corner < 4; Corner++)
+							{
+								OutData.Normals.Add(Normal);
+								OutData.Colors.Add(Color);
+							}
+
+							if (bFlipWinding)
+							{
+								OutData.Triangles.Append({ Base, Base + 2, Base + 1, Base, Base + 3, Base + 2 });
+							}
+							else
+							{
+								OutData.Triangles.Append({ Base, Base + 1, Base + 2, Base, Base + 2, Base + 3 });
+							}
+
+							i += Width;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void FMinesweeper3DChunkMesher::BuildChunk(const FMinesweeper3DChunkMeshInput& Input, const FIntVector& ChunkMin, FMinesweeper3DChunkMeshData& OutData)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BuildChunkMesh);
+
+	const FIntVector& Dims = Input.Shape.Dims;
+	const FIntVector Size(
+		FMath::Min(ChunkSize, Dims.X - ChunkMin.X),
+		FMath::Min(ChunkSize, Dims.Y - ChunkMin.Y),
+		FMath::Min(ChunkSize, Dims.Z - ChunkMin.Z));
+
+	//Face types for the chunk plus a one cell border, read from the board once so the face checks are array lookups
+	uint8 Volume[PaddedVolume];
+
+	FIntVector Pos;
+	for (Pos.X = -1; Pos.X <= Size.X; Pos.X++)
+	{
+		for (Pos.Y = -1; Pos.Y <= Size.Y; Pos.Y++)
+		{
+			for (Pos.Z = -1; Pos.Z <= Size.Z; Pos.Z++)
+			{
+				Volume[VolumeIndex(Pos)] = GetFaceType(Input, ChunkMin + Pos);
+			}
+		}
+	}
+
+	MeshVolume(Volume, Size, ChunkMin, Input.BlockSpacing, OutData);
+}
+
+void FMinesweeper3DChunkMesher::BuildEndlessChunk(const FMinesweeper3DEndlessChunkInput& Input, const FIntVector& ChunkMin, FMinesweeper3DChunkMeshData& OutData)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BuildChunkMesh);
+
+	const FIntVector Size(ChunkSize);
+	const FIntVector ChunkPage = FMinesweeper3DEndlessBoard::ToPage(ChunkMin);
+
+	uint8 Volume[PaddedVolume];
+	FIntVector Pos;
+	for (Pos.X = -1; Pos.X <= Size.X; Pos.X++)
+	{
+		for (Pos.Y = -1; Pos.Y <= Size.Y; Pos.Y++)
+		{
+			for (Pos.Z = -1; Pos.Z <= Size.Z; Pos.Z++)
+			{
+				const FIntVector Cell = ChunkMin + Pos;
+				uint8 Face = NoFace;
+				if (Cell.X >= Input.RegionMin.X && Cell.X <= Input.RegionMax.X && Cell.Y >= Input.RegionMin.Y && Cell.Y <= Input.RegionMax.Y
+					&& Cell.Z >= Input.RegionMin.Z && Cell.Z <= Input.RegionMax.Z)
+				{
+					const FIntVector PageOffset = FMinesweeper3DEndlessBoard::ToPage(Cell) - ChunkPage + FIntVector(1);
+					const FMinesweeper3DEndlessPage* Page = Input.Pages[(PageOffset.X * 3 + PageOffset.Y) * 3 + PageOffset.Z].Get();
+					const EMinesweeper3DCellState State = Page ? Page->States[FMinesweeper3DEndlessBoard::ToPageIndex(Cell)] : EMinesweeper3DCellState::Hidden;
+					switch (State)
+					{
+					case EMinesweeper3DCellState::Hidden:	Face = HiddenFace;	break;
+					case EMinesweeper3DCellState::Flagged:	Face = FlaggedFace;	break;
+					default:	Face = Input.Mines.IsMine(Cell) ? MineFace : NoFace;	break;
+					}
+				}
+				Volume[VolumeIndex(Pos)] = Face;
+			}
+		}
+	}
+
+	MeshVolume(Volume, Size, ChunkMin, Input.BlockSpacing, OutData);
+}
@@ -0,0 +1,75 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Minesweeper3DBoard.h"
+#include "Minesweeper3DEndlessBoard.h"
+
+/** What a chunk build reads. Shared by every chunk started in the same flush, and never touched again by the game thread. */
+struct FMinesweeper3DChunkMeshInput
+{
+	FMinesweeper3DBoardShape Shape;
+
+	//Copying the paged states only copies page pointers, and later writes on the game thread copy the page instead of racing us
+	FMinesweeper3DCellStates States;
+
+	//Only filled in once mines have been revealed, so they can stay solid. Empty the rest of the time.
+	TArray<int8> Counts;
+
+	float BlockSpacing = 100.f;
+
+	//Cells outside SliceMin..SliceMax along SliceAxis are left out entirely
+	bool bSliced = false;
+	int32 SliceAxis = 2;
+	int32 SliceMin = 0;
+	int32 SliceMax = 0;
+};
+
+/** What an endless chunk build reads: the mine function and the pages around the chunk, never the live board */
+struct FMinesweeper3DEndlessChunkInput
+{
+	FMinesweeper3DEndlessMines Mines;
+
+	//Cells outside the streamed region are left out, so the edge of the region is drawn as a wall of hidden cells
+	FIntVector RegionMin = FIntVector::ZeroValue;
+	FIntVector RegionMax = FIntVector::ZeroValue;
+
+	//The chunk's own page and its 26 neighbours, offsets -1..1 with X major. Null where nothing has been touched.
+	FMinesweeper3DEndlessBoard::FPagePtr Pages[27];
+
+	float BlockSpacing = 100.f;
+};
+
+/** Surface of one chunk, ready to hand to a procedural mesh section */
+struct FMinesweeper3DChunkMeshData
+{
+	TArray<FVector> Vertices;
+	TArray<int32> Triangles;
+	TArray<FVector> Normals;
+	TArray<FColor> Colors;
+
+	bool IsEmpty() const { return Triangles.Num() == 0; }
+};
+
+/**
+ * Builds the exposed surface of the unrevealed cells in one chunk of the board.
+ * Faces between two solid cells are skipped, and the faces left on each layer are greedily merged into as few
+ * rectangles as possible, so a flat side of hidden cells costs two triangles however many cells it covers.
+ */
+struct FMinesweeper3DChunkMesher
+{
+	//Cells along each side of a chunk
+	static constexpr int32 ChunkSize = 16;
+
+	//Face colours, read by the chunk material
+	static const FColor HiddenColor;
+	static const FColor FlaggedColor;
+	static const FColor MineColor;
+
+	//Safe to call from any thread
+	static void BuildChunk(const FMinesweeper3DChunkMeshInput& Input, const FIntVector& ChunkMin, FMinesweeper3DChunkMeshData& OutData);
+
+	//Endless boards have no size, chunks line up with the board's pages instead. ChunkMin is in cells.
+	static void BuildEndlessChunk(const FMinesweeper3DEndlessChunkInput& Input, const FIntVector& ChunkMin, FMinesweeper3DChunkMeshData& OutData);
+};
@@ -0,0 +1,205 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DDensity.h"
+#include "Minesweeper3D.h"
+#include "Minesweeper3DBoard.h"
+#include "HAL/IConsoleManager.h"
+
+/*---------- Density ----------*/
+
+bool FMinesweeper3DDensity::IsValid() const
+{
+	if (!FMath::IsFinite(Contrast) || Contrast < 1.f || Contrast > 1000.f || GradientAxis < 0 || GradientAxis > 2)	return false;
+	if (Shape != EMinesweeper3DDensityShape::Painted)	return true;
+
+	return PaintedDims.GetMin() >= 1 && PaintedDims.GetMax() <= MaxPaintedSize && Painted.Num() == PaintedDims.X * PaintedDims.Y * PaintedDims.Z;
+}
+
+float FMinesweeper3DDensity::GetWeight(const FMinesweeper3DBoardShape& BoardShape, int32 Xpos, int32 Ypos, int32 Zpos) const
+{
+	const FIntVector& Dims = BoardShape.Dims;
+	const FIntVector Local(Xpos % Dims.X, Ypos, Zpos);
+
+	switch (Shape)
+	{
+	case EMinesweeper3DDensityShape::Core:
+	case EMinesweeper3DDensityShape::Shell:
+	{
+		//Distance from the middle, 0 there and 1 in the corners
+		float DistSq = 0.f;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const float Offset = Dims[Axis] > 1 ? 2.f * Local[Axis] / (Dims[Axis] - 1) - 1.f : 0.f;
+			DistSq += Offset * Offset;
+		}
+		const float Dist = FMath::Sqrt(DistSq / 3.f);
+		return 1.f + (Contrast - 1.f) * (Shape == EMinesweeper3DDensityShape::Core ? 1.f - Dist : Dist);
+	}
+	case EMinesweeper3DDensityShape::Gradient:
+	{
+		const int32 Length = Dims[GradientAxis];
+		return 1.f + (Contrast - 1.f) * (Length > 1 ? (float)Local[GradientAxis] / (Length - 1) : 0.5f);
+	}
+	case EMinesweeper3DDensityShape::Painted:
+	{
+		//Nearest painted voxel, the volume stretched to cover the board
+		const int32 Px = Local.X * PaintedDims.X / Dims.X;
+		const int32 Py = Local.Y * PaintedDims.Y / Dims.Y;
+		const int32 Pz = Local.Z * PaintedDims.Z / Dims.Z;
+		return Painted[(Px * PaintedDims.Y + Py) * PaintedDims.Z + Pz];
+	}
+	default:
+		return 1.f;
+	}
+}
+
+/*---------- Alias table ----------*/
+
+bool FMinesweeper3DAliasTable::Build(TArrayView<const float> Weights)
+{
+	const int32 Num = Weights.Num();
+	double Total = 0.0;
+	for (float Weight : Weights)
+	{
+		Total += Weight;
+	}
+	if (Num == 0 || Total <= 0.0)
+	{
+		Empty();
+		return false;
+	}
+
+	Thresholds.SetNumUninitialized(Num);
+	Aliases.SetNumUninitialized(Num);
+
+	//Weights scaled so they average 1. Slots under 1 fill up from the front of Work, the rest from the back.
+	TArray<double> Scaled;
+	TArray<int32> Work;
+	Scaled.SetNumUninitialized(Num);
+	Work.SetNumUninitialized(Num);
+	int32 NumSmall = 0;
+	int32 LargeStart = Num;
+	for (int32 Slot = 0; Slot < Num; Slot++)
+	{
+		Scaled[Slot] = Weights[Slot] * Num / Total;
+		if (Scaled[Slot] < 1.0)	Work[NumSmall++] = Slot;
+		else Work[--LargeStart] = Slot;
+	}
+
+	//Each small slot is topped up to 1 from a large one, which goes small itself once it has given enough away
+	int32 LastLarge = Work[Num - 1];
+	while (NumSmall > 0 && LargeStart < Num)
+	{
+		const int32 Small = Work[--NumSmall];
+		const int32 Large = Work[LargeStart];
+		LastLarge = Large;
+
+		Thresholds[Small] = (uint32)(Scaled[Small] * 4294967296.0);
+		Aliases[Small] = Large;
+
+		Scaled[Large] -= 1.0 - Scaled[Small];
+		if (Scaled[Large] < 1.0)
+		{
+			LargeStart++;
+			Work[NumSmall++] = Large;
+		}
+	}
+
+	//Whatever's left is 1 give or take rounding, and keeps its own slot. Zero weights never can, whatever rounding did.
+	for (int32 i = LargeStart; i < Num; i++)
+	{
+		Thresholds[Work[i]] = MAX_uint32;
+		Aliases[Work[i]] = Work[i];
+	}
+	for (int32 i = 0; i < NumSmall; i++)
+	{
+		const int32 Slot = Work[i];
+		Thresholds[Slot] = Weights[Slot] > 0.f ? MAX_uint32 : 0;
+		Aliases[Slot] = Weights[Slot] > 0.f ? Slot : LastLarge;
+	}
+	return true;
+}
+
+void FMinesweeper3DAliasTable::Empty()
+{
+	Thresholds.Empty();
+	Aliases.Empty();
+}
+
+#if !UE_BUILD_SHIPPING
+
+/*---------- Generation benchmark ----------*/
+
+namespace
+{
+	//Shuffles and places the mines of a 128^3 board with a fifth of it mined, best of three. Shuffling can be done ahead
+	//of time, the rest waits for the first click. The share of mines in the middle eighth shows the shape took.
+	void BenchmarkDensity(const TCHAR* Name, const FMinesweeper3DDensity& Density)
+	{
+		const FMinesweeper3DBoardShape Shape(128);
+		const int32 NumMines = Shape.Num() / 5;
+		const int32 FirstClick = (64 * 128 + 64) * 128 + 64;
+
+		FMinesweeper3DBoard Board;
+		double ShuffleMs = DBL_MAX;
+		double GenerateMs = DBL_MAX;
+		for (int32 Run = 0; Run < 3; Run++)
+		{
+			Board.Density = Density;
+			Board.Reset(Shape, NumMines, 1);
+
+			double StartTime = FPlatformTime::Seconds();
+			Board.Shuffle();
+			ShuffleMs = FMath::Min(ShuffleMs, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+			StartTime = FPlatformTime::Seconds();
+			Board.Generate(FirstClick);
+			GenerateMs = FMath::Min(GenerateMs, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		}
+
+		int32 CoreMines = 0;
+		for (int32 Index = 0; Index < Board.Num(); Index++)
+		{
+			int32 X, Y, Z;
+			Board.ToCoords(Index, X, Y, Z);
+			CoreMines += Board.Mines[Index] && X >= 32 && X < 96 && Y >= 32 && Y < 96 && Z >= 32 && Z < 96;
+		}
+
+		//Generating also counts and labels the board, which costs the same whatever the density
+		UE_LOG(LogMinesweeper3D, Display, TEXT("%-10s shuffle %7.2f ms, generate %7.2f ms, %d mines, %5.1f%% in the middle eighth"),
+			Name, ShuffleMs, GenerateMs, Board.NumMines, 100.f * CoreMines / FMath::Max(Board.NumMines, 1));
+	}
+
+	void RunGenerationBenchmark()
+	{
+		FMinesweeper3DDensity Density;
+		BenchmarkDensity(TEXT("Uniform"), Density);
+
+		Density.Shape = EMinesweeper3DDensityShape::Core;
+		BenchmarkDensity(TEXT("Core"), Density);
+
+		Density.Shape = EMinesweeper3DDensityShape::Shell;
+		BenchmarkDensity(TEXT("Shell"), Density);
+
+		Density.Shape = EMinesweeper3DDensityShape::Gradient;
+		BenchmarkDensity(TEXT("Gradient"), Density);
+
+		//Half the volume empty, so the sampler has to start over once the open half fills up
+		Density.Shape = EMinesweeper3DDensityShape::Painted;
+		Density.PaintedDims = FIntVector(8);
+		Density.Painted.SetNumUninitialized(8 * 8 * 8);
+		FRandomStream Stream(1);
+		for (uint8& Weight : Density.Painted)
+		{
+			Weight = Stream.FRand() < 0.5f ? 0 : (uint8)Stream.RandRange(1, 255);
+		}
+		BenchmarkDensity(TEXT("Painted"), Density);
+	}
+
+	FAutoConsoleCommand GenerationBenchmarkCommand(
+		TEXT("Minesweeper3D.GenerationBenchmark"),
+		TEXT("Times shuffling and mine placement on a 128^3 board with 20% mines, uniform and with each shaped density."),
+		FConsoleCommandDelegate::CreateStatic(&RunGenerationBenchmark));
+}
+
+#endif
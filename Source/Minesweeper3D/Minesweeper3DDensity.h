@@ -0,0 +1,90 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Minesweeper3DDensity.generated.h"
+
+struct FMinesweeper3DBoardShape;
+
+/** Where a board's mines gather */
+UENUM(BlueprintType)
+enum class EMinesweeper3DDensityShape : uint8
+{
+	//Every cell equally likely, the classic game
+	Uniform,
+	//Densest in the middle of the cube, thinning out to the corners
+	Core,
+	//Densest in the corners, thinning out to the middle
+	Shell,
+	//Rising along one axis
+	Gradient,
+	//Read from a painted volume, stretched over the board
+	Painted
+};
+
+/**
+ * Relative chance of each cell being a mine. Only the authority places mines, so a client sends its choice along with
+ * the shape when it starts a game. The number of mines doesn't change, only where they go.
+ */
+USTRUCT(BlueprintType)
+struct FMinesweeper3DDensity
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	EMinesweeper3DDensityShape Shape = EMinesweeper3DDensityShape::Uniform;
+
+	//How many times likelier the densest cells are than the sparsest, for the built in shapes
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float Contrast = 4.f;
+
+	//Axis a gradient rises along, 0 = X, 1 = Y, 2 = Z
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 GradientAxis = 2;
+
+	//A painted volume of weights, Z fastest like the board. 0 keeps mines out altogether.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FIntVector PaintedDims = FIntVector::ZeroValue;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	TArray<uint8> Painted;
+
+	//Painted volumes are sent to the server with the game they're for, so they're kept small
+	static constexpr int32 MaxPaintedSize = 32;
+
+	bool IsUniform() const { return Shape == EMinesweeper3DDensityShape::Uniform; }
+	bool IsValid() const;
+
+	//Relative weight of a cell, at layout coordinates on a board of Shape. A 4D board's slices are each shaped alike.
+	float GetWeight(const FMinesweeper3DBoardShape& BoardShape, int32 Xpos, int32 Ypos, int32 Zpos) const;
+
+	bool operator==(const FMinesweeper3DDensity& Other) const
+	{
+		return Shape == Other.Shape && Contrast == Other.Contrast && GradientAxis == Other.GradientAxis && PaintedDims == Other.PaintedDims && Painted == Other.Painted;
+	}
+};
+
+/**
+ * Walker's alias method: after a linear build, draws an index with probability proportional to its weight in O(1),
+ * one table lookup and one compare, however skewed the weights are.
+ */
+struct FMinesweeper3DAliasTable
+{
+	//Weights can't be negative. Returns false, leaving the table empty, if they're all zero.
+	bool Build(TArrayView<const float> Weights);
+
+	FORCEINLINE int32 Sample(FRandomStream& Stream) const
+	{
+		const int32 Slot = (int32)(((uint64)Stream.GetUnsignedInt() * (uint64)Thresholds.Num()) >> 32);
+		return Stream.GetUnsignedInt() < Thresholds[Slot] ? Slot : Aliases[Slot];
+	}
+
+	FORCEINLINE bool IsEmpty() const { return Thresholds.Num() == 0; }
+	void Empty();
+
+private:
+	//Chance of keeping the slot itself rather than its alias, out of 2^32. MAX_uint32 for slots that are never aliased.
+	TArray<uint32> Thresholds;
+	TArray<int32> Aliases;
+};
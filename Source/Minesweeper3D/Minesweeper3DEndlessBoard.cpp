@@ -0,0 +1,208 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DEndlessBoard.h"
+
+namespace
+{
+	FORCEINLINE bool IsInRegion(const FIntVector& Pos, const FIntVector& RegionMin, const FIntVector& RegionMax)
+	{
+		return Pos.X >= RegionMin.X && Pos.X <= RegionMax.X && Pos.Y >= RegionMin.Y && Pos.Y <= RegionMax.Y && Pos.Z >= RegionMin.Z && Pos.Z <= RegionMax.Z;
+	}
+}
+
+int32 FMinesweeper3DEndlessMines::CountMines(const FIntVector& Pos) const
+{
+	int32 Count = 0;
+	for (int32 x = -1; x <= 1; x++)
+	{
+		for (int32 y = -1; y <= 1; y++)
+		{
+			for (int32 z = -1; z <= 1; z++)
+			{
+				if ((x != 0 || y != 0 || z != 0) && IsMine(Pos + FIntVector(x, y, z)))	Count++;
+			}
+		}
+	}
+	return Count;
+}
+
+void FMinesweeper3DEndlessBoard::Reset(int32 InSeed, float MineDensity)
+{
+	Mines = FMinesweeper3DEndlessMines();
+	Mines.Seed = InSeed;
+	Mines.Threshold = (uint32)FMath::Clamp((double)MineDensity * 4294967296.0, 0.0, 4294967295.0);
+
+	NumRevealed = 0;
+	NumFlags = 0;
+	Pages.Empty();
+	PendingFlood.Empty();
+}
+
+void FMinesweeper3DEndlessBoard::SetFirstClick(const FIntVector& Pos)
+{
+	Mines.bSafeZone = true;
+	Mines.SafeCenter = Pos;
+}
+
+EMinesweeper3DCellState FMinesweeper3DEndlessBoard::GetState(const FIntVector& Pos) const
+{
+	const FPagePtr* Page = Pages.Find(ToPage(Pos));
+	return Page ? (*Page)->States[ToPageIndex(Pos)] : EMinesweeper3DCellState::Hidden;
+}
+
+FMinesweeper3DEndlessBoard::FPagePtr FMinesweeper3DEndlessBoard::FindPage(const FIntVector& PageCoord) const
+{
+	const FPagePtr* Page = Pages.Find(PageCoord);
+	return Page ? *Page : FPagePtr();
+}
+
+//Makes the page the first time anything in it is touched, and copies it if a chunk build is still reading it
+FMinesweeper3DEndlessPage& FMinesweeper3DEndlessBoard::GetPageForWrite(const FIntVector& Pos)
+{
+	FPagePtr& Page = Pages.FindOrAdd(ToPage(Pos));
+	if (!Page.IsValid())
+	{
+		Page = MakeShared<FMinesweeper3DEndlessPage, ESPMode::ThreadSafe>();
+		Page->States.Init(EMinesweeper3DCellState::Hidden, PageSize * PageSize * PageSize);
+	}
+	else if (!Page.IsUnique())
+	{
+		Page = MakeShared<FMinesweeper3DEndlessPage, ESPMode::ThreadSafe>(*Page);
+	}
+	return *Page;
+}
+
+void FMinesweeper3DEndlessBoard::SetState(const FIntVector& Pos, EMinesweeper3DCellState State)
+{
+	GetPageForWrite(Pos).States[ToPageIndex(Pos)] = State;
+}
+
+void FMinesweeper3DEndlessBoard::MarkRevealed(const FIntVector& Pos, int32 Count)
+{
+	FMinesweeper3DEndlessPage& Page = GetPageForWrite(Pos);
+	const int32 Index = ToPageIndex(Pos);
+	Page.States[Index] = EMinesweeper3DCellState::Revealed;
+	if (Count > 0)	Page.Numbered.Add((uint16)Index);
+	NumRevealed++;
+}
+
+bool FMinesweeper3DEndlessBoard::Reveal(const FIntVector& Pos, const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed)
+{
+	if (GetState(Pos) != EMinesweeper3DCellState::Hidden)	return false;
+
+	if (Mines.IsMine(Pos))
+	{
+		SetState(Pos, EMinesweeper3DCellState::Revealed);
+		OutRevealed.Add(Pos);
+		return true;
+	}
+
+	//Cells are marked revealed as they're queued so nothing gets queued twice, and counted once they come off
+	FWorklist Pending;
+	Pending.Add(Pos);
+	SetState(Pos, EMinesweeper3DCellState::Revealed);
+	FloodReveal(Pending, RegionMin, RegionMax, OutRevealed);
+	return false;
+}
+
+void FMinesweeper3DEndlessBoard::FloodReveal(FWorklist& Pending, const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed)
+{
+	while (Pending.Num() > 0)
+	{
+		const FIntVector Current = Pending.Pop(false);
+		const int32 Count = Mines.CountMines(Current);
+		MarkRevealed(Current, Count);
+		OutRevealed.Add(Current);
+
+		if (Count == 0)	ExpandZero(Current, RegionMin, RegionMax, Pending);
+	}
+}
+
+void FMinesweeper3DEndlessBoard::ExpandZero(const FIntVector& Pos, const FIntVector& RegionMin, const FIntVector& RegionMax, FWorklist& Pending)
+{
+	bool bHeldBack = false;
+	for (int32 x = -1; x <= 1; x++)
+	{
+		for (int32 y = -1; y <= 1; y++)
+		{
+			for (int32 z = -1; z <= 1; z++)
+			{
+				const FIntVector Neighbour = Pos + FIntVector(x, y, z);
+				if (GetState(Neighbour) != EMinesweeper3DCellState::Hidden)	continue;
+
+				if (!IsInRegion(Neighbour, RegionMin, RegionMax))
+				{
+					bHeldBack = true;
+					continue;
+				}
+
+				SetState(Neighbour, EMinesweeper3DCellState::Revealed);
+				Pending.Add(Neighbour);
+			}
+		}
+	}
+
+	if (bHeldBack)	PendingFlood.Add(Pos);
+}
+
+void FMinesweeper3DEndlessBoard::ContinueFlood(const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed)
+{
+	if (PendingFlood.Num() == 0)	return;
+
+	//Anything still out of reach goes straight back into PendingFlood
+	FWorklist Edge;
+	Edge.Reserve(PendingFlood.Num());
+	for (const FIntVector& Cell : PendingFlood)
+	{
+		Edge.Add(Cell);
+	}
+	PendingFlood.Reset();
+
+	FWorklist Pending;
+	for (const FIntVector& Cell : Edge)
+	{
+		ExpandZero(Cell, RegionMin, RegionMax, Pending);
+	}
+	FloodReveal(Pending, RegionMin, RegionMax, OutRevealed);
+}
+
+void FMinesweeper3DEndlessBoard::RevealMines(const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed)
+{
+	FIntVector Pos;
+	for (Pos.X = RegionMin.X; Pos.X <= RegionMax.X; Pos.X++)
+	{
+		for (Pos.Y = RegionMin.Y; Pos.Y <= RegionMax.Y; Pos.Y++)
+		{
+			for (Pos.Z = RegionMin.Z; Pos.Z <= RegionMax.Z; Pos.Z++)
+			{
+				//Correctly flagged mines keep their flag
+				if (Mines.IsMine(Pos) && GetState(Pos) == EMinesweeper3DCellState::Hidden)
+				{
+					SetState(Pos, EMinesweeper3DCellState::Revealed);
+					OutRevealed.Add(Pos);
+				}
+			}
+		}
+	}
+}
+
+//There's no mine total to run out of flags against
+bool FMinesweeper3DEndlessBoard::ToggleFlag(const FIntVector& Pos, bool& bOutFlagged)
+{
+	const EMinesweeper3DCellState State = GetState(Pos);
+	if (State == EMinesweeper3DCellState::Flagged)
+	{
+		SetState(Pos, EMinesweeper3DCellState::Hidden);
+		NumFlags--;
+		bOutFlagged = false;
+		return true;
+	}
+	else if (State == EMinesweeper3DCellState::Hidden)
+	{
+		SetState(Pos, EMinesweeper3DCellState::Flagged);
+		NumFlags++;
+		bOutFlagged = true;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,125 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/SharedPointer.h"
+#include "Minesweeper3DBoard.h"
+#include "Minesweeper3DMorton.h"
+#include "Minesweeper3DArena.h"
+
+/**
+ * Where the mines are on an endless board. A cell is a mine purely as a function of the seed and its coordinates, so
+ * any cell's count can be worked out without generating anything around it, on any thread.
+ */
+struct FMinesweeper3DEndlessMines
+{
+	int32 Seed = 0;
+
+	//A cell is a mine when its hash falls below this, so it's the density scaled to 2^32
+	uint32 Threshold = 0;
+
+	//The first click and everything touching it is kept clear, same as a normal board's safelock
+	bool bSafeZone = false;
+	FIntVector SafeCenter = FIntVector::ZeroValue;
+
+	/**
+	 * Counter based hash: the coordinates are packed into a 63 bit counter, offset by the seed and put through the
+	 * SplitMix64 finaliser. Coordinates are taken modulo 2^21, so the board repeats every two million cells along an axis.
+	 */
+	static FORCEINLINE uint32 HashCell(int32 InSeed, const FIntVector& Pos)
+	{
+		constexpr uint64 CoordMask = (1ull << 21) - 1;
+		uint64 Key = ((uint64)(uint32)Pos.X & CoordMask) << 42 | ((uint64)(uint32)Pos.Y & CoordMask) << 21 | ((uint64)(uint32)Pos.Z & CoordMask);
+		Key += (uint64)(uint32)InSeed * 0x9E3779B97F4A7C15ull;
+		Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ull;
+		Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBull;
+		Key ^= Key >> 31;
+		return (uint32)(Key >> 32);
+	}
+
+	FORCEINLINE bool IsMine(const FIntVector& Pos) const
+	{
+		if (bSafeZone && FMath::Abs(Pos.X - SafeCenter.X) <= 1 && FMath::Abs(Pos.Y - SafeCenter.Y) <= 1 && FMath::Abs(Pos.Z - SafeCenter.Z) <= 1)	return false;
+		return HashCell(Seed, Pos) < Threshold;
+	}
+
+	int32 CountMines(const FIntVector& Pos) const;
+};
+
+/** Touched cells of one 16^3 page of an endless board. Pages nobody has revealed or flagged anything in don't exist. */
+struct FMinesweeper3DEndlessPage
+{
+	TArray<EMinesweeper3DCellState> States;
+
+	//Revealed cells in this page showing a count of 1..26, by index within the page
+	TArray<uint16> Numbered;
+};
+
+/**
+ * Board with no size. Mines come from FMinesweeper3DEndlessMines, and only revealed and flagged state is kept, in a
+ * hash map of pages keyed by page coordinate. Pages are shared with chunk builds the same way the paged array shares
+ * them with snapshots: a write copies the page first if a worker is still holding on to it.
+ * Flood reveals are bounded by the region the grid currently has streamed in. Zero cells on the flood's edge are kept
+ * aside and carried on from once the region moves to cover their neighbours.
+ */
+struct FMinesweeper3DEndlessBoard
+{
+	static constexpr int32 PageShift = 4;
+	static constexpr int32 PageSize = 1 << PageShift;
+	static constexpr int32 PageMask = PageSize - 1;
+
+	typedef TSharedPtr<FMinesweeper3DEndlessPage, ESPMode::ThreadSafe> FPagePtr;
+
+	FMinesweeper3DEndlessMines Mines;
+
+	int32 NumRevealed = 0;
+	int32 NumFlags = 0;
+
+	TMap<FIntVector, FPagePtr> Pages;
+
+	//Revealed zero cells that still have hidden neighbours outside the streamed region
+	TSet<FIntVector> PendingFlood;
+
+	void Reset(int32 InSeed, float MineDensity);
+
+	//Keeps the first click clear. Has to happen before anything is revealed, since it moves mines.
+	void SetFirstClick(const FIntVector& Pos);
+
+	//Arithmetic shift, so negative coordinates round down into the page below rather than towards zero
+	static FORCEINLINE FIntVector ToPage(const FIntVector& Pos) { return FIntVector(Pos.X >> PageShift, Pos.Y >> PageShift, Pos.Z >> PageShift); }
+	//Cells within a page are in Morton order, so a flood, or a chunk build walking its 16^3 slab, stays within a few cache lines at a time
+	static FORCEINLINE int32 ToPageIndex(const FIntVector& Pos) { return FMinesweeper3DMorton::Encode(Pos.X & PageMask, Pos.Y & PageMask, Pos.Z & PageMask); }
+	static FORCEINLINE FIntVector FromPageIndex(int32 Index)
+	{
+		FIntVector Local;
+		FMinesweeper3DMorton::Decode(Index, Local.X, Local.Y, Local.Z);
+		return Local;
+	}
+
+	EMinesweeper3DCellState GetState(const FIntVector& Pos) const;
+	FPagePtr FindPage(const FIntVector& PageCoord) const;
+
+	//Reveals a cell, flooding out from zeros as far as RegionMin..RegionMax. Appends every newly revealed cell to OutRevealed. Returns true if a mine was hit.
+	bool Reveal(const FIntVector& Pos, const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed);
+
+	//Carries pending floods on into whatever part of RegionMin..RegionMax they couldn't reach before
+	void ContinueFlood(const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed);
+
+	//Called on game loss. Only the mines inside the region are shown, there's no end to the rest.
+	void RevealMines(const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed);
+
+	bool ToggleFlag(const FIntVector& Pos, bool& bOutFlagged);
+
+private:
+	//Flood worklists are frame scratch
+	typedef TArray<FIntVector, FMinesweeper3DFrameAllocator> FWorklist;
+
+	FMinesweeper3DEndlessPage& GetPageForWrite(const FIntVector& Pos);
+	void SetState(const FIntVector& Pos, EMinesweeper3DCellState State);
+	void MarkRevealed(const FIntVector& Pos, int32 Count);
+
+	//Expands revealed zero cells, holding back any that reach outside the region
+	void FloodReveal(FWorklist& Pending, const FIntVector& RegionMin, const FIntVector& RegionMax, TArray<FIntVector>& OutRevealed);
+	void ExpandZero(const FIntVector& Pos, const FIntVector& RegionMin, const FIntVector& RegionMax, FWorklist& Pending);
+};
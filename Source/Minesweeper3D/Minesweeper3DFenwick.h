@@ -0,0 +1,99 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 3D Fenwick (binary indexed) tree over a row-major X x Y x Z grid of counts, laid out like the board's flat index.
+ * Adding to one cell and summing any axis-aligned box both cost O(log X * log Y * log Z). Building from scratch is
+ * linear, one pass per axis, so a tree that has fallen far behind is cheaper to rebuild than to catch up.
+ */
+struct FMinesweeper3DFenwick3D
+{
+	//All zeros
+	void Init(const FIntVector& InDims)
+	{
+		Dims = InDims;
+		Tree.SetNumUninitialized(Dims.X * Dims.Y * Dims.Z);
+		FMemory::Memzero(Tree.GetData(), Tree.Num() * sizeof(int32));
+	}
+
+	//Fills the tree from ValueAt(FlatIndex) in O(N)
+	template<typename FuncType>
+	void Build(FuncType&& ValueAt)
+	{
+		for (int32 Index = 0; Index < Tree.Num(); Index++)
+		{
+			Tree[Index] = ValueAt(Index);
+		}
+
+		//Each node then passes its total up to its parent, one axis at a time
+		PropagateAxis(Dims.Z, 1);
+		PropagateAxis(Dims.Y, Dims.Z);
+		PropagateAxis(Dims.X, Dims.Y * Dims.Z);
+	}
+
+	FORCEINLINE void Add(int32 Xpos, int32 Ypos, int32 Zpos, int32 Delta)
+	{
+		for (int32 i = Xpos + 1; i <= Dims.X; i += i & -i)
+		{
+			for (int32 j = Ypos + 1; j <= Dims.Y; j += j & -j)
+			{
+				const int32 Row = ((i - 1) * Dims.Y + j - 1) * Dims.Z - 1;
+				for (int32 k = Zpos + 1; k <= Dims.Z; k += k & -k)
+				{
+					Tree[Row + k] += Delta;
+				}
+			}
+		}
+	}
+
+	//Total over Min .. Max inclusive, which has to be inside the grid
+	int32 SumBox(const FIntVector& Min, const FIntVector& Max) const
+	{
+		const FIntVector& Lo = Min;
+		const FIntVector Hi = Max + FIntVector(1);
+		return PrefixSum(Hi.X, Hi.Y, Hi.Z)
+			- PrefixSum(Lo.X, Hi.Y, Hi.Z) - PrefixSum(Hi.X, Lo.Y, Hi.Z) - PrefixSum(Hi.X, Hi.Y, Lo.Z)
+			+ PrefixSum(Lo.X, Lo.Y, Hi.Z) + PrefixSum(Lo.X, Hi.Y, Lo.Z) + PrefixSum(Hi.X, Lo.Y, Lo.Z)
+			- PrefixSum(Lo.X, Lo.Y, Lo.Z);
+	}
+
+	FORCEINLINE bool IsInitialized() const { return Tree.Num() > 0; }
+	SIZE_T GetAllocatedSize() const { return Tree.GetAllocatedSize(); }
+
+private:
+	//Total of the first Xcount x Ycount x Zcount cells
+	FORCEINLINE int32 PrefixSum(int32 Xcount, int32 Ycount, int32 Zcount) const
+	{
+		int32 Sum = 0;
+		for (int32 i = Xcount; i > 0; i -= i & -i)
+		{
+			for (int32 j = Ycount; j > 0; j -= j & -j)
+			{
+				const int32 Row = ((i - 1) * Dims.Y + j - 1) * Dims.Z - 1;
+				for (int32 k = Zcount; k > 0; k -= k & -k)
+				{
+					Sum += Tree[Row + k];
+				}
+			}
+		}
+		return Sum;
+	}
+
+	//Along one axis of Length cells, Stride apart in the flat index. Cells come up in increasing order along every line,
+	//so a node has everything below it in by the time it's passed on.
+	void PropagateAxis(int32 Length, int32 Stride)
+	{
+		for (int32 Index = 0; Index < Tree.Num(); Index++)
+		{
+			const int32 Pos = (Index / Stride) % Length + 1;
+			const int32 Parent = Pos + (Pos & -Pos);
+			if (Parent <= Length)	Tree[Index + (Parent - Pos) * Stride] += Tree[Index];
+		}
+	}
+
+	FIntVector Dims = FIntVector::ZeroValue;
+	TArray<int32> Tree;
+};
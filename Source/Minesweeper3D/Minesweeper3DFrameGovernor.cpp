@@ -0,0 +1,118 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DFrameGovernor.h"
+#include "Minesweeper3D.h"
+#include "RenderCore.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame governor quality"), STAT_FrameGovernorQuality, STATGROUP_Minesweeper3D);
+
+namespace
+{
+	//Weight of the newest frame in the smoothed thread times
+	constexpr float ThreadTimeSmoothing = 0.1f;
+
+	//Quality drops once over budget by this much, and comes back once under it by this much, so it doesn't hunt
+	constexpr float OverBudgetRatio = 1.1f;
+	constexpr float UnderBudgetRatio = 0.75f;
+
+	//Drop fast, recover slowly
+	constexpr float StepDownDelay = 0.25f;
+	constexpr float StepUpDelay = 1.f;
+	constexpr float StepDown = 0.1f;
+	constexpr float StepUp = 0.05f;
+
+	//Per cell: mine, count, state and safelock bytes, the shuffled index, opening label, opening membership and union-find
+	//parent, then the flagged and revealed box count trees
+	constexpr int64 BoardBytesPerCell = 1 + 1 + 1 + 1 + 4 + 4 + 4 + 4 + 4 + 4;
+
+	//Actor, static mesh and text render components, and their render proxies
+	constexpr int64 BytesPerBlock = 8 * 1024;
+}
+
+TWeakPtr<FMinesweeper3DFrameGovernor> FMinesweeper3DFrameGovernor::Instance;
+
+TSharedRef<FMinesweeper3DFrameGovernor> FMinesweeper3DFrameGovernor::Acquire(float InTargetFrameMs)
+{
+	check(IsInGameThread());
+
+	if (TSharedPtr<FMinesweeper3DFrameGovernor> Existing = Instance.Pin())	return Existing.ToSharedRef();
+
+	TSharedRef<FMinesweeper3DFrameGovernor> NewGovernor = MakeShared<FMinesweeper3DFrameGovernor>();
+	NewGovernor->TargetFrameMs = InTargetFrameMs;
+	Instance = NewGovernor;
+	return NewGovernor;
+}
+
+FMinesweeper3DFrameGovernor::FMinesweeper3DFrameGovernor()
+{
+	MaxChunkBuildsInFlight = 2 * FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+
+	//The grid only ticks while something's moving, but frames need measuring whether or not anything is
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(this, &FMinesweeper3DFrameGovernor::OnEndFrame);
+}
+
+FMinesweeper3DFrameGovernor::~FMinesweeper3DFrameGovernor()
+{
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+}
+
+void FMinesweeper3DFrameGovernor::OnEndFrame()
+{
+	//Both are last frame's, the render thread runs a frame behind
+	GameThreadMs = FMath::Lerp(GameThreadMs, (float)FPlatformTime::ToMilliseconds(GGameThreadTime), ThreadTimeSmoothing);
+	RenderThreadMs = FMath::Lerp(RenderThreadMs, (float)FPlatformTime::ToMilliseconds(GRenderThreadTime), ThreadTimeSmoothing);
+
+	const float FrameMs = FMath::Max(GameThreadMs, RenderThreadMs);
+	const float DeltaSeconds = FApp::GetDeltaTime();
+	if (FrameMs > TargetFrameMs * OverBudgetRatio)
+	{
+		UnderBudgetSeconds = 0.f;
+		OverBudgetSeconds += DeltaSeconds;
+		if (OverBudgetSeconds >= StepDownDelay && Quality > MinQuality)	SetQuality(Quality - StepDown);
+	}
+	else if (FrameMs < TargetFrameMs * UnderBudgetRatio)
+	{
+		OverBudgetSeconds = 0.f;
+		UnderBudgetSeconds += DeltaSeconds;
+		if (UnderBudgetSeconds >= StepUpDelay && Quality < 1.f)	SetQuality(Quality + StepUp);
+	}
+	else
+	{
+		OverBudgetSeconds = 0.f;
+		UnderBudgetSeconds = 0.f;
+	}
+}
+
+void FMinesweeper3DFrameGovernor::SetQuality(float NewQuality)
+{
+	OverBudgetSeconds = 0.f;
+	UnderBudgetSeconds = 0.f;
+
+	NewQuality = FMath::Clamp(NewQuality, MinQuality, 1.f);
+	if (NewQuality == Quality)	return;
+
+	UE_LOG(LogMinesweeper3D, Verbose, TEXT("Frame governor: quality %.2f -> %.2f (game %.1f ms, render %.1f ms, budget %.1f ms)"),
+		Quality, NewQuality, GameThreadMs, RenderThreadMs, TargetFrameMs);
+	Quality = NewQuality;
+	SET_FLOAT_STAT(STAT_FrameGovernorQuality, Quality);
+	OnQualityChanged.Broadcast();
+}
+
+void FMinesweeper3DFrameGovernor::RecordBlockSpawn(double Seconds)
+{
+	BlockSpawnSeconds = FMath::Lerp(BlockSpawnSeconds, Seconds, 0.05);
+}
+
+FMinesweeper3DBoardCost FMinesweeper3DFrameGovernor::EstimateBoardCost(const FMinesweeper3DBoardShape& Shape, int32 NumPooledBlocks) const
+{
+	//In 64 bits, a custom size can overflow int32 long before it's rejected
+	const int64 NumCells = (int64)Shape.Dims.X * Shape.Dims.Y * Shape.Dims.Z * Shape.Slices;
+
+	FMinesweeper3DBoardCost Cost;
+	Cost.BoardBytes = NumCells * BoardBytesPerCell;
+	Cost.BlockBytes = NumCells * BytesPerBlock;
+	Cost.BlockSpawnSeconds = FMath::Max<int64>(NumCells - NumPooledBlocks, 0) * BlockSpawnSeconds;
+	return Cost;
+}
@@ -0,0 +1,84 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Minesweeper3DBoard.h"
+
+/** What setting up a board is expected to cost, worked out before anything is allocated or spawned */
+struct FMinesweeper3DBoardCost
+{
+	//Flat board arrays plus the scratch used to label openings, paid however the board is drawn
+	int64 BoardBytes = 0;
+
+	//Block actors, if it were drawn one block per cell
+	int64 BlockBytes = 0;
+	double BlockSpawnSeconds = 0.0;
+};
+
+/**
+ * Holds the frame time to a budget by turning visual quality down when the game or render thread runs over, and back up
+ * once there's room again. Everything it scales reads Quality, a single 0..1 factor, so one knob moves them all together.
+ * Game thread only. Frame times are the process's, so there's one governor per process, shared by every locally controlled
+ * grid (each PIE client has one) and reached through them.
+ */
+class FMinesweeper3DFrameGovernor
+{
+public:
+	FMinesweeper3DFrameGovernor();
+	~FMinesweeper3DFrameGovernor();
+
+	//The process's governor, made with this budget if no grid is holding one yet. It goes once the last grid lets go.
+	static TSharedRef<FMinesweeper3DFrameGovernor> Acquire(float InTargetFrameMs);
+
+	//Frame time to hold, in milliseconds
+	float TargetFrameMs = 1000.f / 60.f;
+
+	//Quality never goes lower than this, so the board stays readable however slow the machine is
+	float MinQuality = 0.25f;
+
+	//Fired when Quality steps, so anything caching a scaled value can pick it up
+	FSimpleMulticastDelegate OnQualityChanged;
+
+	float GetQuality() const { return Quality; }
+	float GetGameThreadMs() const { return GameThreadMs; }
+	float GetRenderThreadMs() const { return RenderThreadMs; }
+
+	//Scaled settings. Each keeps at least one of whatever it counts so nothing stops entirely.
+	float ScaleDistance(float Distance) const { return Distance * Quality; }
+	int32 ScaleCount(int32 Count) const { return FMath::Max(FMath::RoundToInt(Count * Quality), 1); }
+	int32 GetMaxChunkBuildsInFlight() const { return ScaleCount(MaxChunkBuildsInFlight); }
+
+	//Hover traces are skipped on all but every Nth frame once quality drops
+	int32 GetHoverTraceInterval() const { return FMath::Clamp(FMath::RoundToInt(1.f / Quality), 1, 4); }
+
+	//Block spawns are timed as they happen, so the estimate below is for this machine
+	void RecordBlockSpawn(double Seconds);
+
+	//Cost of a board of this shape, with NumPooledBlocks already spawned and waiting to be reused
+	FMinesweeper3DBoardCost EstimateBoardCost(const FMinesweeper3DBoardShape& Shape, int32 NumPooledBlocks) const;
+
+private:
+	void OnEndFrame();
+	void SetQuality(float NewQuality);
+
+	static TWeakPtr<FMinesweeper3DFrameGovernor> Instance;
+
+	float Quality = 1.f;
+
+	//Smoothed thread times for the last frames
+	float GameThreadMs = 0.f;
+	float RenderThreadMs = 0.f;
+
+	//Seconds the frame has been over (or comfortably under) budget, reset by every step so steps are spaced out
+	float OverBudgetSeconds = 0.f;
+	float UnderBudgetSeconds = 0.f;
+
+	//At full quality, two builds per core
+	int32 MaxChunkBuildsInFlight = 2;
+
+	//Smoothed time to spawn one block actor, seeded with a guess until the first real spawn
+	double BlockSpawnSeconds = 50e-6;
+
+	FDelegateHandle EndFrameHandle;
+};
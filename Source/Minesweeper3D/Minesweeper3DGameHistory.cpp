@@ -0,0 +1,244 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DGameHistory.h"
+#include "Minesweeper3D.h"
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Misc/Paths.h"
+#include "Algo/BinarySearch.h"
+
+namespace
+{
+	constexpr uint32 HistoryMagic = 0x4D334448;	//"M3DH"
+	constexpr uint32 HistoryVersion = 2;
+}
+
+FArchive& operator<<(FArchive& Ar, FMinesweeper3DGameRecord& Record)
+{
+	//Written field by field so every record is the same size on disk
+	uint8 bWon = Record.bWon ? 1 : 0;
+	Ar << Record.Shape << Record.NumMines << Record.Seed << Record.Time << bWon << Record.Clicks << Record.ThreeBV << Record.Date;
+	Record.bWon = bWon != 0;
+	return Ar;
+}
+
+FMinesweeper3DGameHistory::FMinesweeper3DGameHistory(const FString& InPath)
+	: Path(InPath)
+{
+	Load();
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("Minesweeper3DGameHistory"), 0, TPri_BelowNormal);
+}
+
+FMinesweeper3DGameHistory::~FMinesweeper3DGameHistory()
+{
+	//Kill runs Stop() and waits, and the writer flushes anything still queued on its way out
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+FString FMinesweeper3DGameHistory::GetDefaultPath()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Minesweeper3D") / TEXT("History.bin");
+}
+
+TWeakPtr<FMinesweeper3DGameHistory> FMinesweeper3DGameHistory::Instance;
+
+TSharedRef<FMinesweeper3DGameHistory> FMinesweeper3DGameHistory::Acquire()
+{
+	check(IsInGameThread());
+
+	if (TSharedPtr<FMinesweeper3DGameHistory> Existing = Instance.Pin())	return Existing.ToSharedRef();
+
+	//The last one to let go has already joined its writer, so the file is complete by the time it's loaded again
+	TSharedRef<FMinesweeper3DGameHistory> NewHistory = MakeShared<FMinesweeper3DGameHistory>(GetDefaultPath());
+	Instance = NewHistory;
+	return NewHistory;
+}
+
+void FMinesweeper3DGameHistory::Load()
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+	if (!Reader)
+	{
+		bRewriteFile = true;
+		return;
+	}
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	*Reader << Magic << Version;
+	if (Reader->IsError() || Magic != HistoryMagic || Version != HistoryVersion)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Game history %s isn't a version %u history file, starting a new one"), *Path, HistoryVersion);
+		Reader.Reset();
+		IFileManager::Get().Move(*(Path + TEXT(".bad")), *Path);
+		bRewriteFile = true;
+		return;
+	}
+
+	const int64 TotalSize = Reader->TotalSize();
+	FMinesweeper3DGameRecord Record;
+	int64 RecordSize = 0;
+	while (Reader->Tell() < TotalSize)
+	{
+		const int64 Start = Reader->Tell();
+		if (RecordSize > 0 && Start + RecordSize > TotalSize)	break;
+
+		*Reader << Record;
+		if (Reader->IsError())	break;
+
+		RecordSize = Reader->Tell() - Start;
+		Records.Add(Record);
+	}
+
+	if (Reader->Tell() != TotalSize)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Game history %s ends in a partial record, dropping it"), *Path);
+		bRewriteFile = true;
+		PendingRewrite = Records;
+	}
+
+	//Build the indexes unsorted and sort each once, rather than paying an insertion per record
+	for (int32 i = 0; i < Records.Num(); i++)
+	{
+		FBoardIndex& Index = ByBoard.FindOrAdd(FBoardKey{ Records[i].Shape, Records[i].NumMines });
+		Index.NumGames++;
+		if (Records[i].bWon)	Index.Wins.Add({ Records[i].Time, i });
+	}
+	for (TPair<FBoardKey, FBoardIndex>& Pair : ByBoard)
+	{
+		Pair.Value.Wins.Sort();
+	}
+
+	UE_LOG(LogMinesweeper3D, Log, TEXT("Loaded %d games from %s"), Records.Num(), *Path);
+}
+
+void FMinesweeper3DGameHistory::Add(const FMinesweeper3DGameRecord& Record)
+{
+	const int32 RecordIndex = Records.Add(Record);
+	IndexRecord(RecordIndex);
+
+	PendingWrites.Enqueue(Record);
+	WakeEvent->Trigger();
+}
+
+void FMinesweeper3DGameHistory::IndexRecord(int32 RecordIndex)
+{
+	const FMinesweeper3DGameRecord& Record = Records[RecordIndex];
+	FBoardIndex& Index = ByBoard.FindOrAdd(FBoardKey{ Record.Shape, Record.NumMines });
+	Index.NumGames++;
+
+	if (Record.bWon)
+	{
+		const FTimeEntry Entry = { Record.Time, RecordIndex };
+		Index.Wins.Insert(Entry, Algo::UpperBound(Index.Wins, Entry));
+	}
+}
+
+/*---------- Queries ----------*/
+
+int32 FMinesweeper3DGameHistory::GetNumGames(const FMinesweeper3DBoardShape& Shape, int32 NumMines) const
+{
+	const FBoardIndex* Index = ByBoard.Find(FBoardKey{ Shape, NumMines });
+	return Index ? Index->NumGames : 0;
+}
+
+int32 FMinesweeper3DGameHistory::GetNumWins(const FMinesweeper3DBoardShape& Shape, int32 NumMines) const
+{
+	const FBoardIndex* Index = ByBoard.Find(FBoardKey{ Shape, NumMines });
+	return Index ? Index->Wins.Num() : 0;
+}
+
+bool FMinesweeper3DGameHistory::GetBestTime(const FMinesweeper3DBoardShape& Shape, int32 NumMines, FMinesweeper3DGameRecord& OutRecord) const
+{
+	const FBoardIndex* Index = ByBoard.Find(FBoardKey{ Shape, NumMines });
+	if (!Index || Index->Wins.Num() == 0)	return false;
+
+	OutRecord = Records[Index->Wins[0].Record];
+	return true;
+}
+
+float FMinesweeper3DGameHistory::GetTimePercentile(const FMinesweeper3DBoardShape& Shape, int32 NumMines, float Time) const
+{
+	const FBoardIndex* Index = ByBoard.Find(FBoardKey{ Shape, NumMines });
+	if (!Index || Index->Wins.Num() == 0)	return 0.f;
+
+	const int32 NumFaster = Algo::LowerBoundBy(Index->Wins, Time, &FTimeEntry::Time);
+	return (float)NumFaster / Index->Wins.Num();
+}
+
+bool FMinesweeper3DGameHistory::GetTimeAtPercentile(const FMinesweeper3DBoardShape& Shape, int32 NumMines, float Percentile, float& OutTime) const
+{
+	const FBoardIndex* Index = ByBoard.Find(FBoardKey{ Shape, NumMines });
+	if (!Index || Index->Wins.Num() == 0)	return false;
+
+	const int32 Rank = FMath::Clamp(FMath::FloorToInt(Percentile * (Index->Wins.Num() - 1)), 0, Index->Wins.Num() - 1);
+	OutTime = Index->Wins[Rank].Time;
+	return true;
+}
+
+int32 FMinesweeper3DGameHistory::GetNumGamesSince(const FDateTime& Date) const
+{
+	return Records.Num() - Algo::LowerBoundBy(Records, Date, [](const FMinesweeper3DGameRecord& Record) { return Record.Date; });
+}
+
+/*---------- Writer thread ----------*/
+
+uint32 FMinesweeper3DGameHistory::Run()
+{
+	while (!bStopping)
+	{
+		WakeEvent->Wait();
+		WritePending();
+	}
+
+	WritePending();
+	return 0;
+}
+
+void FMinesweeper3DGameHistory::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FMinesweeper3DGameHistory::WritePending()
+{
+	if (PendingWrites.IsEmpty() && !bRewriteFile)	return;
+
+	//Everything queued since the last wake goes out in one open/append/close
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path, bRewriteFile ? 0 : FILEWRITE_Append));
+	if (!Writer)
+	{
+		//Leave the records queued, the next game to finish will try again
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't open game history %s for writing"), *Path);
+		return;
+	}
+
+	if (bRewriteFile)
+	{
+		uint32 Magic = HistoryMagic;
+		uint32 Version = HistoryVersion;
+		*Writer << Magic << Version;
+		for (FMinesweeper3DGameRecord& Record : PendingRewrite)
+		{
+			*Writer << Record;
+		}
+		PendingRewrite.Empty();
+		bRewriteFile = false;
+	}
+
+	FMinesweeper3DGameRecord Record;
+	while (PendingWrites.Dequeue(Record))
+	{
+		*Writer << Record;
+	}
+	Writer->Close();
+}
@@ -0,0 +1,141 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Containers/Queue.h"
+#include "Minesweeper3DBoard.h"
+#include "Minesweeper3DGameHistory.generated.h"
+
+/** One finished game, as stored in the history file */
+USTRUCT(BlueprintType)
+struct FMinesweeper3DGameRecord
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FMinesweeper3DBoardShape Shape;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 NumMines = 0;
+
+	//Mine layout seed. Together with the first click this regenerates the board.
+	UPROPERTY(BlueprintReadOnly)
+	int32 Seed = 0;
+
+	//Seconds from the first click to the game ending
+	UPROPERTY(BlueprintReadOnly)
+	float Time = 0.f;
+
+	UPROPERTY(BlueprintReadOnly)
+	bool bWon = false;
+
+	//Reveals and flags the server accepted
+	UPROPERTY(BlueprintReadOnly)
+	int32 Clicks = 0;
+
+	//Minimum number of clicks needed to clear the board without flagging
+	UPROPERTY(BlueprintReadOnly)
+	int32 ThreeBV = 0;
+
+	//When the game finished, UTC
+	UPROPERTY(BlueprintReadOnly)
+	FDateTime Date;
+
+	friend FArchive& operator<<(FArchive& Ar, FMinesweeper3DGameRecord& Record);
+};
+
+/**
+ * Append-only store of every finished game on this machine.
+ * Records stay in memory in the order they were played, with a per board index of wins sorted by time, so best time and
+ * percentile queries are a binary search. Only the game thread touches the records and indexes; appending to the
+ * file happens on a writer thread so finishing a game never waits on disk. A second store on the same file would write
+ * over this one's records and never see them, so the game shares one per process through Acquire().
+ */
+class FMinesweeper3DGameHistory : public FRunnable
+{
+public:
+	explicit FMinesweeper3DGameHistory(const FString& InPath);
+	virtual ~FMinesweeper3DGameHistory();
+
+	//Default location, under the project's Saved directory
+	static FString GetDefaultPath();
+
+	//The process's store on the default path, loaded if nothing is holding one yet. It goes once the last holder lets go.
+	static TSharedRef<FMinesweeper3DGameHistory> Acquire();
+
+	void Add(const FMinesweeper3DGameRecord& Record);
+
+	int32 Num() const { return Records.Num(); }
+	const FMinesweeper3DGameRecord& operator[](int32 Index) const { return Records[Index]; }
+
+	int32 GetNumGames(const FMinesweeper3DBoardShape& Shape, int32 NumMines) const;
+	int32 GetNumWins(const FMinesweeper3DBoardShape& Shape, int32 NumMines) const;
+
+	//Fastest win on this board. Returns false if it's never been won.
+	bool GetBestTime(const FMinesweeper3DBoardShape& Shape, int32 NumMines, FMinesweeper3DGameRecord& OutRecord) const;
+
+	//Fraction of wins on this board that were faster than Time, 0 for a new best
+	float GetTimePercentile(const FMinesweeper3DBoardShape& Shape, int32 NumMines, float Time) const;
+
+	//Time of the win at this fraction of the way through the sorted wins, 0.5 is the median. Returns false if it's never been won.
+	bool GetTimeAtPercentile(const FMinesweeper3DBoardShape& Shape, int32 NumMines, float Percentile, float& OutTime) const;
+
+	//Records are appended as games finish, so their dates are already in order
+	int32 GetNumGamesSince(const FDateTime& Date) const;
+
+	// Begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	// End FRunnable interface
+
+private:
+	struct FTimeEntry
+	{
+		float Time;
+		int32 Record;
+
+		bool operator<(const FTimeEntry& Other) const { return Time < Other.Time || (Time == Other.Time && Record < Other.Record); }
+	};
+
+	struct FBoardIndex
+	{
+		int32 NumGames = 0;
+		//Wins on this board, sorted fastest first
+		TArray<FTimeEntry> Wins;
+	};
+
+	struct FBoardKey
+	{
+		FMinesweeper3DBoardShape Shape;
+		int32 NumMines;
+
+		bool operator==(const FBoardKey& Other) const { return Shape == Other.Shape && NumMines == Other.NumMines; }
+		friend uint32 GetTypeHash(const FBoardKey& Key) { return HashCombine(GetTypeHash(Key.Shape), GetTypeHash(Key.NumMines)); }
+	};
+
+	void Load();
+	void IndexRecord(int32 RecordIndex);
+	void WritePending();
+
+	static TWeakPtr<FMinesweeper3DGameHistory> Instance;
+
+	FString Path;
+
+	TArray<FMinesweeper3DGameRecord> Records;
+	TMap<FBoardKey, FBoardIndex> ByBoard;
+
+	//Game thread in, writer thread out
+	TQueue<FMinesweeper3DGameRecord, EQueueMode::Spsc> PendingWrites;
+
+	//Set by Load() when the file is missing, unreadable or ends in a partial record (a crash mid-write), so the writer
+	//starts it again from PendingRewrite before appending. Only the writer thread touches these once it's started.
+	bool bRewriteFile = false;
+	TArray<FMinesweeper3DGameRecord> PendingRewrite;
+
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+	FThreadSafeBool bStopping;
+};
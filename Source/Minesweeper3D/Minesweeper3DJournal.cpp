@@ -0,0 +1,465 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DJournal.h"
+#include "Minesweeper3D.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Misc/Paths.h"
+#include "Misc/Crc.h"
+#include "Misc/Guid.h"
+#include "Serialization/BitWriter.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Journal commits"), STAT_JournalCommits, STATGROUP_Minesweeper3D);
+DECLARE_CYCLE_STAT(TEXT("Journal append"), STAT_JournalAppend, STATGROUP_Minesweeper3D);
+
+namespace
+{
+	constexpr uint32 JournalMagic = 0x4D33444A;	//"M3DJ"
+	constexpr uint32 CheckpointMagic = 0x4D334443;	//"M3DC"
+	constexpr uint32 JournalVersion = 1;
+
+	//Records queued within this long of the last commit wait for the next one, so a burst shares a flush
+	constexpr double CommitInterval = 0.05;
+
+	//A checkpoint every this many records keeps replay short and the journal small
+	constexpr int32 RecordsPerCheckpoint = 256;
+
+	/** Start of the journal file. BaseSeq is the checkpoint the records carry on from, 0 for the start of the game. */
+	struct FJournalHeader
+	{
+		uint32 Magic = JournalMagic;
+		uint32 Version = JournalVersion;
+		FGuid GameId;
+		uint32 BaseSeq = 0;
+		FMinesweeper3DJournalGame Game;
+
+		friend FArchive& operator<<(FArchive& Ar, FJournalHeader& Header)
+		{
+			Ar << Header.Magic << Header.Version;
+			if (Ar.IsError() || Header.Magic != JournalMagic || Header.Version != JournalVersion)
+			{
+				Ar.SetError();
+				return Ar;
+			}
+			return Ar << Header.GameId << Header.BaseSeq << Header.Game;
+		}
+	};
+
+	/** Fixed part of a record. The delta follows as NumBits of NetSerialize output, and Crc covers both. */
+	struct FRecordHeader
+	{
+		uint32 Seq = 0;
+		float Time = 0.f;
+		int32 Clicks = 0;
+		uint32 NumBits = 0;
+		uint32 Crc = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FRecordHeader& Header)
+		{
+			return Ar << Header.Seq << Header.Time << Header.Clicks << Header.NumBits << Header.Crc;
+		}
+
+		uint32 CalcCrc(const uint8* Data) const
+		{
+			uint32 Result = FCrc::MemCrc32(&Seq, sizeof(Seq));
+			Result = FCrc::MemCrc32(&Time, sizeof(Time), Result);
+			Result = FCrc::MemCrc32(&Clicks, sizeof(Clicks), Result);
+			Result = FCrc::MemCrc32(&NumBits, sizeof(NumBits), Result);
+			return FCrc::MemCrc32(Data, (NumBits + 7) / 8, Result);
+		}
+	};
+
+	bool ReadHeader(const FString& Path, FJournalHeader& OutHeader, TUniquePtr<FArchive>* OutReader = nullptr)
+	{
+		TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+		if (!Reader)	return false;
+
+		*Reader << OutHeader;
+		if (Reader->IsError())	return false;
+
+		if (OutReader)	*OutReader = MoveTemp(Reader);
+		return true;
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FMinesweeper3DJournalGame& Game)
+{
+	FMinesweeper3DDensity& Density = Game.Density;
+	uint8 DensityShape = (uint8)Density.Shape;
+	uint8 bPracticeMode = Game.bPracticeMode ? 1 : 0;
+
+	Ar << Game.Shape << Game.NumMines << Game.Seed << Game.FirstClick << bPracticeMode << Game.PuzzlePack << Game.PuzzleIndex;
+	Ar << DensityShape << Density.Contrast << Density.GradientAxis << Density.PaintedDims << Density.Painted;
+
+	Game.bPracticeMode = bPracticeMode != 0;
+	Density.Shape = (EMinesweeper3DDensityShape)DensityShape;
+	if (Ar.IsLoading() && !Density.IsValid())	Ar.SetError();
+	return Ar;
+}
+
+FMinesweeper3DJournal::FMinesweeper3DJournal(const FString& InDirectory)
+	: JournalPath(InDirectory / TEXT("Resume.journal"))
+	, CheckpointPath(InDirectory / TEXT("Resume.checkpoint"))
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("Minesweeper3DJournal"), 0, TPri_BelowNormal);
+}
+
+FMinesweeper3DJournal::~FMinesweeper3DJournal()
+{
+	//Kill runs Stop() and waits, and the writer commits anything still queued on its way out. The files are kept,
+	//quitting mid-game can be resumed the same as a crash can.
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+}
+
+FString FMinesweeper3DJournal::GetDefaultDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Minesweeper3D");
+}
+
+/*---------- Game thread ----------*/
+
+void FMinesweeper3DJournal::Enqueue(FItem&& Item)
+{
+	PendingItems.Enqueue(MoveTemp(Item));
+	WakeEvent->Trigger();
+}
+
+void FMinesweeper3DJournal::BeginGame(const FMinesweeper3DJournalGame& Game, bool bFromCheckpoint)
+{
+	bRecording = true;
+	NextSeq = 1;
+	RecordsSinceCheckpoint = 0;
+
+	//The journal says from the start that it carries on from the first checkpoint, so it's never replayed without it
+	FItem Item;
+	Item.Kind = EItemKind::Begin;
+	Item.Seq = bFromCheckpoint ? NextSeq : 0;
+	Item.Game = Game;
+	Enqueue(MoveTemp(Item));
+}
+
+void FMinesweeper3DJournal::Append(const FMinesweeper3DBoardDelta& Delta, const FMinesweeper3DBoard& Board, float Time, int32 Clicks)
+{
+	if (!bRecording || Delta.IsEmpty())	return;
+
+	SCOPE_CYCLE_COUNTER(STAT_JournalAppend);
+
+	//Only copied here, the writer packs it
+	FItem Item;
+	Item.Kind = EItemKind::Record;
+	Item.Seq = NextSeq++;
+	Item.Time = Time;
+	Item.Clicks = Clicks;
+	Item.Delta = Delta;
+	Enqueue(MoveTemp(Item));
+
+	if (++RecordsSinceCheckpoint >= RecordsPerCheckpoint)	Checkpoint(Board, Time, Clicks);
+}
+
+void FMinesweeper3DJournal::Checkpoint(const FMinesweeper3DBoard& Board, float Time, int32 Clicks)
+{
+	if (!bRecording)	return;
+
+	//The snapshot only references the board's pages, the writer reads them while the game carries on. It takes a sequence
+	//number of its own, so no checkpoint is ever numbered 0, the start of the game.
+	FItem Item;
+	Item.Kind = EItemKind::Checkpoint;
+	Item.Seq = NextSeq++;
+	Item.Time = Time;
+	Item.Clicks = Clicks;
+	Item.Snapshot = Board.TakeSnapshot();
+	Enqueue(MoveTemp(Item));
+	RecordsSinceCheckpoint = 0;
+}
+
+void FMinesweeper3DJournal::EndGame()
+{
+	if (!bRecording)	return;
+	bRecording = false;
+
+	FItem Item;
+	Item.Kind = EItemKind::End;
+	Enqueue(MoveTemp(Item));
+}
+
+bool FMinesweeper3DJournal::CanResume() const
+{
+	FJournalHeader Header;
+	return !bRecording && ReadHeader(JournalPath, Header);
+}
+
+bool FMinesweeper3DJournal::ReadResume(FMinesweeper3DJournalResume& OutResume) const
+{
+	if (bRecording)	return false;
+
+	FJournalHeader Header;
+	TUniquePtr<FArchive> Reader;
+	if (!ReadHeader(JournalPath, Header, &Reader))	return false;
+
+	OutResume.Game = Header.Game;
+	uint32 ResumeSeq = 0;
+
+	//The checkpoint has to be this game's, and no older than the one the journal carries on from. It can be newer if
+	//the game stopped between the checkpoint landing and the journal starting again, the records it covers are skipped.
+	TUniquePtr<FArchive> CheckpointReader(IFileManager::Get().CreateFileReader(*CheckpointPath));
+	if (CheckpointReader)
+	{
+		FArchive& Ar = *CheckpointReader;
+		uint32 Magic = 0, Version = 0, Seq = 0;
+		FGuid GameId;
+		int32 NumCells = 0;
+		Ar << Magic << Version << GameId << Seq;
+
+		if (!Ar.IsError() && Magic == CheckpointMagic && Version == JournalVersion && GameId == Header.GameId && Seq >= Header.BaseSeq)
+		{
+			FMinesweeper3DBoardSnapshot& Snapshot = OutResume.Checkpoint;
+			Ar << OutResume.Time << OutResume.Clicks << Snapshot.NumFlags << Snapshot.BlocksRemaining << NumCells;
+			if (!Ar.IsError() && NumCells == Header.Game.Shape.Num())
+			{
+				//Runs of one state, as the writer compacted them
+				Snapshot.States.Init(EMinesweeper3DCellState::Hidden, NumCells);
+				int32 Index = 0;
+				while (Index < NumCells && !Ar.IsError())
+				{
+					uint8 State = 0;
+					uint32 Length = 0;
+					Ar << State;
+					Ar.SerializeIntPacked(Length);
+					if (State > (uint8)EMinesweeper3DCellState::Flagged || Length > (uint32)(NumCells - Index))	Ar.SetError();
+					if (Ar.IsError())	break;
+
+					for (const int32 End = Index + (int32)Length; Index < End; Index++)
+					{
+						if (State != (uint8)EMinesweeper3DCellState::Hidden)	Snapshot.States.Set(Index, (EMinesweeper3DCellState)State);
+					}
+				}
+				OutResume.bHasCheckpoint = !Ar.IsError() && Index == NumCells;
+				ResumeSeq = Seq;
+			}
+		}
+	}
+
+	if (Header.BaseSeq > 0 && !OutResume.bHasCheckpoint)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Journal %s carries on from a checkpoint that's missing, it can't be resumed"), *JournalPath);
+		return false;
+	}
+	if (!OutResume.bHasCheckpoint)	ResumeSeq = 0;
+
+	//Records until the end of the file or the first one that's torn, which is where the game stopped
+	FArchive& Ar = *Reader;
+	const int64 TotalSize = Ar.TotalSize();
+	TArray<uint8> Data;
+	while (Ar.Tell() < TotalSize)
+	{
+		FRecordHeader Record;
+		Ar << Record;
+		const int64 NumBytes = (Record.NumBits + 7) / 8;
+		if (Ar.IsError() || Ar.Tell() + NumBytes > TotalSize)	break;
+
+		Data.SetNumUninitialized(NumBytes);
+		Ar.Serialize(Data.GetData(), NumBytes);
+		if (Ar.IsError() || Record.CalcCrc(Data.GetData()) != Record.Crc)	break;
+		if (Record.Seq <= ResumeSeq)	continue;
+
+		FBitReader BitReader(Data.GetData(), Record.NumBits);
+		bool bSuccess = false;
+		FMinesweeper3DBoardDelta& Delta = OutResume.Deltas.AddDefaulted_GetRef();
+		Delta.NetSerialize(BitReader, nullptr, bSuccess);
+		if (!bSuccess)
+		{
+			OutResume.Deltas.Pop();
+			break;
+		}
+
+		OutResume.Time = Record.Time;
+		OutResume.Clicks = Record.Clicks;
+	}
+
+	UE_LOG(LogMinesweeper3D, Log, TEXT("Read an interrupted game from %s: %s checkpoint and %d changes"), *JournalPath,
+		OutResume.bHasCheckpoint ? TEXT("a") : TEXT("no"), OutResume.Deltas.Num());
+	return true;
+}
+
+/*---------- Writer thread ----------*/
+
+uint32 FMinesweeper3DJournal::Run()
+{
+	while (!bStopping)
+	{
+		WakeEvent->Wait();
+
+		//Group commit: whatever else gets queued while this waits out the interval goes out in the same write and flush
+		const double SinceCommit = FPlatformTime::Seconds() - LastCommitTime;
+		if (SinceCommit < CommitInterval && !bStopping)	FPlatformProcess::Sleep(CommitInterval - SinceCommit);
+		WritePending();
+	}
+
+	WritePending();
+	CloseJournal();
+	return 0;
+}
+
+void FMinesweeper3DJournal::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FMinesweeper3DJournal::WritePending()
+{
+	FItem Item;
+	while (PendingItems.Dequeue(Item))
+	{
+		switch (Item.Kind)
+		{
+		case EItemKind::Begin:
+		{
+			FJournalHeader Header;
+			Header.GameId = FGuid::NewGuid();
+			Header.BaseSeq = Item.Seq;
+			Header.Game = Item.Game;
+			FMemoryWriter Writer(JournalHeader);
+			JournalHeader.Reset();
+			Writer << Header;
+
+			CommitBuffer.Reset();
+			StartJournal();
+			IFileManager::Get().Delete(*CheckpointPath, false, false, true);
+			break;
+		}
+		case EItemKind::Record:
+		{
+			if (!JournalHandle)	break;
+
+			FBitWriter BitWriter(0, true);
+			bool bSuccess = true;
+			Item.Delta.NetSerialize(BitWriter, nullptr, bSuccess);
+
+			FRecordHeader Record;
+			Record.Seq = Item.Seq;
+			Record.Time = Item.Time;
+			Record.Clicks = Item.Clicks;
+			Record.NumBits = BitWriter.GetNumBits();
+			Record.Crc = Record.CalcCrc(BitWriter.GetData());
+
+			FMemoryWriter Writer(CommitBuffer);
+			Writer.Seek(CommitBuffer.Num());
+			Writer << Record;
+			Writer.Serialize(BitWriter.GetData(), BitWriter.GetNumBytes());
+			break;
+		}
+		case EItemKind::Checkpoint:
+			//Everything before the checkpoint goes to disk first, so a crash partway through still has it all in the journal
+			if (!JournalHandle)	break;
+			Commit();
+			WriteCheckpoint(Item);
+			break;
+
+		case EItemKind::End:
+			CommitBuffer.Reset();
+			CloseJournal();
+			JournalHeader.Reset();
+			IFileManager::Get().Delete(*JournalPath, false, false, true);
+			IFileManager::Get().Delete(*CheckpointPath, false, false, true);
+			break;
+		}
+	}
+
+	Commit();
+}
+
+void FMinesweeper3DJournal::Commit()
+{
+	if (JournalHandle && CommitBuffer.Num() > 0)
+	{
+		if (!JournalHandle->Write(CommitBuffer.GetData(), CommitBuffer.Num()) || !JournalHandle->Flush(true))
+		{
+			UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't write to journal %s, this game won't be resumable"), *JournalPath);
+			CloseJournal();
+		}
+		INC_DWORD_STAT(STAT_JournalCommits);
+	}
+	CommitBuffer.Reset();
+	LastCommitTime = FPlatformTime::Seconds();
+}
+
+//Opens the journal empty apart from its header
+void FMinesweeper3DJournal::StartJournal()
+{
+	CloseJournal();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(JournalPath));
+	JournalHandle = PlatformFile.OpenWrite(*JournalPath);
+	if (!JournalHandle || !JournalHandle->Write(JournalHeader.GetData(), JournalHeader.Num()) || !JournalHandle->Flush(true))
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't start journal %s, this game won't be resumable"), *JournalPath);
+		CloseJournal();
+	}
+}
+
+void FMinesweeper3DJournal::WriteCheckpoint(FItem& Item)
+{
+	FJournalHeader Header;
+	FMemoryReader HeaderReader(JournalHeader);
+	HeaderReader << Header;
+
+	//States compacted to runs, most of a board is long stretches of hidden or revealed cells
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	uint32 Magic = CheckpointMagic;
+	uint32 Version = JournalVersion;
+	const FMinesweeper3DCellStates& States = Item.Snapshot.States;
+	int32 NumCells = States.Num();
+	Writer << Magic << Version << Header.GameId << Item.Seq << Item.Time << Item.Clicks << Item.Snapshot.NumFlags << Item.Snapshot.BlocksRemaining << NumCells;
+	for (int32 Start = 0; Start < NumCells;)
+	{
+		const EMinesweeper3DCellState State = States[Start];
+		int32 End = Start + 1;
+		while (End < NumCells && States[End] == State)	End++;
+
+		uint8 StateByte = (uint8)State;
+		uint32 Length = End - Start;
+		Writer << StateByte;
+		Writer.SerializeIntPacked(Length);
+		Start = End;
+	}
+
+	//Written beside the old one and moved over it, so there's always one whole checkpoint on disk
+	const FString TempPath = CheckpointPath + TEXT(".tmp");
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IFileHandle> Handle(PlatformFile.OpenWrite(*TempPath));
+	const bool bWritten = Handle && Handle->Write(Data.GetData(), Data.Num()) && Handle->Flush(true);
+	Handle.Reset();
+	if (!bWritten || !IFileManager::Get().Move(*CheckpointPath, *TempPath, true, true))
+	{
+		//The journal still has everything, it just keeps growing until the next checkpoint works
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't write checkpoint %s"), *CheckpointPath);
+		return;
+	}
+
+	//The journal starts again from the checkpoint
+	Header.BaseSeq = Item.Seq;
+	JournalHeader.Reset();
+	FMemoryWriter HeaderWriter(JournalHeader);
+	HeaderWriter << Header;
+	StartJournal();
+}
+
+void FMinesweeper3DJournal::CloseJournal()
+{
+	delete JournalHandle;
+	JournalHandle = nullptr;
+}
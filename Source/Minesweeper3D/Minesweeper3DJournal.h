@@ -0,0 +1,138 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Containers/Queue.h"
+#include "Minesweeper3DBoard.h"
+
+class IFileHandle;
+
+/** What it takes to set the board of a journaled game up again before its moves are replayed */
+struct FMinesweeper3DJournalGame
+{
+	FMinesweeper3DBoardShape Shape;
+	int32 NumMines = 0;
+	//Generated boards come back from their seed, density and first click
+	int32 Seed = 0;
+	int32 FirstClick = INDEX_NONE;
+	FMinesweeper3DDensity Density;
+	bool bPracticeMode = false;
+	//Puzzles come back from their pack instead, when PuzzleIndex is set
+	FString PuzzlePack;
+	int32 PuzzleIndex = INDEX_NONE;
+
+	friend FArchive& operator<<(FArchive& Ar, FMinesweeper3DJournalGame& Game);
+};
+
+/** Everything needed to put an interrupted game back where it was */
+struct FMinesweeper3DJournalResume
+{
+	FMinesweeper3DJournalGame Game;
+
+	//The last checkpoint, if one was taken
+	bool bHasCheckpoint = false;
+	FMinesweeper3DBoardSnapshot Checkpoint;
+
+	//Board changes since the checkpoint, in the order they were made
+	TArray<FMinesweeper3DBoardDelta> Deltas;
+
+	//Seconds played and clicks made by the last change
+	float Time = 0.f;
+	int32 Clicks = 0;
+};
+
+/**
+ * Write-ahead journal of the game in progress, so a crash or a kill loses at most the last commit interval.
+ * Every board delta the authority sends is appended as a small record. A writer thread commits whatever has queued up
+ * since its last pass with one write and one flush to disk, so a burst of clicks costs one flush, and the game thread
+ * only ever queues. Every so often the board itself is checkpointed: the snapshot shares its pages with the live board,
+ * so taking it is cheap, and the writer compacts it to runs, replaces the old checkpoint and starts the journal again.
+ */
+class FMinesweeper3DJournal : public FRunnable
+{
+public:
+	explicit FMinesweeper3DJournal(const FString& InDirectory);
+	virtual ~FMinesweeper3DJournal();
+
+	//Default location, under the project's Saved directory
+	static FString GetDefaultDirectory();
+
+	//Starts journaling a new game, dropping whatever was there. A game picked up from a checkpoint doesn't start from
+	//its seed, so it can't be resumed until the first Checkpoint() lands, which has to come before anything is appended.
+	void BeginGame(const FMinesweeper3DJournalGame& Game, bool bFromCheckpoint = false);
+
+	//Queues a change that's already been made to Board. Ignored unless a game is being journaled.
+	void Append(const FMinesweeper3DBoardDelta& Delta, const FMinesweeper3DBoard& Board, float Time, int32 Clicks);
+
+	//Queues a checkpoint of Board as it is now
+	void Checkpoint(const FMinesweeper3DBoard& Board, float Time, int32 Clicks);
+
+	//The game finished or was abandoned, so there's nothing to resume any more
+	void EndGame();
+
+	FORCEINLINE bool IsRecording() const { return bRecording; }
+
+	//Whether there's an interrupted game on disk. Only reads the journal's header.
+	bool CanResume() const;
+
+	//Reads the interrupted game back, dropping a torn record at the end of the journal. Only while nothing is being recorded.
+	bool ReadResume(FMinesweeper3DJournalResume& OutResume) const;
+
+	// Begin FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	// End FRunnable interface
+
+private:
+	enum class EItemKind : uint8
+	{
+		Begin,
+		Record,
+		Checkpoint,
+		End
+	};
+
+	struct FItem
+	{
+		EItemKind Kind = EItemKind::Record;
+		uint32 Seq = 0;
+		float Time = 0.f;
+		int32 Clicks = 0;
+		FMinesweeper3DBoardDelta Delta;
+		FMinesweeper3DBoardSnapshot Snapshot;
+		FMinesweeper3DJournalGame Game;
+	};
+
+	void Enqueue(FItem&& Item);
+
+	//Writer thread
+	void WritePending();
+	void Commit();
+	void StartJournal();
+	void WriteCheckpoint(FItem& Item);
+	void CloseJournal();
+
+	FString JournalPath;
+	FString CheckpointPath;
+
+	//Game thread only
+	bool bRecording = false;
+	uint32 NextSeq = 0;
+	int32 RecordsSinceCheckpoint = 0;
+
+	//Game thread in, writer thread out
+	TQueue<FItem, EQueueMode::Spsc> PendingItems;
+
+	//Writer thread only. Records are gathered into CommitBuffer and go out together.
+	IFileHandle* JournalHandle = nullptr;
+	TArray<uint8> JournalHeader;
+	TArray<uint8> CommitBuffer;
+	double LastCommitTime = 0.0;
+
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+	FThreadSafeBool bStopping;
+};
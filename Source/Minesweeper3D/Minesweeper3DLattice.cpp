@@ -0,0 +1,195 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DLattice.h"
+#include "Minesweeper3D.h"
+#include "HAL/IConsoleManager.h"
+
+#if !UE_BUILD_SHIPPING
+
+/*---------- Kernel benchmark ----------*/
+
+namespace
+{
+	/** The bounded 3D kernel as the board had it written out by hand, kept to check the generic one against */
+	struct FHandWritten3D
+	{
+		int32 Dims[3];
+		TArray<int32> AxisPrev[3];
+		TArray<int32> AxisNext[3];
+		int32 NeighbourOffsets[26];
+
+		void Init(const int32 (&InDims)[3])
+		{
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Dims[Axis] = InDims[Axis];
+				AxisPrev[Axis].SetNumUninitialized(Dims[Axis]);
+				AxisNext[Axis].SetNumUninitialized(Dims[Axis]);
+				for (int32 Pos = 0; Pos < Dims[Axis]; Pos++)
+				{
+					AxisPrev[Axis][Pos] = Pos > 0 ? Pos - 1 : INDEX_NONE;
+					AxisNext[Axis][Pos] = Pos < Dims[Axis] - 1 ? Pos + 1 : INDEX_NONE;
+				}
+			}
+
+			int32 NumOffsets = 0;
+			for (int32 x = -1; x < 2; x++)
+			{
+				for (int32 y = -1; y < 2; y++)
+				{
+					for (int32 z = -1; z < 2; z++)
+					{
+						if (x == 0 && y == 0 && z == 0)	continue;
+						NeighbourOffsets[NumOffsets++] = (x * Dims[1] + y) * Dims[2] + z;
+					}
+				}
+			}
+		}
+
+		template<bool bWrapped, typename FuncType>
+		FORCEINLINE void ForEachNeighbour(int32 Index, FuncType&& Func) const
+		{
+			int32 Pos[3];
+			Pos[2] = Index % Dims[2];
+			Pos[1] = (Index / Dims[2]) % Dims[1];
+			Pos[0] = Index / (Dims[1] * Dims[2]);
+
+			if (Pos[0] > 0 && Pos[0] < Dims[0] - 1 && Pos[1] > 0 && Pos[1] < Dims[1] - 1 && Pos[2] > 0 && Pos[2] < Dims[2] - 1)
+			{
+				for (int32 Offset : NeighbourOffsets)
+				{
+					Func(Index + Offset);
+				}
+				return;
+			}
+
+			int32 Coords[3][3];
+			int32 NumCoords[3];
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				NumCoords[Axis] = 0;
+				Coords[Axis][NumCoords[Axis]++] = Pos[Axis];
+				if (AxisPrev[Axis][Pos[Axis]] != INDEX_NONE)	Coords[Axis][NumCoords[Axis]++] = AxisPrev[Axis][Pos[Axis]];
+				if (AxisNext[Axis][Pos[Axis]] != INDEX_NONE)	Coords[Axis][NumCoords[Axis]++] = AxisNext[Axis][Pos[Axis]];
+			}
+
+			for (int32 x = 0; x < NumCoords[0]; x++)
+			{
+				for (int32 y = 0; y < NumCoords[1]; y++)
+				{
+					for (int32 z = 0; z < NumCoords[2]; z++)
+					{
+						if (x == 0 && y == 0 && z == 0)	continue;
+						Func((Coords[0][x] * Dims[1] + Coords[1][y]) * Dims[2] + Coords[2][z]);
+					}
+				}
+			}
+		}
+	};
+
+	//Best of a few runs, in milliseconds
+	template<typename FuncType>
+	double TimeKernel(FuncType&& Func)
+	{
+		double Best = DBL_MAX;
+		for (int32 Run = 0; Run < 3; Run++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Func();
+			Best = FMath::Min(Best, FPlatformTime::Seconds() - StartTime);
+		}
+		return Best * 1000.0;
+	}
+
+	//Counts every cell then floods from the middle, the two passes that lean hardest on the kernel
+	template<typename KernelType>
+	void BenchmarkKernel(const TCHAR* Name, const KernelType& Kernel, int32 NumCells)
+	{
+		TArray<uint8> Mines, Revealed;
+		TArray<int8> Counts;
+		Mines.SetNumUninitialized(NumCells);
+		Counts.SetNumUninitialized(NumCells);
+		Revealed.SetNumUninitialized(NumCells);
+
+		FRandomStream Stream(1);
+		for (int32 Index = 0; Index < NumCells; Index++)
+		{
+			Mines[Index] = Stream.FRand() < 0.01f ? 1 : 0;
+		}
+
+		int64 NumVisits = 0;
+		const double CountMs = TimeKernel([&]()
+		{
+			NumVisits = 0;
+			for (int32 Index = 0; Index < NumCells; Index++)
+			{
+				int8 AdjacentMines = 0;
+				Kernel.template ForEachNeighbour<false>(Index, [&](int32 Neighbour)
+				{
+					AdjacentMines += Mines[Neighbour];
+					NumVisits++;
+				});
+				Counts[Index] = Mines[Index] ? -1 : AdjacentMines;
+			}
+		});
+
+		int32 Start = NumCells / 2;
+		while (Start < NumCells - 1 && Counts[Start] != 0)	Start++;
+
+		TArray<int32> Pending;
+		int32 NumFlooded = 0;
+		const double FloodMs = TimeKernel([&]()
+		{
+			FMemory::Memzero(Revealed.GetData(), NumCells);
+			NumFlooded = 0;
+			Pending.Reset();
+			Pending.Add(Start);
+			Revealed[Start] = 1;
+			while (Pending.Num())
+			{
+				const int32 Current = Pending.Pop(false);
+				NumFlooded++;
+				if (Counts[Current] != 0)	continue;
+
+				Kernel.template ForEachNeighbour<false>(Current, [&](int32 Neighbour)
+				{
+					if (!Revealed[Neighbour])
+					{
+						Revealed[Neighbour] = 1;
+						Pending.Add(Neighbour);
+					}
+				});
+			}
+		});
+
+		UE_LOG(LogMinesweeper3D, Display, TEXT("%-16s %8d cells: count %7.2f ms (%.2f ns a neighbour), flood %d cells %7.2f ms"),
+			Name, NumCells, CountMs, CountMs * 1e6 / FMath::Max<int64>(NumVisits, 1), NumFlooded, FloodMs);
+	}
+
+	//Boards of about two million cells in each dimension
+	void RunKernelBenchmark()
+	{
+		TMinesweeper3DLattice<2> Lattice2D;
+		Lattice2D.Init({ 1448, 1448 }, { false, false });
+		BenchmarkKernel(TEXT("2D lattice"), Lattice2D, 1448 * 1448);
+
+		FHandWritten3D HandWritten3D;
+		HandWritten3D.Init({ 128, 128, 128 });
+		BenchmarkKernel(TEXT("3D hand written"), HandWritten3D, 128 * 128 * 128);
+
+		TMinesweeper3DLattice<3> Lattice3D;
+		Lattice3D.Init({ 128, 128, 128 }, { false, false, false });
+		BenchmarkKernel(TEXT("3D lattice"), Lattice3D, 128 * 128 * 128);
+
+		TMinesweeper3DLattice<4> Lattice4D;
+		Lattice4D.Init({ 38, 38, 38, 38 }, { false, false, false, false });
+		BenchmarkKernel(TEXT("4D lattice"), Lattice4D, 38 * 38 * 38 * 38);
+	}
+
+	FAutoConsoleCommand KernelBenchmarkCommand(
+		TEXT("Minesweeper3D.KernelBenchmark"),
+		TEXT("Times counting and flood reveal through the neighbour kernel on 2D, 3D and 4D boards, and the 3D one against the hand written kernel it replaced."),
+		FConsoleCommandDelegate::CreateStatic(&RunKernelBenchmark));
+}
+
+#endif
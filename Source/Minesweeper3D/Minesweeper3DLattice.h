@@ -0,0 +1,187 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/IntegralConstant.h"
+
+/** Unit steps from a cell to each of its 3^D - 1 neighbours, -1..1 along every axis with the first axis slowest. Built at compile time. */
+template<int32 D>
+struct TMinesweeper3DNeighbourSteps
+{
+	static constexpr int32 NumCombos()
+	{
+		int32 Combos = 1;
+		for (int32 Axis = 0; Axis < D; Axis++)
+		{
+			Combos *= 3;
+		}
+		return Combos;
+	}
+
+	static constexpr int32 Num = NumCombos() - 1;
+
+	int8 Steps[Num][D];
+
+	constexpr TMinesweeper3DNeighbourSteps() : Steps{}
+	{
+		int32 Neighbour = 0;
+		for (int32 Combo = 0; Combo < NumCombos(); Combo++)
+		{
+			//Every axis at 0 is the cell itself, which sits in the middle of the 3^D block
+			if (Combo == NumCombos() / 2)	continue;
+
+			int32 Rest = Combo;
+			for (int32 Axis = D - 1; Axis >= 0; Axis--)
+			{
+				Steps[Neighbour][Axis] = (int8)(Rest % 3 - 1);
+				Rest /= 3;
+			}
+			Neighbour++;
+		}
+	}
+};
+
+/**
+ * Row-major cells in D dimensions and the neighbour kernel over them, everything the board's rules need to know about
+ * its geometry. The first axis is the slowest moving, so a 4D lattice of W x X x Y x Z has the same flat index as a 3D
+ * one of (W * X) x Y x Z, which is what lets a 4D board be laid out as a strip of 3D slices.
+ *
+ * The neighbour loops are nested at compile time, one level per axis, so for D = 3 the kernel is the same triple loop
+ * the board used to spell out by hand.
+ */
+template<int32 D>
+struct TMinesweeper3DLattice
+{
+	static_assert(D >= 1 && D <= 4, "Counts are stored in an int8, which holds 3^4 - 1 neighbours but not 3^5 - 1");
+
+	static constexpr int32 NumNeighbours = TMinesweeper3DNeighbourSteps<D>::Num;
+	static constexpr TMinesweeper3DNeighbourSteps<D> NeighbourSteps{};
+
+	int32 Dims[D];
+
+	void Init(const int32 (&InDims)[D], const bool (&bInWraps)[D])
+	{
+		for (int32 Axis = 0; Axis < D; Axis++)
+		{
+			const int32 AxisSize = InDims[Axis];
+			Dims[Axis] = AxisSize;
+			AxisPrev[Axis].SetNumUninitialized(AxisSize);
+			AxisNext[Axis].SetNumUninitialized(AxisSize);
+
+			for (int32 Pos = 0; Pos < AxisSize; Pos++)
+			{
+				int32 Prev = Pos > 0 ? Pos - 1 : (bInWraps[Axis] ? AxisSize - 1 : INDEX_NONE);
+				int32 Next = Pos < AxisSize - 1 ? Pos + 1 : (bInWraps[Axis] ? 0 : INDEX_NONE);
+
+				//A wrapped axis of 1 or 2 cells would otherwise count the same neighbour (or the cell itself) twice
+				if (Prev == Pos)	Prev = INDEX_NONE;
+				if (Next == Pos || Next == Prev)	Next = INDEX_NONE;
+
+				AxisPrev[Axis][Pos] = Prev;
+				AxisNext[Axis][Pos] = Next;
+			}
+		}
+
+		int32 Strides[D];
+		Strides[D - 1] = 1;
+		for (int32 Axis = D - 2; Axis >= 0; Axis--)
+		{
+			Strides[Axis] = Strides[Axis + 1] * Dims[Axis + 1];
+		}
+
+		for (int32 Neighbour = 0; Neighbour < NumNeighbours; Neighbour++)
+		{
+			NeighbourOffsets[Neighbour] = 0;
+			for (int32 Axis = 0; Axis < D; Axis++)
+			{
+				NeighbourOffsets[Neighbour] += NeighbourSteps.Steps[Neighbour][Axis] * Strides[Axis];
+			}
+		}
+	}
+
+	FORCEINLINE void ToCoords(int32 Index, int32 (&OutPos)[D]) const
+	{
+		for (int32 Axis = D - 1; Axis > 0; Axis--)
+		{
+			OutPos[Axis] = Index % Dims[Axis];
+			Index /= Dims[Axis];
+		}
+		OutPos[0] = Index;
+	}
+
+	//Calls Func(NeighbourIndex) once for each distinct cell touching Index, never Index itself. bWrapped has to match
+	//whether any axis was set up to wrap, since bounded lattices take the interior shortcut.
+	template<bool bWrapped, typename FuncType>
+	FORCEINLINE void ForEachNeighbour(int32 Index, FuncType&& Func) const
+	{
+		int32 Pos[D];
+		ToCoords(Index, Pos);
+
+		//Interior cells step straight through the precomputed offsets
+		if (!bWrapped)
+		{
+			if (IsInterior(Pos, TIntegralConstant<int32, 0>()))
+			{
+				for (int32 Offset : NeighbourOffsets)
+				{
+					Func(Index + Offset);
+				}
+				return;
+			}
+		}
+
+		//Each axis contributes the cell's own coordinate first, then whichever of prev/next exist and are distinct
+		int32 Coords[D][3];
+		int32 NumCoords[D];
+		for (int32 Axis = 0; Axis < D; Axis++)
+		{
+			NumCoords[Axis] = 0;
+			Coords[Axis][NumCoords[Axis]++] = Pos[Axis];
+			if (AxisPrev[Axis][Pos[Axis]] != INDEX_NONE)	Coords[Axis][NumCoords[Axis]++] = AxisPrev[Axis][Pos[Axis]];
+			if (AxisNext[Axis][Pos[Axis]] != INDEX_NONE)	Coords[Axis][NumCoords[Axis]++] = AxisNext[Axis][Pos[Axis]];
+		}
+
+		VisitAxis(TIntegralConstant<int32, 0>(), Coords, NumCoords, 0, false, Func);
+	}
+
+private:
+	//Unrolled like the loops below, so the check can stop at the first axis on a face
+	template<int32 Axis>
+	FORCEINLINE bool IsInterior(const int32 (&Pos)[D], TIntegralConstant<int32, Axis>) const
+	{
+		return Pos[Axis] > 0 && Pos[Axis] < Dims[Axis] - 1 && IsInterior(Pos, TIntegralConstant<int32, Axis + 1>());
+	}
+
+	FORCEINLINE bool IsInterior(const int32 (&Pos)[D], TIntegralConstant<int32, D>) const
+	{
+		return true;
+	}
+
+	//One loop per axis, building the flat index up as it goes. Only combinations that moved along some axis are neighbours.
+	template<int32 Axis, typename FuncType>
+	FORCEINLINE void VisitAxis(TIntegralConstant<int32, Axis>, const int32 (&Coords)[D][3], const int32 (&NumCoords)[D], int32 Partial, bool bMoved, FuncType& Func) const
+	{
+		for (int32 i = 0; i < NumCoords[Axis]; i++)
+		{
+			VisitAxis(TIntegralConstant<int32, Axis + 1>(), Coords, NumCoords, Partial * Dims[Axis] + Coords[Axis][i], bMoved || i > 0, Func);
+		}
+	}
+
+	template<typename FuncType>
+	FORCEINLINE void VisitAxis(TIntegralConstant<int32, D>, const int32 (&Coords)[D][3], const int32 (&NumCoords)[D], int32 Index, bool bMoved, FuncType& Func) const
+	{
+		if (bMoved)	Func(Index);
+	}
+
+	//Per axis, the coordinate before and after each position, wrapped where the axis wraps. INDEX_NONE past a bounded face,
+	//and also where it would repeat the cell itself or the other neighbour on axes shorter than 3.
+	TArray<int32> AxisPrev[D];
+	TArray<int32> AxisNext[D];
+
+	//Flat index offsets of the neighbours of an interior cell
+	int32 NeighbourOffsets[NumNeighbours];
+};
+
+template<int32 D>
+constexpr TMinesweeper3DNeighbourSteps<D> TMinesweeper3DLattice<D>::NeighbourSteps;
@@ -0,0 +1,380 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DMorton.h"
+#include "Minesweeper3D.h"
+#include "Minesweeper3DEndlessBoard.h"
+#include "HAL/IConsoleManager.h"
+
+const uint32 FMinesweeper3DMorton::EncodeTable[256] =
+{
+	0x00000000, 0x00000001, 0x00000008, 0x00000009, 0x00000040, 0x00000041, 0x00000048, 0x00000049,
+	0x00000200, 0x00000201, 0x00000208, 0x00000209, 0x00000240, 0x00000241, 0x00000248, 0x00000249,
+	0x00001000, 0x00001001, 0x00001008, 0x00001009, 0x00001040, 0x00001041, 0x00001048, 0x00001049,
+	0x00001200, 0x00001201, 0x00001208, 0x00001209, 0x00001240, 0x00001241, 0x00001248, 0x00001249,
+	0x00008000, 0x00008001, 0x00008008, 0x00008009, 0x00008040, 0x00008041, 0x00008048, 0x00008049,
+	0x00008200, 0x00008201, 0x00008208, 0x00008209, 0x00008240, 0x00008241, 0x00008248, 0x00008249,
+	0x00009000, 0x00009001, 0x00009008, 0x00009009, 0x00009040, 0x00009041, 0x00009048, 0x00009049,
+	0x00009200, 0x00009201, 0x00009208, 0x00009209, 0x00009240, 0x00009241, 0x00009248, 0x00009249,
+	0x00040000, 0x00040001, 0x00040008, 0x00040009, 0x00040040, 0x00040041, 0x00040048, 0x00040049,
+	0x00040200, 0x00040201, 0x00040208, 0x00040209, 0x00040240, 0x00040241, 0x00040248, 0x00040249,
+	0x00041000, 0x00041001, 0x00041008, 0x00041009, 0x00041040, 0x00041041, 0x00041048, 0x00041049,
+	0x00041200, 0x00041201, 0x00041208, 0x00041209, 0x00041240, 0x00041241, 0x00041248, 0x00041249,
+	0x00048000, 0x00048001, 0x00048008, 0x00048009, 0x00048040, 0x00048041, 0x00048048, 0x00048049,
+	0x00048200, 0x00048201, 0x00048208, 0x00048209, 0x00048240, 0x00048241, 0x00048248, 0x00048249,
+	0x00049000, 0x00049001, 0x00049008, 0x00049009, 0x00049040, 0x00049041, 0x00049048, 0x00049049,
+	0x00049200, 0x00049201, 0x00049208, 0x00049209, 0x00049240, 0x00049241, 0x00049248, 0x00049249,
+	0x00200000, 0x00200001, 0x00200008, 0x00200009, 0x00200040, 0x00200041, 0x00200048, 0x00200049,
+	0x00200200, 0x00200201, 0x00200208, 0x00200209, 0x00200240, 0x00200241, 0x00200248, 0x00200249,
+	0x00201000, 0x00201001, 0x00201008, 0x00201009, 0x00201040, 0x00201041, 0x00201048, 0x00201049,
+	0x00201200, 0x00201201, 0x00201208, 0x00201209, 0x00201240, 0x00201241, 0x00201248, 0x00201249,
+	0x00208000, 0x00208001, 0x00208008, 0x00208009, 0x00208040, 0x00208041, 0x00208048, 0x00208049,
+	0x00208200, 0x00208201, 0x00208208, 0x00208209, 0x00208240, 0x00208241, 0x00208248, 0x00208249,
+	0x00209000, 0x00209001, 0x00209008, 0x00209009, 0x00209040, 0x00209041, 0x00209048, 0x00209049,
+	0x00209200, 0x00209201, 0x00209208, 0x00209209, 0x00209240, 0x00209241, 0x00209248, 0x00209249,
+	0x00240000, 0x00240001, 0x00240008, 0x00240009, 0x00240040, 0x00240041, 0x00240048, 0x00240049,
+	0x00240200, 0x00240201, 0x00240208, 0x00240209, 0x00240240, 0x00240241, 0x00240248, 0x00240249,
+	0x00241000, 0x00241001, 0x00241008, 0x00241009, 0x00241040, 0x00241041, 0x00241048, 0x00241049,
+	0x00241200, 0x00241201, 0x00241208, 0x00241209, 0x00241240, 0x00241241, 0x00241248, 0x00241249,
+	0x00248000, 0x00248001, 0x00248008, 0x00248009, 0x00248040, 0x00248041, 0x00248048, 0x00248049,
+	0x00248200, 0x00248201, 0x00248208, 0x00248209, 0x00248240, 0x00248241, 0x00248248, 0x00248249,
+	0x00249000, 0x00249001, 0x00249008, 0x00249009, 0x00249040, 0x00249041, 0x00249048, 0x00249049,
+	0x00249200, 0x00249201, 0x00249208, 0x00249209, 0x00249240, 0x00249241, 0x00249248, 0x00249249,
+};
+
+const uint32 FMinesweeper3DMorton::DecodeTable[512] =
+{
+	0x00000000, 0x00000001, 0x00000400, 0x00000401, 0x00100000, 0x00100001, 0x00100400, 0x00100401,
+	0x00000002, 0x00000003, 0x00000402, 0x00000403, 0x00100002, 0x00100003, 0x00100402, 0x00100403,
+	0x00000800, 0x00000801, 0x00000C00, 0x00000C01, 0x00100800, 0x00100801, 0x00100C00, 0x00100C01,
+	0x00000802, 0x00000803, 0x00000C02, 0x00000C03, 0x00100802, 0x00100803, 0x00100C02, 0x00100C03,
+	0x00200000, 0x00200001, 0x00200400, 0x00200401, 0x00300000, 0x00300001, 0x00300400, 0x00300401,
+	0x00200002, 0x00200003, 0x00200402, 0x00200403, 0x00300002, 0x00300003, 0x00300402, 0x00300403,
+	0x00200800, 0x00200801, 0x00200C00, 0x00200C01, 0x00300800, 0x00300801, 0x00300C00, 0x00300C01,
+	0x00200802, 0x00200803, 0x00200C02, 0x00200C03, 0x00300802, 0x00300803, 0x00300C02, 0x00300C03,
+	0x00000004, 0x00000005, 0x00000404, 0x00000405, 0x00100004, 0x00100005, 0x00100404, 0x00100405,
+	0x00000006, 0x00000007, 0x00000406, 0x00000407, 0x00100006, 0x00100007, 0x00100406, 0x00100407,
+	0x00000804, 0x00000805, 0x00000C04, 0x00000C05, 0x00100804, 0x00100805, 0x00100C04, 0x00100C05,
+	0x00000806, 0x00000807, 0x00000C06, 0x00000C07, 0x00100806, 0x00100807, 0x00100C06, 0x00100C07,
+	0x00200004, 0x00200005, 0x00200404, 0x00200405, 0x00300004, 0x00300005, 0x00300404, 0x00300405,
+	0x00200006, 0x00200007, 0x00200406, 0x00200407, 0x00300006, 0x00300007, 0x00300406, 0x00300407,
+	0x00200804, 0x00200805, 0x00200C04, 0x00200C05, 0x00300804, 0x00300805, 0x00300C04, 0x00300C05,
+	0x00200806, 0x00200807, 0x00200C06, 0x00200C07, 0x00300806, 0x00300807, 0x00300C06, 0x00300C07,
+	0x00001000, 0x00001001, 0x00001400, 0x00001401, 0x00101000, 0x00101001, 0x00101400, 0x00101401,
+	0x00001002, 0x00001003, 0x00001402, 0x00001403, 0x00101002, 0x00101003, 0x00101402, 0x00101403,
+	0x00001800, 0x00001801, 0x00001C00, 0x00001C01, 0x00101800, 0x00101801, 0x00101C00, 0x00101C01,
+	0x00001802, 0x00001803, 0x00001C02, 0x00001C03, 0x00101802, 0x00101803, 0x00101C02, 0x00101C03,
+	0x00201000, 0x00201001, 0x00201400, 0x00201401, 0x00301000, 0x00301001, 0x00301400, 0x00301401,
+	0x00201002, 0x00201003, 0x00201402, 0x00201403, 0x00301002, 0x00301003, 0x00301402, 0x00301403,
+	0x00201800, 0x00201801, 0x00201C00, 0x00201C01, 0x00301800, 0x00301801, 0x00301C00, 0x00301C01,
+	0x00201802, 0x00201803, 0x00201C02, 0x00201C03, 0x00301802, 0x00301803, 0x00301C02, 0x00301C03,
+	0x00001004, 0x00001005, 0x00001404, 0x00001405, 0x00101004, 0x00101005, 0x00101404, 0x00101405,
+	0x00001006, 0x00001007, 0x00001406, 0x00001407, 0x00101006, 0x00101007, 0x00101406, 0x00101407,
+	0x00001804, 0x00001805, 0x00001C04, 0x00001C05, 0x00101804, 0x00101805, 0x00101C04, 0x00101C05,
+	0x00001806, 0x00001807, 0x00001C06, 0x00001C07, 0x00101806, 0x00101807, 0x00101C06, 0x00101C07,
+	0x00201004, 0x00201005, 0x00201404, 0x00201405, 0x00301004, 0x00301005, 0x00301404, 0x00301405,
+	0x00201006, 0x00201007, 0x00201406, 0x00201407, 0x00301006, 0x00301007, 0x00301406, 0x00301407,
+	0x00201804, 0x00201805, 0x00201C04, 0x00201C05, 0x00301804, 0x00301805, 0x00301C04, 0x00301C05,
+	0x00201806, 0x00201807, 0x00201C06, 0x00201C07, 0x00301806, 0x00301807, 0x00301C06, 0x00301C07,
+	0x00400000, 0x00400001, 0x00400400, 0x00400401, 0x00500000, 0x00500001, 0x00500400, 0x00500401,
+	0x00400002, 0x00400003, 0x00400402, 0x00400403, 0x00500002, 0x00500003, 0x00500402, 0x00500403,
+	0x00400800, 0x00400801, 0x00400C00, 0x00400C01, 0x00500800, 0x00500801, 0x00500C00, 0x00500C01,
+	0x00400802, 0x00400803, 0x00400C02, 0x00400C03, 0x00500802, 0x00500803, 0x00500C02, 0x00500C03,
+	0x00600000, 0x00600001, 0x00600400, 0x00600401, 0x00700000, 0x00700001, 0x00700400, 0x00700401,
+	0x00600002, 0x00600003, 0x00600402, 0x00600403, 0x00700002, 0x00700003, 0x00700402, 0x00700403,
+	0x00600800, 0x00600801, 0x00600C00, 0x00600C01, 0x00700800, 0x00700801, 0x00700C00, 0x00700C01,
+	0x00600802, 0x00600803, 0x00600C02, 0x00600C03, 0x00700802, 0x00700803, 0x00700C02, 0x00700C03,
+	0x00400004, 0x00400005, 0x00400404, 0x00400405, 0x00500004, 0x00500005, 0x00500404, 0x00500405,
+	0x00400006, 0x00400007, 0x00400406, 0x00400407, 0x00500006, 0x00500007, 0x00500406, 0x00500407,
+	0x00400804, 0x00400805, 0x00400C04, 0x00400C05, 0x00500804, 0x00500805, 0x00500C04, 0x00500C05,
+	0x00400806, 0x00400807, 0x00400C06, 0x00400C07, 0x00500806, 0x00500807, 0x00500C06, 0x00500C07,
+	0x00600004, 0x00600005, 0x00600404, 0x00600405, 0x00700004, 0x00700005, 0x00700404, 0x00700405,
+	0x00600006, 0x00600007, 0x00600406, 0x00600407, 0x00700006, 0x00700007, 0x00700406, 0x00700407,
+	0x00600804, 0x00600805, 0x00600C04, 0x00600C05, 0x00700804, 0x00700805, 0x00700C04, 0x00700C05,
+	0x00600806, 0x00600807, 0x00600C06, 0x00600C07, 0x00700806, 0x00700807, 0x00700C06, 0x00700C07,
+	0x00401000, 0x00401001, 0x00401400, 0x00401401, 0x00501000, 0x00501001, 0x00501400, 0x00501401,
+	0x00401002, 0x00401003, 0x00401402, 0x00401403, 0x00501002, 0x00501003, 0x00501402, 0x00501403,
+	0x00401800, 0x00401801, 0x00401C00, 0x00401C01, 0x00501800, 0x00501801, 0x00501C00, 0x00501C01,
+	0x00401802, 0x00401803, 0x00401C02, 0x00401C03, 0x00501802, 0x00501803, 0x00501C02, 0x00501C03,
+	0x00601000, 0x00601001, 0x00601400, 0x00601401, 0x00701000, 0x00701001, 0x00701400, 0x00701401,
+	0x00601002, 0x00601003, 0x00601402, 0x00601403, 0x00701002, 0x00701003, 0x00701402, 0x00701403,
+	0x00601800, 0x00601801, 0x00601C00, 0x00601C01, 0x00701800, 0x00701801, 0x00701C00, 0x00701C01,
+	0x00601802, 0x00601803, 0x00601C02, 0x00601C03, 0x00701802, 0x00701803, 0x00701C02, 0x00701C03,
+	0x00401004, 0x00401005, 0x00401404, 0x00401405, 0x00501004, 0x00501005, 0x00501404, 0x00501405,
+	0x00401006, 0x00401007, 0x00401406, 0x00401407, 0x00501006, 0x00501007, 0x00501406, 0x00501407,
+	0x00401804, 0x00401805, 0x00401C04, 0x00401C05, 0x00501804, 0x00501805, 0x00501C04, 0x00501C05,
+	0x00401806, 0x00401807, 0x00401C06, 0x00401C07, 0x00501806, 0x00501807, 0x00501C06, 0x00501C07,
+	0x00601004, 0x00601005, 0x00601404, 0x00601405, 0x00701004, 0x00701005, 0x00701404, 0x00701405,
+	0x00601006, 0x00601007, 0x00601406, 0x00601407, 0x00701006, 0x00701007, 0x00701406, 0x00701407,
+	0x00601804, 0x00601805, 0x00601C04, 0x00601C05, 0x00701804, 0x00701805, 0x00701C04, 0x00701C05,
+	0x00601806, 0x00601807, 0x00601C06, 0x00601C07, 0x00701806, 0x00701807, 0x00701C06, 0x00701C07,
+};
+
+#if !UE_BUILD_SHIPPING
+
+/*---------- Layout benchmark ----------*/
+
+namespace
+{
+	/** Direct mapped model of a 32 KB L1 with 64 byte lines. Stands in for hardware miss counters, which aren't portable. */
+	struct FCacheModel
+	{
+		static constexpr int32 NumLines = 512;
+		static constexpr int32 LineShift = 6;
+
+		uint64 Tags[NumLines];
+		uint64 Accesses = 0;
+		uint64 Misses = 0;
+
+		FCacheModel() { FMemory::Memset(Tags, 0xFF, sizeof(Tags)); }
+
+		FORCEINLINE void Touch(const void* Address)
+		{
+			const uint64 Line = (UPTRINT)Address >> LineShift;
+			uint64& Tag = Tags[Line & (NumLines - 1)];
+			Accesses++;
+			if (Tag != Line)
+			{
+				Tag = Line;
+				Misses++;
+			}
+		}
+
+		double MissRate() const { return Accesses ? (double)Misses / Accesses : 0.0; }
+	};
+
+	//Used for the timed runs, so the model isn't what's being timed
+	struct FNoCacheModel
+	{
+		FORCEINLINE void Touch(const void*) {}
+	};
+
+	/** The finite board's layout, Z fastest */
+	struct FRowMajorLayout
+	{
+		static const TCHAR* GetName() { return TEXT("row major"); }
+
+		int32 Size;
+
+		FORCEINLINE uint32 ToIndex(int32 X, int32 Y, int32 Z) const { return (X * Size + Y) * Size + Z; }
+
+		FORCEINLINE void ToCoords(uint32 Index, int32& X, int32& Y, int32& Z) const
+		{
+			Z = Index % Size;
+			Y = (Index / Size) % Size;
+			X = Index / (Size * Size);
+		}
+
+		template<typename FuncType>
+		FORCEINLINE void ForEachNeighbour(uint32 Index, FuncType&& Func) const
+		{
+			int32 X, Y, Z;
+			ToCoords(Index, X, Y, Z);
+			for (int32 x = -1; x <= 1; x++)
+			{
+				if (X + x < 0 || X + x >= Size)	continue;
+				for (int32 y = -1; y <= 1; y++)
+				{
+					if (Y + y < 0 || Y + y >= Size)	continue;
+					for (int32 z = -1; z <= 1; z++)
+					{
+						if (Z + z < 0 || Z + z >= Size || (x == 0 && y == 0 && z == 0))	continue;
+						Func(Index + (x * Size + y) * Size + z);
+					}
+				}
+			}
+		}
+	};
+
+	/** Z-order, stepping between neighbours on the code itself. Size has to be a power of two so there are no holes. */
+	struct FMortonLayout
+	{
+		static const TCHAR* GetName() { return TEXT("Morton"); }
+
+		int32 Size;
+
+		FORCEINLINE uint32 ToIndex(int32 X, int32 Y, int32 Z) const { return FMinesweeper3DMorton::Encode(X, Y, Z); }
+		FORCEINLINE void ToCoords(uint32 Index, int32& X, int32& Y, int32& Z) const { FMinesweeper3DMorton::Decode(Index, X, Y, Z); }
+
+		template<typename FuncType>
+		FORCEINLINE void ForEachNeighbour(uint32 Index, FuncType&& Func) const
+		{
+			int32 X, Y, Z;
+			ToCoords(Index, X, Y, Z);
+			for (int32 x = -1; x <= 1; x++)
+			{
+				if (X + x < 0 || X + x >= Size)	continue;
+				const uint32 CodeX = x == 0 ? Index : FMinesweeper3DMorton::Step<FMinesweeper3DMorton::MaskX>(Index, x);
+				for (int32 y = -1; y <= 1; y++)
+				{
+					if (Y + y < 0 || Y + y >= Size)	continue;
+					const uint32 CodeY = y == 0 ? CodeX : FMinesweeper3DMorton::Step<FMinesweeper3DMorton::MaskY>(CodeX, y);
+					for (int32 z = -1; z <= 1; z++)
+					{
+						if (Z + z < 0 || Z + z >= Size || (x == 0 && y == 0 && z == 0))	continue;
+						Func(z == 0 ? CodeY : FMinesweeper3DMorton::Step<FMinesweeper3DMorton::MaskZ>(CodeY, z));
+					}
+				}
+			}
+		}
+	};
+
+	//Both layouts are walked in their own storage order, the way a pass over the whole board would be
+	template<typename LayoutType, typename CacheType>
+	void CountNeighbours(const LayoutType& Layout, const uint8* Mines, uint8* Counts, uint32 NumCells, CacheType& Cache)
+	{
+		for (uint32 Index = 0; Index < NumCells; Index++)
+		{
+			uint8 Count = 0;
+			Layout.ForEachNeighbour(Index, [&](uint32 Neighbour)
+			{
+				Cache.Touch(&Mines[Neighbour]);
+				Count += Mines[Neighbour];
+			});
+			Cache.Touch(&Counts[Index]);
+			Counts[Index] = Count;
+		}
+	}
+
+	template<typename LayoutType, typename CacheType>
+	int32 FloodReveal(const LayoutType& Layout, const uint8* Counts, uint8* Revealed, uint32 Start, TArray<uint32>& Pending, CacheType& Cache)
+	{
+		int32 NumRevealed = 0;
+		Pending.Reset();
+		Pending.Add(Start);
+		Revealed[Start] = 1;
+		while (Pending.Num())
+		{
+			const uint32 Current = Pending.Pop(false);
+			NumRevealed++;
+
+			Cache.Touch(&Counts[Current]);
+			if (Counts[Current] != 0)	continue;
+
+			//A zero has no mines around it, so everything it touches is safe to open
+			Layout.ForEachNeighbour(Current, [&](uint32 Neighbour)
+			{
+				Cache.Touch(&Revealed[Neighbour]);
+				if (!Revealed[Neighbour])
+				{
+					Revealed[Neighbour] = 1;
+					Pending.Add(Neighbour);
+				}
+			});
+		}
+		return NumRevealed;
+	}
+
+	template<typename LayoutType, typename CacheType>
+	void ExtractSlice(const LayoutType& Layout, const uint8* Cells, int32 Axis, int32 Layer, uint8* OutSlice, CacheType& Cache)
+	{
+		int32 Pos[3];
+		Pos[Axis] = Layer;
+		for (int32 a = 0; a < Layout.Size; a++)
+		{
+			Pos[(Axis + 1) % 3] = a;
+			for (int32 b = 0; b < Layout.Size; b++)
+			{
+				Pos[(Axis + 2) % 3] = b;
+				const uint32 Index = Layout.ToIndex(Pos[0], Pos[1], Pos[2]);
+				Cache.Touch(&Cells[Index]);
+				*OutSlice++ = Cells[Index];
+			}
+		}
+	}
+
+	//Best of a few runs, in milliseconds
+	template<typename FuncType>
+	double TimeBest(FuncType&& Func)
+	{
+		double Best = DBL_MAX;
+		for (int32 Run = 0; Run < 3; Run++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Func();
+			Best = FMath::Min(Best, FPlatformTime::Seconds() - StartTime);
+		}
+		return Best * 1000.0;
+	}
+
+	template<typename LayoutType>
+	void BenchmarkLayout(int32 Size)
+	{
+		const LayoutType Layout{ Size };
+		const uint32 NumCells = (uint32)Size * Size * Size;
+
+		//Same mines in both layouts, sparse enough for the flood to spread through most of the board
+		FMinesweeper3DEndlessMines Mines;
+		Mines.Seed = 1;
+		Mines.Threshold = (uint32)(0.02 * 4294967296.0);
+
+		TArray<uint8> MineBytes, Counts, Revealed, Slice;
+		MineBytes.SetNumUninitialized(NumCells);
+		Counts.SetNumUninitialized(NumCells);
+		Revealed.SetNumUninitialized(NumCells);
+		Slice.SetNumUninitialized(Size * Size);
+		for (int32 X = 0; X < Size; X++)
+		{
+			for (int32 Y = 0; Y < Size; Y++)
+			{
+				for (int32 Z = 0; Z < Size; Z++)
+				{
+					MineBytes[Layout.ToIndex(X, Y, Z)] = Mines.IsMine(FIntVector(X, Y, Z)) ? 1 : 0;
+				}
+			}
+		}
+
+		FNoCacheModel NoCache;
+
+		const double CountMs = TimeBest([&]() { CountNeighbours(Layout, MineBytes.GetData(), Counts.GetData(), NumCells, NoCache); });
+		FCacheModel CountCache;
+		CountNeighbours(Layout, MineBytes.GetData(), Counts.GetData(), NumCells, CountCache);
+
+		//Flood from the first zero along the middle row, so both layouts start from the same cell
+		int32 StartZ = Size / 2;
+		while (StartZ < Size - 1 && (MineBytes[Layout.ToIndex(Size / 2, Size / 2, StartZ)] || Counts[Layout.ToIndex(Size / 2, Size / 2, StartZ)]))	StartZ++;
+		const uint32 Start = Layout.ToIndex(Size / 2, Size / 2, StartZ);
+
+		TArray<uint32> Pending;
+		int32 NumFlooded = 0;
+		const double FloodMs = TimeBest([&]()
+		{
+			FMemory::Memzero(Revealed.GetData(), NumCells);
+			NumFlooded = FloodReveal(Layout, Counts.GetData(), Revealed.GetData(), Start, Pending, NoCache);
+		});
+		FCacheModel FloodCache;
+		FMemory::Memzero(Revealed.GetData(), NumCells);
+		FloodReveal(Layout, Counts.GetData(), Revealed.GetData(), Start, Pending, FloodCache);
+
+		double SliceMs[3];
+		FCacheModel SliceCache[3];
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			SliceMs[Axis] = TimeBest([&]() { ExtractSlice(Layout, Counts.GetData(), Axis, Size / 2, Slice.GetData(), NoCache); });
+			ExtractSlice(Layout, Counts.GetData(), Axis, Size / 2, Slice.GetData(), SliceCache[Axis]);
+		}
+
+		UE_LOG(LogMinesweeper3D, Display, TEXT("%d^3 %-9s count %8.2f ms %5.1f%% missed | flood %d cells %8.2f ms %5.1f%% missed | slice X %6.3f ms %5.1f%%, Y %6.3f ms %5.1f%%, Z %6.3f ms %5.1f%% missed"),
+			Size, LayoutType::GetName(),
+			CountMs, CountCache.MissRate() * 100.0,
+			NumFlooded, FloodMs, FloodCache.MissRate() * 100.0,
+			SliceMs[0], SliceCache[0].MissRate() * 100.0, SliceMs[1], SliceCache[1].MissRate() * 100.0, SliceMs[2], SliceCache[2].MissRate() * 100.0);
+	}
+
+	void RunLayoutBenchmark()
+	{
+		UE_LOG(LogMinesweeper3D, Display, TEXT("Cell layout benchmark, %s Morton codes. Misses are from a 32 KB direct mapped cache model."),
+			MINESWEEPER3D_MORTON_BMI2 ? TEXT("BMI2") : TEXT("table driven"));
+		for (int32 Size : { 64, 256 })
+		{
+			BenchmarkLayout<FRowMajorLayout>(Size);
+			BenchmarkLayout<FMortonLayout>(Size);
+		}
+	}
+
+	FAutoConsoleCommand LayoutBenchmarkCommand(
+		TEXT("Minesweeper3D.LayoutBenchmark"),
+		TEXT("Times neighbour counting, flood reveal and slicing on 64^3 and 256^3 boards stored row major and in Morton order. Takes several seconds."),
+		FConsoleCommandDelegate::CreateStatic(&RunLayoutBenchmark));
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//pdep/pext come with BMI2, which every AVX2 capable x64 CPU also has. Without it the tables below are used.
+#if defined(__BMI2__) || (defined(PLATFORM_ALWAYS_HAS_AVX_2) && PLATFORM_ALWAYS_HAS_AVX_2)
+	#define MINESWEEPER3D_MORTON_BMI2 1
+	#include <immintrin.h>
+#else
+	#define MINESWEEPER3D_MORTON_BMI2 0
+#endif
+
+/**
+ * Z-order (Morton) codes for 3D cell coordinates of up to 10 bits each. Bit i of Z lands on bit 3i, Y on 3i + 1 and
+ * X on 3i + 2, so like the flat board index Z is the fastest moving axis, but every aligned 2^n cube is contiguous.
+ * Neighbours are stepped to directly on the code, without decoding it, by adding on one axis' bits only.
+ */
+struct FMinesweeper3DMorton
+{
+	static constexpr uint32 MaskZ = 0x09249249;
+	static constexpr uint32 MaskY = MaskZ << 1;
+	static constexpr uint32 MaskX = MaskZ << 2;
+
+	//Largest coordinate that fits along an axis
+	static constexpr int32 MaxCoord = (1 << 10) - 1;
+
+	static FORCEINLINE uint32 Encode(uint32 X, uint32 Y, uint32 Z)
+	{
+#if MINESWEEPER3D_MORTON_BMI2
+		return _pdep_u32(X, MaskX) | _pdep_u32(Y, MaskY) | _pdep_u32(Z, MaskZ);
+#else
+		return (Spread(X) << 2) | (Spread(Y) << 1) | Spread(Z);
+#endif
+	}
+
+	static FORCEINLINE void Decode(uint32 Code, int32& OutX, int32& OutY, int32& OutZ)
+	{
+#if MINESWEEPER3D_MORTON_BMI2
+		OutX = _pext_u32(Code, MaskX);
+		OutY = _pext_u32(Code, MaskY);
+		OutZ = _pext_u32(Code, MaskZ);
+#else
+		//Nine bits, three of each axis, at a time
+		const uint32 Packed = DecodeTable[Code & 511] | DecodeTable[(Code >> 9) & 511] << 3 | DecodeTable[(Code >> 18) & 511] << 6 | DecodeTable[(Code >> 27) & 511] << 9;
+		OutZ = Packed & MaxCoord;
+		OutY = (Packed >> 10) & MaxCoord;
+		OutX = (Packed >> 20) & MaxCoord;
+#endif
+	}
+
+	//Code of the neighbour one step along an axis, Direction being -1 or 1. Wraps within the axis' bits, so callers bounds check first.
+	template<uint32 AxisMask>
+	static FORCEINLINE uint32 Step(uint32 Code, int32 Direction)
+	{
+		constexpr uint32 One = AxisMask & (0u - AxisMask);
+		const uint32 Moved = Direction > 0 ? ((Code | ~AxisMask) + One) & AxisMask : ((Code & AxisMask) - One) & AxisMask;
+		return Moved | (Code & ~AxisMask);
+	}
+
+	//Dilated form of a signed offset along one axis, ready for AddDilated. Negative offsets are their ten bit two's complement,
+	//which wraps round to the same place since the add only carries through that axis' ten bits.
+	template<uint32 AxisMask>
+	static FORCEINLINE uint32 Dilate(int32 Offset)
+	{
+#if MINESWEEPER3D_MORTON_BMI2
+		return _pdep_u32((uint32)Offset, AxisMask);
+#else
+		constexpr uint32 Shift = AxisMask == MaskX ? 2 : (AxisMask == MaskY ? 1 : 0);
+		return Spread((uint32)Offset & MaxCoord) << Shift;
+#endif
+	}
+
+	//Adds a dilated offset on one axis, carrying only through that axis' bits
+	template<uint32 AxisMask>
+	static FORCEINLINE uint32 AddDilated(uint32 Code, uint32 DilatedOffset)
+	{
+		return (((Code | ~AxisMask) + DilatedOffset) & AxisMask) | (Code & ~AxisMask);
+	}
+
+private:
+	static FORCEINLINE uint32 Spread(uint32 Value)
+	{
+		return EncodeTable[Value & 255] | EncodeTable[(Value >> 8) & 3] << 24;
+	}
+
+	//Eight bits spread three apart
+	static const uint32 EncodeTable[256];
+	//Nine code bits gathered back into three bits of each axis, Z in bits 0..2, Y in 10..12 and X in 20..22
+	static const uint32 DecodeTable[512];
+};
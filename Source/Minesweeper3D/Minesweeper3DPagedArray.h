@@ -0,0 +1,64 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/SharedPointer.h"
+
+/**
+ * Array split into fixed size pages that are shared between copies until one of them writes.
+ * Copying the array only copies page pointers, so undo snapshots cost memory proportional to what changed afterwards.
+ */
+template<typename T, int32 PageShift = 9>
+class TMinesweeper3DPagedArray
+{
+public:
+	static constexpr int32 PageSize = 1 << PageShift;
+	static constexpr int32 PageMask = PageSize - 1;
+
+	typedef TArray<T> FPage;
+	typedef TSharedPtr<FPage, ESPMode::ThreadSafe> FPagePtr;
+
+	void Init(const T& Value, int32 InNum)
+	{
+		NumElements = InNum;
+		Pages.Reset((InNum + PageMask) >> PageShift);
+		for (int32 Start = 0; Start < InNum; Start += PageSize)
+		{
+			FPagePtr Page = MakeShared<FPage, ESPMode::ThreadSafe>();
+			Page->Init(Value, FMath::Min(PageSize, InNum - Start));
+			Pages.Add(Page);
+		}
+	}
+
+	FORCEINLINE int32 Num() const { return NumElements; }
+	FORCEINLINE bool IsValidIndex(int32 Index) const { return Index >= 0 && Index < NumElements; }
+
+	FORCEINLINE const T& operator[](int32 Index) const
+	{
+		return (*Pages[Index >> PageShift])[Index & PageMask];
+	}
+
+	//Writes one element, copying its page first if anyone else is still holding on to it
+	FORCEINLINE void Set(int32 Index, const T& Value)
+	{
+		FPagePtr& Page = Pages[Index >> PageShift];
+		if (!Page.IsUnique())
+		{
+			Page = MakeShared<FPage, ESPMode::ThreadSafe>(*Page);
+		}
+		(*Page)[Index & PageMask] = Value;
+	}
+
+	FORCEINLINE int32 NumPages() const { return Pages.Num(); }
+
+	//Whether a page is the same memory in both arrays, meaning nothing in it can differ
+	FORCEINLINE bool SharesPage(const TMinesweeper3DPagedArray& Other, int32 PageIndex) const
+	{
+		return Pages[PageIndex] == Other.Pages[PageIndex];
+	}
+
+private:
+	TArray<FPagePtr> Pages;
+	int32 NumElements = 0;
+};
@@ -2,9 +2,12 @@
 
 #include "Minesweeper3DPawn.h"
 #include "Minesweeper3DBlock.h"
+#include "Minesweeper3DBlockGrid.h"
+#include "Minesweeper3DFrameGovernor.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Camera/CameraComponent.h"
 #include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Engine/World.h"
 #include "DrawDebugHelpers.h"
 #include "Components/InputComponent.h"
@@ -19,6 +22,14 @@ void AMinesweeper3DPawn::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
+	//The board changed under a still cursor, so the last trace no longer stands
+	if (CurrentBlockFocus && !IsFocusCurrent())
+	{
+		CurrentBlockFocus = nullptr;
+		CurrentFocusHandle = FMinesweeper3DBlockHandle();
+		LastTraceMousePosition = FVector2D(-1.f, -1.f);
+	}
+
 	if (APlayerController* PC = Cast<APlayerController>(GetController()))
 	{
 		if (UHeadMountedDisplayFunctionLibrary::IsHeadMountedDisplayEnabled())
@@ -32,10 +43,23 @@ void AMinesweeper3DPawn::Tick(float DeltaSeconds)
 		}
 		else
 		{
-			FVector Start, Dir, End;
-			PC->DeprojectMousePositionToWorld(Start, Dir);
-			End = Start + (Dir * 8000.0f);
-			TraceForBlock(Start, End, false);
+			//The last trace still stands unless the cursor or the view has moved since
+			const FMinesweeper3DFrameGovernor* Governor = Grid.IsValid() ? Grid->GetGovernor() : nullptr;
+			const int32 TraceInterval = Governor ? Governor->GetHoverTraceInterval() : 1;
+			FVector2D MousePosition;
+			const FTransform ViewTransform = PC->PlayerCameraManager ? FTransform(PC->PlayerCameraManager->GetCameraRotation(), PC->PlayerCameraManager->GetCameraLocation()) : FTransform::Identity;
+			if (++FramesSinceTrace >= TraceInterval && PC->GetMousePosition(MousePosition.X, MousePosition.Y)
+				&& (MousePosition != LastTraceMousePosition || !ViewTransform.Equals(LastTraceViewTransform)))
+			{
+				FramesSinceTrace = 0;
+				LastTraceMousePosition = MousePosition;
+				LastTraceViewTransform = ViewTransform;
+
+				FVector Start, Dir, End;
+				PC->DeprojectMousePositionToWorld(Start, Dir);
+				End = Start + (Dir * 8000.0f);
+				TraceForBlock(Start, End, false);
+			}
 		}
 	}
 }
@@ -74,10 +98,19 @@ void AMinesweeper3DPawn::OnResetVR()
 
 void AMinesweeper3DPawn::TriggerClick()
 {
-	if (CurrentBlockFocus)
+	if (CurrentBlockFocus && IsFocusCurrent())
 	{
 		CurrentBlockFocus->Reveal();
 	}
+
+	//Whatever the click revealed may have opened up what's under the cursor
+	LastTraceMousePosition = FVector2D(-1.f, -1.f);
+}
+
+bool AMinesweeper3DPawn::IsFocusCurrent() const
+{
+	return CurrentBlockFocus->Handle == CurrentFocusHandle && CurrentBlockFocus->OwningGrid
+		&& CurrentBlockFocus->OwningGrid->ResolveBlock(CurrentFocusHandle) == CurrentBlockFocus;
 }
 
 void AMinesweeper3DPawn::TraceForBlock(const FVector& Start, const FVector& End, bool bDrawDebugHelpers)
@@ -104,10 +137,13 @@ void AMinesweeper3DPawn::TraceForBlock(const FVector& Start, const FVector& End,
 			}
 			CurrentBlockFocus = HitBlock;
 		}
+		if (HitBlock && HitBlock->OwningGrid)	Grid = HitBlock->OwningGrid;
+		CurrentFocusHandle = HitBlock ? HitBlock->Handle : FMinesweeper3DBlockHandle();
 	}
 	else if (CurrentBlockFocus)
 	{
 		CurrentBlockFocus->Highlight(false);
 		CurrentBlockFocus = nullptr;
+		CurrentFocusHandle = FMinesweeper3DBlockHandle();
 	}
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
+#include "Minesweeper3DBlock.h"
 #include "Minesweeper3DPawn.generated.h"
 
 UCLASS(config=Game)
@@ -30,4 +31,21 @@ protected:
 
 	UPROPERTY(EditInstanceOnly, BlueprintReadWrite)
 	class AMinesweeper3DBlock* CurrentBlockFocus;
+
+	//Cell CurrentBlockFocus stood for when it was traced. Blocks are pooled and handed to other cells, so the actor alone
+	//can't say whether it's still the one under the cursor.
+	FMinesweeper3DBlockHandle CurrentFocusHandle;
+
+	//Whether CurrentBlockFocus is still the block the grid has for the cell it was traced at
+	bool IsFocusCurrent() const;
+
+	//Cursor and view from the last hover trace, so we only trace again once one of them moves
+	FVector2D LastTraceMousePosition = FVector2D(-1.f, -1.f);
+	FTransform LastTraceViewTransform;
+
+	//Frames since the last hover trace. The grid's frame governor spaces traces out when it's short of time.
+	int32 FramesSinceTrace = 0;
+
+	//Grid of the last block we hovered, which the frame governor is reached through
+	TWeakObjectPtr<class AMinesweeper3DBlockGrid> Grid;
 };
@@ -0,0 +1,510 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DPuzzlePack.h"
+#include "Minesweeper3D.h"
+#include "HAL/FileManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Load puzzle"), STAT_LoadPuzzle, STATGROUP_Minesweeper3D);
+
+namespace
+{
+	constexpr uint32 PackMagic = 0x4D334450;	//"M3DP"
+	constexpr uint32 PackVersion = 1;
+
+	//Magic, version, puzzle count and offset table position
+	constexpr int64 BinaryHeaderSize = 4 + 4 + 4 + 8;
+
+	//Binary cells are a nibble each, low nibble first: the state in the bottom two bits and the mine above them
+	constexpr uint8 CellStateMask = 3;
+	constexpr uint8 CellMineBit = 4;
+
+	/** Reads a file forward through a fixed buffer, a byte at a time, without going through the archive for each one */
+	class FPackStream
+	{
+	public:
+		explicit FPackStream(FArchive& InAr)
+			: Ar(InAr)
+			, BufferStart(InAr.Tell())
+			, Remaining(InAr.TotalSize() - InAr.Tell())
+		{
+		}
+
+		FORCEINLINE bool Peek(uint8& OutByte)
+		{
+			if (Pos == End && !Refill())	return false;
+			OutByte = Buffer[Pos];
+			return true;
+		}
+
+		FORCEINLINE bool Next(uint8& OutByte)
+		{
+			if (!Peek(OutByte))	return false;
+			Pos++;
+			return true;
+		}
+
+		//File offset of the next byte Next() will return
+		FORCEINLINE int64 Tell() const { return BufferStart + Pos; }
+
+	private:
+		bool Refill()
+		{
+			if (Remaining <= 0)	return false;
+
+			BufferStart += End;
+			End = (int32)FMath::Min<int64>(Remaining, BufferSize);
+			Pos = 0;
+			Ar.Serialize(Buffer, End);
+			Remaining -= End;
+			return !Ar.IsError();
+		}
+
+		static constexpr int32 BufferSize = 16 * 1024;
+
+		FArchive& Ar;
+		int64 BufferStart;
+		int64 Remaining;
+		int32 Pos = 0;
+		int32 End = 0;
+		uint8 Buffer[BufferSize];
+	};
+
+	FORCEINLINE bool IsBlank(uint8 Char)
+	{
+		return Char == ' ' || Char == '\t' || Char == '\r';
+	}
+
+	FORCEINLINE bool IsWhitespace(uint8 Char)
+	{
+		return IsBlank(Char) || Char == '\n';
+	}
+
+	void SkipBlanks(FPackStream& Stream)
+	{
+		uint8 Char;
+		while (Stream.Peek(Char) && IsBlank(Char))
+		{
+			Stream.Next(Char);
+		}
+	}
+
+	//Reads up to the next whitespace into OutWord, which is always terminated. Returns false if the word didn't fit.
+	bool ReadWord(FPackStream& Stream, ANSICHAR* OutWord, int32 MaxLength)
+	{
+		SkipBlanks(Stream);
+
+		int32 Length = 0;
+		uint8 Char;
+		while (Stream.Peek(Char) && !IsWhitespace(Char))
+		{
+			if (Length == MaxLength - 1)	return false;
+			OutWord[Length++] = (ANSICHAR)Char;
+			Stream.Next(Char);
+		}
+		OutWord[Length] = 0;
+		return true;
+	}
+
+	bool ReadInt(FPackStream& Stream, int32& OutValue)
+	{
+		ANSICHAR Word[12];
+		if (!ReadWord(Stream, Word, UE_ARRAY_COUNT(Word)) || Word[0] == 0)	return false;
+
+		int64 Value = 0;
+		for (const ANSICHAR* Digit = Word; *Digit; Digit++)
+		{
+			if (*Digit < '0' || *Digit > '9')	return false;
+			Value = Value * 10 + (*Digit - '0');
+			if (Value > MAX_int32)	return false;
+		}
+		OutValue = (int32)Value;
+		return true;
+	}
+
+	//"puzzle X Y Z [wrap xyz]", up to and including the end of the line
+	bool ReadTextHeader(FPackStream& Stream, FMinesweeper3DBoardShape& OutShape)
+	{
+		ANSICHAR Word[8];
+		if (!ReadWord(Stream, Word, UE_ARRAY_COUNT(Word)) || FCStringAnsi::Strcmp(Word, "puzzle") != 0)	return false;
+
+		OutShape = FMinesweeper3DBoardShape();
+		if (!ReadInt(Stream, OutShape.Dims.X) || !ReadInt(Stream, OutShape.Dims.Y) || !ReadInt(Stream, OutShape.Dims.Z))	return false;
+
+		if (!ReadWord(Stream, Word, UE_ARRAY_COUNT(Word)))	return false;
+		if (FCStringAnsi::Strcmp(Word, "wrap") == 0)
+		{
+			if (!ReadWord(Stream, Word, UE_ARRAY_COUNT(Word)))	return false;
+			for (const ANSICHAR* Axis = Word; *Axis; Axis++)
+			{
+				switch (*Axis)
+				{
+				case 'x':	OutShape.bWrapX = true;	break;
+				case 'y':	OutShape.bWrapY = true;	break;
+				case 'z':	OutShape.bWrapZ = true;	break;
+				default:	return false;
+				}
+			}
+			if (!ReadWord(Stream, Word, UE_ARRAY_COUNT(Word)))	return false;
+		}
+
+		//Nothing else belongs on the line
+		uint8 Char;
+		return Word[0] == 0 && (!Stream.Next(Char) || Char == '\n');
+	}
+
+	FORCEINLINE bool DecodeTextCell(uint8 Char, EMinesweeper3DCellState& OutState, bool& bOutMine)
+	{
+		switch (Char)
+		{
+		case '.':	OutState = EMinesweeper3DCellState::Hidden;	bOutMine = false;	return true;
+		case '*':	OutState = EMinesweeper3DCellState::Hidden;	bOutMine = true;	return true;
+		case 'o':	OutState = EMinesweeper3DCellState::Revealed;	bOutMine = false;	return true;
+		case 'F':	OutState = EMinesweeper3DCellState::Flagged;	bOutMine = true;	return true;
+		case 'f':	OutState = EMinesweeper3DCellState::Flagged;	bOutMine = false;	return true;
+		default:	return false;
+		}
+	}
+
+	FORCEINLINE bool DecodeBinaryCell(uint8 Nibble, EMinesweeper3DCellState& OutState, bool& bOutMine)
+	{
+		const uint8 State = Nibble & CellStateMask;
+		bOutMine = (Nibble & CellMineBit) != 0;
+		OutState = (EMinesweeper3DCellState)State;
+
+		//A revealed mine means the game was already lost
+		return State <= (uint8)EMinesweeper3DCellState::Flagged && !(bOutMine && OutState == EMinesweeper3DCellState::Revealed);
+	}
+
+	FORCEINLINE void WriteCell(FMinesweeper3DBoard& Board, int32 Index, EMinesweeper3DCellState State, bool bMine)
+	{
+		Board.Mines[Index] = bMine;
+		if (Board.States[Index] != State)	Board.States.Set(Index, State);
+	}
+
+	bool IsValidShape(const FMinesweeper3DBoardShape& Shape)
+	{
+		//Packs only hold 3D boards, the text format has nowhere to put a fourth axis
+		const FIntVector& Dims = Shape.Dims;
+		return Dims.GetMin() >= 1 && !Shape.Is4D() && (int64)Dims.X * Dims.Y * Dims.Z <= FMinesweeper3DPuzzlePack::MaxPuzzleCells;
+	}
+
+	void WriteString(FArchive& Ar, const FString& String)
+	{
+		FTCHARToUTF8 Converted(*String);
+		Ar.Serialize((void*)Converted.Get(), Converted.Length());
+	}
+}
+
+/*---------- Reading ----------*/
+
+bool FMinesweeper3DPuzzlePack::Open(const FString& InPath)
+{
+	Close();
+	Path = InPath;
+
+	Reader.Reset(IFileManager::Get().CreateFileReader(*Path));
+	if (!Reader)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't open puzzle pack %s"), *Path);
+		return false;
+	}
+
+	uint32 Magic = 0;
+	if (Reader->TotalSize() >= BinaryHeaderSize)	*Reader << Magic;
+
+	if (Magic != PackMagic)
+	{
+		Format = EMinesweeper3DPuzzleFormat::Text;
+		Reader->Seek(0);
+		return BuildTextIndex();
+	}
+
+	Format = EMinesweeper3DPuzzleFormat::Binary;
+	uint32 Version = 0;
+	*Reader << Version << NumPuzzles << IndexOffset;
+	if (Reader->IsError() || Version != PackVersion || NumPuzzles < 0 || IndexOffset < BinaryHeaderSize || IndexOffset + NumPuzzles * (int64)sizeof(int64) > Reader->TotalSize())
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Puzzle pack %s isn't a version %u pack"), *Path, PackVersion);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FMinesweeper3DPuzzlePack::Close()
+{
+	Reader.Reset();
+	NumPuzzles = 0;
+	IndexOffset = 0;
+	TextOffsets.Empty();
+}
+
+//One pass over the file, noting where every line starting with "puzzle" begins
+bool FMinesweeper3DPuzzlePack::BuildTextIndex()
+{
+	static const uint8 Keyword[] = { 'p', 'u', 'z', 'z', 'l', 'e' };
+
+	FPackStream Stream(*Reader);
+	int64 LineStart = 0;
+	int32 Matched = 0;
+	bool bLineStart = true;
+	uint8 Char;
+	while (Stream.Next(Char))
+	{
+		if (Char == '\n')
+		{
+			bLineStart = true;
+			Matched = 0;
+			LineStart = Stream.Tell();
+			continue;
+		}
+		if (!bLineStart)	continue;
+
+		if (Char == Keyword[Matched])
+		{
+			if (++Matched == UE_ARRAY_COUNT(Keyword))
+			{
+				TextOffsets.Add(LineStart);
+				bLineStart = false;
+			}
+		}
+		else
+		{
+			bLineStart = false;
+		}
+	}
+
+	if (Reader->IsError())
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't read puzzle pack %s"), *Path);
+		Close();
+		return false;
+	}
+
+	NumPuzzles = TextOffsets.Num();
+	UE_LOG(LogMinesweeper3D, Log, TEXT("Indexed %d puzzles in %s"), NumPuzzles, *Path);
+	return true;
+}
+
+bool FMinesweeper3DPuzzlePack::SeekToPuzzle(int32 PuzzleIndex)
+{
+	if (!Reader || PuzzleIndex < 0 || PuzzleIndex >= NumPuzzles)	return false;
+
+	int64 Offset = 0;
+	if (Format == EMinesweeper3DPuzzleFormat::Binary)
+	{
+		Reader->Seek(IndexOffset + PuzzleIndex * (int64)sizeof(int64));
+		*Reader << Offset;
+		if (Reader->IsError() || Offset < BinaryHeaderSize || Offset >= IndexOffset)	return false;
+	}
+	else
+	{
+		Offset = TextOffsets[PuzzleIndex];
+	}
+
+	Reader->Seek(Offset);
+	return !Reader->IsError();
+}
+
+bool FMinesweeper3DPuzzlePack::ReadShape(int32 PuzzleIndex, FMinesweeper3DBoardShape& OutShape)
+{
+	if (!SeekToPuzzle(PuzzleIndex))	return false;
+
+	bool bRead;
+	if (Format == EMinesweeper3DPuzzleFormat::Binary)
+	{
+		*Reader << OutShape;
+		bRead = !Reader->IsError();
+	}
+	else
+	{
+		//The stream will have buffered past the header, so put the reader back on the first cell
+		FPackStream Stream(*Reader);
+		bRead = ReadTextHeader(Stream, OutShape);
+		Reader->Seek(Stream.Tell());
+	}
+
+	if (!bRead || !IsValidShape(OutShape))
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Puzzle %d in %s has a bad header"), PuzzleIndex, *Path);
+		return false;
+	}
+	return true;
+}
+
+bool FMinesweeper3DPuzzlePack::Load(int32 PuzzleIndex, FMinesweeper3DBoard& Board)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LoadPuzzle);
+
+	FMinesweeper3DBoardShape PuzzleShape;
+	if (!ReadShape(PuzzleIndex, PuzzleShape))	return false;
+
+	//ReadShape leaves the reader on the first cell either way
+	if (!(Board.Shape == PuzzleShape) || Board.Num() != PuzzleShape.Num())	Board.Reset(PuzzleShape, 0);
+
+	FPackStream Stream(*Reader);
+	const int32 NumCells = Board.Num();
+	EMinesweeper3DCellState State;
+	bool bMine;
+	uint8 Char;
+	int32 Index = 0;
+	if (Format == EMinesweeper3DPuzzleFormat::Binary)
+	{
+		while (Index < NumCells && Stream.Next(Char))
+		{
+			if (!DecodeBinaryCell(Char & 0xF, State, bMine))	break;
+			WriteCell(Board, Index++, State, bMine);
+
+			if (Index == NumCells)	break;
+			if (!DecodeBinaryCell(Char >> 4, State, bMine))	break;
+			WriteCell(Board, Index++, State, bMine);
+		}
+	}
+	else
+	{
+		while (Index < NumCells && Stream.Next(Char))
+		{
+			if (IsWhitespace(Char))	continue;
+			if (!DecodeTextCell(Char, State, bMine))	break;
+			WriteCell(Board, Index++, State, bMine);
+		}
+	}
+
+	if (Index != NumCells)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Puzzle %d in %s is corrupt or ends early, at cell %d of %d"), PuzzleIndex, *Path, Index, NumCells);
+		return false;
+	}
+
+	Board.FinishLoading();
+	return true;
+}
+
+/*---------- Writing ----------*/
+
+FMinesweeper3DPuzzlePackWriter::~FMinesweeper3DPuzzlePackWriter()
+{
+	Close();
+}
+
+bool FMinesweeper3DPuzzlePackWriter::Open(const FString& InPath, EMinesweeper3DPuzzleFormat InFormat)
+{
+	Close();
+	Format = InFormat;
+	Offsets.Reset();
+
+	Writer.Reset(IFileManager::Get().CreateFileWriter(*InPath));
+	if (!Writer)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't open puzzle pack %s for writing"), *InPath);
+		return false;
+	}
+
+	//The count and offset table position are filled in by Close()
+	if (Format == EMinesweeper3DPuzzleFormat::Binary)
+	{
+		uint32 Magic = PackMagic;
+		uint32 Version = PackVersion;
+		int32 NumPuzzles = 0;
+		int64 IndexOffset = 0;
+		*Writer << Magic << Version << NumPuzzles << IndexOffset;
+	}
+	return true;
+}
+
+bool FMinesweeper3DPuzzlePackWriter::Add(const FMinesweeper3DBoard& Board)
+{
+	if (!Writer || !Board.bGenerated)	return false;
+	if (Board.Shape.Is4D())
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Puzzle packs only hold 3D boards"));
+		return false;
+	}
+
+	FMinesweeper3DBoardShape Shape = Board.Shape;
+	const int32 NumCells = Board.Num();
+	Offsets.Add(Writer->Tell());
+
+	if (Format == EMinesweeper3DPuzzleFormat::Binary)
+	{
+		*Writer << Shape;
+
+		uint8 Packed = 0;
+		for (int32 Index = 0; Index < NumCells; Index++)
+		{
+			const uint8 Nibble = (uint8)Board.States[Index] | (Board.Mines[Index] ? CellMineBit : 0);
+			if (Index & 1)
+			{
+				Packed |= Nibble << 4;
+				*Writer << Packed;
+			}
+			else
+			{
+				Packed = Nibble;
+			}
+		}
+		if (NumCells & 1)	*Writer << Packed;
+		return !Writer->IsError();
+	}
+
+	FString Header = FString::Printf(TEXT("puzzle %d %d %d"), Shape.Dims.X, Shape.Dims.Y, Shape.Dims.Z);
+	if (Shape.IsWrapped())
+	{
+		Header += TEXT(" wrap ");
+		if (Shape.bWrapX)	Header += TEXT("x");
+		if (Shape.bWrapY)	Header += TEXT("y");
+		if (Shape.bWrapZ)	Header += TEXT("z");
+	}
+	Header += TEXT("\n");
+	WriteString(*Writer, Header);
+
+	//One row of Z per line, and a blank line after each X layer
+	TArray<ANSICHAR> Row;
+	Row.SetNumUninitialized(Shape.Dims.Z + 1);
+	Row.Last() = '\n';
+	int32 Index = 0;
+	for (int32 X = 0; X < Shape.Dims.X; X++)
+	{
+		for (int32 Y = 0; Y < Shape.Dims.Y; Y++)
+		{
+			for (int32 Z = 0; Z < Shape.Dims.Z; Z++, Index++)
+			{
+				const bool bMine = Board.Mines[Index];
+				switch (Board.States[Index])
+				{
+				case EMinesweeper3DCellState::Hidden:	Row[Z] = bMine ? '*' : '.';	break;
+				case EMinesweeper3DCellState::Flagged:	Row[Z] = bMine ? 'F' : 'f';	break;
+				default:	Row[Z] = 'o';	break;
+				}
+			}
+			Writer->Serialize(Row.GetData(), Row.Num());
+		}
+		ANSICHAR Blank = '\n';
+		Writer->Serialize(&Blank, 1);
+	}
+	return !Writer->IsError();
+}
+
+bool FMinesweeper3DPuzzlePackWriter::Close()
+{
+	if (!Writer)	return false;
+
+	if (Format == EMinesweeper3DPuzzleFormat::Binary)
+	{
+		int64 IndexOffset = Writer->Tell();
+		for (int64& Offset : Offsets)
+		{
+			*Writer << Offset;
+		}
+
+		uint32 Magic = PackMagic;
+		uint32 Version = PackVersion;
+		int32 NumPuzzles = Offsets.Num();
+		Writer->Seek(0);
+		*Writer << Magic << Version << NumPuzzles << IndexOffset;
+	}
+
+	const bool bSucceeded = !Writer->IsError() && Writer->Close();
+	Writer.Reset();
+	return bSucceeded;
+}
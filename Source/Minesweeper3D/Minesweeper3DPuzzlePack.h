@@ -0,0 +1,85 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Minesweeper3DBoard.h"
+#include "Minesweeper3DPuzzlePack.generated.h"
+
+/** How a puzzle pack is stored on disk */
+UENUM(BlueprintType)
+enum class EMinesweeper3DPuzzleFormat : uint8
+{
+	//Hand editable. One "puzzle X Y Z [wrap xyz]" line per puzzle, then one character per cell in flat index order.
+	Text,
+	//Four bits a cell, with an offset table at the end of the file
+	Binary
+};
+
+/**
+ * A file of hand made or generated boards, including part played positions. Puzzles are read one at a time, on demand.
+ *
+ * Text cells are '.' hidden, '*' hidden mine, 'o' revealed, 'F' flagged mine and 'f' flagged safe cell. They're laid out
+ * X layer by X layer, a row per Y, a character per Z, and whitespace between them is ignored. Lines starting with '#'
+ * between puzzles are comments. Counts are never stored, they're worked out from the mines once the puzzle is loaded.
+ *
+ * Binary packs carry their own offset table, so opening one reads the header and jumping to a puzzle is two seeks.
+ * Text packs have to be scanned for their "puzzle" lines once when they're opened.
+ */
+class FMinesweeper3DPuzzlePack
+{
+public:
+	//Returns false, and logs why, if the file can't be read as a pack
+	bool Open(const FString& InPath);
+	void Close();
+
+	const FString& GetPath() const { return Path; }
+	EMinesweeper3DPuzzleFormat GetFormat() const { return Format; }
+	int32 Num() const { return NumPuzzles; }
+
+	//Reads just the shape of a puzzle, so the caller can get the board ready for it
+	bool ReadShape(int32 PuzzleIndex, FMinesweeper3DBoardShape& OutShape);
+
+	/**
+	 * Parses a puzzle straight into Board's mines and states, then counts and labels it. The board is only reset if it
+	 * isn't already that shape, and the parser itself allocates nothing, it streams the cells through a fixed buffer.
+	 */
+	bool Load(int32 PuzzleIndex, FMinesweeper3DBoard& Board);
+
+	//Largest puzzle a pack may hold, so a corrupt header can't ask for an enormous board
+	static constexpr int32 MaxPuzzleCells = 256 * 256 * 256;
+
+private:
+	bool SeekToPuzzle(int32 PuzzleIndex);
+	bool BuildTextIndex();
+
+	FString Path;
+	EMinesweeper3DPuzzleFormat Format = EMinesweeper3DPuzzleFormat::Text;
+	int32 NumPuzzles = 0;
+
+	//Binary packs: where the offset table starts. Text packs: the offset of each "puzzle" line, found when the pack was opened.
+	int64 IndexOffset = 0;
+	TArray<int64> TextOffsets;
+
+	TUniquePtr<FArchive> Reader;
+};
+
+/** Writes a pack one puzzle at a time, so a tool can stream thousands of boards out without holding them all */
+class FMinesweeper3DPuzzlePackWriter
+{
+public:
+	~FMinesweeper3DPuzzlePackWriter();
+
+	bool Open(const FString& InPath, EMinesweeper3DPuzzleFormat InFormat);
+
+	//Writes the board as it stands: mines, what's revealed and what's flagged. Only a board with its mines placed can be saved.
+	bool Add(const FMinesweeper3DBoard& Board);
+
+	//Writes the offset table of a binary pack. Returns false if anything along the way failed to write.
+	bool Close();
+
+private:
+	EMinesweeper3DPuzzleFormat Format = EMinesweeper3DPuzzleFormat::Text;
+	TArray<int64> Offsets;
+	TUniquePtr<FArchive> Writer;
+};
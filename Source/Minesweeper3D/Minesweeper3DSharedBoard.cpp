@@ -0,0 +1,208 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Minesweeper3DSharedBoard.h"
+#include "Minesweeper3D.h"
+#include "Misc/CoreDelegates.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shared board commands"), STAT_SharedBoardCommands, STATGROUP_Minesweeper3D);
+DECLARE_CYCLE_STAT(TEXT("Shared board publish"), STAT_SharedBoardPublish, STATGROUP_Minesweeper3D);
+
+namespace
+{
+	//Bots queue a move or two at a time, this only has to cover a frame's worth of them
+	constexpr int32 SharedCommandCapacity = 1024;
+
+	constexpr uint32 SharedAlignment = 64;
+
+	FORCEINLINE int8 ToSharedCell(EMinesweeper3DCellState State, int8 Count)
+	{
+		switch (State)
+		{
+		case EMinesweeper3DCellState::Revealed:	return Count;
+		case EMinesweeper3DCellState::Flagged:	return FMinesweeper3DSharedBoardHeader::FlaggedCell;
+		default:	return FMinesweeper3DSharedBoardHeader::HiddenCell;
+		}
+	}
+}
+
+FMinesweeper3DSharedBoard::FMinesweeper3DSharedBoard(const FString& Name, int32 MaxCells)
+{
+	check(IsInGameThread());
+
+	CellCapacity = FMath::Max(MaxCells, 0);
+	const uint32 CellsOffset = Align((uint32)sizeof(FMinesweeper3DSharedBoardHeader), SharedAlignment);
+	const uint32 CommandsOffset = Align(CellsOffset + (uint32)CellCapacity, SharedAlignment);
+	const uint32 TotalSize = CommandsOffset + SharedCommandCapacity * sizeof(FMinesweeper3DSharedCommandEntry);
+
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, true, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, TotalSize);
+	if (!Region)
+	{
+		UE_LOG(LogMinesweeper3D, Warning, TEXT("Couldn't map shared memory %s, the board won't be published"), *Name);
+		return;
+	}
+
+	//A segment left behind by an earlier run is started over. The magic goes in last so a reader never sees it half set up.
+	uint8* Base = (uint8*)Region->GetAddress();
+	Header = new (Base) FMinesweeper3DSharedBoardHeader();
+	Header->Magic = 0;
+	Header->CellsOffset = CellsOffset;
+	Header->CellCapacity = CellCapacity;
+	Header->CommandsOffset = CommandsOffset;
+	Header->CommandCapacity = SharedCommandCapacity;
+	Cells = (int8*)(Base + CellsOffset);
+	Commands = (FMinesweeper3DSharedCommandEntry*)(Base + CommandsOffset);
+	FPlatformMisc::MemoryBarrier();
+	Header->Magic = FMinesweeper3DSharedBoardHeader::ExpectedMagic;
+
+	//The grid only ticks while something's moving, but moves can come in at any time
+	BeginFrameHandle = FCoreDelegates::OnBeginFrame.AddRaw(this, &FMinesweeper3DSharedBoard::OnBeginFrame);
+
+	UE_LOG(LogMinesweeper3D, Log, TEXT("Publishing the board to shared memory %s, up to %d cells"), *Name, MaxCells);
+}
+
+FMinesweeper3DSharedBoard::~FMinesweeper3DSharedBoard()
+{
+	FCoreDelegates::OnBeginFrame.Remove(BeginFrameHandle);
+	if (Region)
+	{
+		//Readers still mapped see it go blank rather than stop changing
+		Header->Magic = 0;
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+	}
+}
+
+/*---------- Seqlock ----------*/
+
+void FMinesweeper3DSharedBoard::BeginWrite()
+{
+	//Odd before any of the data changes, which readers see as a write in progress
+	FPlatformAtomics::AtomicStore(&Header->Sequence, ++Sequence);
+	FPlatformMisc::MemoryBarrier();
+}
+
+void FMinesweeper3DSharedBoard::EndWrite()
+{
+	FPlatformMisc::MemoryBarrier();
+	FPlatformAtomics::AtomicStore(&Header->Sequence, ++Sequence);
+}
+
+/*---------- Publishing ----------*/
+
+void FMinesweeper3DSharedBoard::PublishBoard(const FMinesweeper3DBoard& Board)
+{
+	if (!Header)	return;
+	SCOPE_CYCLE_COUNTER(STAT_SharedBoardPublish);
+
+	const FIntVector Dims = Board.Shape.GetLayoutDims();
+	const bool bFits = Board.Num() <= CellCapacity;
+	if (!bFits)	UE_LOG(LogMinesweeper3D, Warning, TEXT("A board of %d cells doesn't fit the shared segment's %d, it won't be published"), Board.Num(), CellCapacity);
+	NumCells = bFits ? Board.Num() : 0;
+
+	BeginWrite();
+	Header->BoardId = ++BoardId;
+	Header->DimsX = Dims.X;
+	Header->DimsY = Dims.Y;
+	Header->DimsZ = Dims.Z;
+	Header->Slices = Board.Shape.Slices;
+	Header->WrapFlags = (Board.Shape.bWrapX ? 1 : 0) | (Board.Shape.bWrapY ? 2 : 0) | (Board.Shape.bWrapZ ? 4 : 0);
+	Header->NumCells = NumCells;
+	for (int32 Index = 0; Index < NumCells; Index++)
+	{
+		Cells[Index] = ToSharedCell(Board.States[Index], Board.Counts[Index]);
+	}
+	EndWrite();
+}
+
+void FMinesweeper3DSharedBoard::PublishDelta(const FMinesweeper3DBoardDelta& Delta)
+{
+	if (!Header || NumCells == 0)	return;
+	SCOPE_CYCLE_COUNTER(STAT_SharedBoardPublish);
+
+	BeginWrite();
+
+	int32 CountIndex = 0;
+	for (int32 Run = 0; Run < Delta.RunStarts.Num(); Run++)
+	{
+		for (int32 i = 0; i < Delta.RunLengths[Run]; i++)
+		{
+			const int32 Index = Delta.RunStarts[Run] + i;
+			const int8 Count = Delta.Counts[CountIndex++];
+			if (Index >= 0 && Index < NumCells)	Cells[Index] = Count;
+		}
+	}
+
+	//Flags can only go on hidden cells, and unflagged or undone cells are hidden again
+	for (int32 Index : Delta.Flagged)
+	{
+		if (Index >= 0 && Index < NumCells)	Cells[Index] = FMinesweeper3DSharedBoardHeader::FlaggedCell;
+	}
+	for (int32 Index : Delta.Unflagged)
+	{
+		if (Index >= 0 && Index < NumCells)	Cells[Index] = FMinesweeper3DSharedBoardHeader::HiddenCell;
+	}
+	for (int32 Index : Delta.Hidden)
+	{
+		if (Index >= 0 && Index < NumCells)	Cells[Index] = FMinesweeper3DSharedBoardHeader::HiddenCell;
+	}
+
+	EndWrite();
+}
+
+void FMinesweeper3DSharedBoard::PublishStatus(int32 NumMines, int32 MinesRemaining, int32 ElapsedTime, bool bGameWon, bool bGameLost)
+{
+	if (!Header)	return;
+
+	BeginWrite();
+	Header->NumMines = NumMines;
+	Header->MinesRemaining = MinesRemaining;
+	Header->ElapsedTime = ElapsedTime;
+	Header->bGameWon = bGameWon ? 1 : 0;
+	Header->bGameLost = bGameLost ? 1 : 0;
+	EndWrite();
+}
+
+void FMinesweeper3DSharedBoard::Clear()
+{
+	if (!Header)	return;
+
+	BeginWrite();
+	Header->BoardId = ++BoardId;
+	Header->DimsX = Header->DimsY = Header->DimsZ = 0;
+	Header->Slices = 1;
+	Header->WrapFlags = 0;
+	NumCells = 0;
+	Header->NumCells = 0;
+	EndWrite();
+}
+
+/*---------- Commands ----------*/
+
+void FMinesweeper3DSharedBoard::OnBeginFrame()
+{
+	const int32 Head = FPlatformAtomics::AtomicRead(&Header->CommandHead);
+	if (Head == CommandTail)	return;
+
+	//Entries are only read once the head that covers them has been, and a producer running more than a ring ahead has
+	//overwritten some of them, so those are skipped rather than trusted. A head that went backwards counts as that too.
+	FPlatformMisc::MemoryBarrier();
+	int32 Tail = CommandTail;
+	if ((uint32)(Head - Tail) > (uint32)SharedCommandCapacity)	Tail = Head - SharedCommandCapacity;
+
+	for (; Tail != Head; Tail++)
+	{
+		const FMinesweeper3DSharedCommandEntry Entry = Commands[(uint32)Tail % (uint32)SharedCommandCapacity];
+		if (Entry.Command == (int32)EMinesweeper3DSharedCommand::Reveal || Entry.Command == (int32)EMinesweeper3DSharedCommand::Flag)
+		{
+			OnCommand.ExecuteIfBound((EMinesweeper3DSharedCommand)Entry.Command, Entry.Index);
+		}
+		INC_DWORD_STAT(STAT_SharedBoardCommands);
+	}
+
+	//Each command's delta went out as it was handled. Saying they're done last means a reader that sees the count sees them.
+	CommandsDone += Head - CommandTail;
+	CommandTail = Head;
+	BeginWrite();
+	Header->CommandsDone = CommandsDone;
+	EndWrite();
+	FPlatformAtomics::AtomicStore(&Header->CommandTail, CommandTail);
+}
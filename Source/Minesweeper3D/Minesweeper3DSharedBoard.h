@@ -0,0 +1,128 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Minesweeper3DBoard.h"
+
+/** Actions an outside process can queue through the command ring */
+enum class EMinesweeper3DSharedCommand : int32
+{
+	Reveal = 1,
+	Flag = 2
+};
+
+/** One entry of the command ring */
+struct FMinesweeper3DSharedCommandEntry
+{
+	int32 Command = 0;
+	int32 Index = INDEX_NONE;
+};
+
+/**
+ * Start of the shared segment. Everything is fixed size and little endian, so tools that don't build against the engine
+ * can map the same layout. Cells follow at CellsOffset, one int8 per cell in flat index order, and the command ring at
+ * CommandsOffset, CommandCapacity entries.
+ */
+struct FMinesweeper3DSharedBoardHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4D334453;	//"M3DS"
+	static constexpr uint32 ExpectedVersion = 1;
+
+	//Cell values. Revealed cells hold their count, or MineCount for a revealed mine, so hidden mines never show.
+	static constexpr int8 HiddenCell = -2;
+	static constexpr int8 FlaggedCell = -3;
+
+	//Fixed while the segment exists
+	uint32 Magic = ExpectedMagic;
+	uint32 Version = ExpectedVersion;
+	uint32 CellsOffset = 0;
+	uint32 CellCapacity = 0;
+	uint32 CommandsOffset = 0;
+	uint32 CommandCapacity = 0;
+
+	//Odd while the game is writing. A reader copies what it needs between two reads of an even, unchanged Sequence.
+	alignas(64) volatile int32 Sequence = 0;
+
+	//Bumped for every new board, so a reader knows to start its copy over
+	int32 BoardId = 0;
+
+	//Layout dimensions, a 4D board's slices along X. NumCells is 0 with no board to show, or one too big for the segment.
+	int32 DimsX = 0;
+	int32 DimsY = 0;
+	int32 DimsZ = 0;
+	int32 Slices = 1;
+	int32 WrapFlags = 0;
+	int32 NumCells = 0;
+
+	int32 NumMines = 0;
+	int32 MinesRemaining = 0;
+	int32 ElapsedTime = 0;
+	int32 bGameWon = 0;
+	int32 bGameLost = 0;
+
+	//Commands taken off the ring whose effects are in the cells above. A client's are only on their way to the server by
+	//then, its cells change when the server's answer comes back.
+	int32 CommandsDone = 0;
+
+	//Written by the outside process once an entry is in place, then read by the game. Both only ever count up and wrap.
+	alignas(64) volatile int32 CommandHead = 0;
+
+	//Written by the game once it's taken entries off
+	alignas(64) volatile int32 CommandTail = 0;
+};
+
+/**
+ * Publishes the board into a named shared memory segment for bots and analysis tools, and takes their moves back.
+ * The game thread writes only what each delta changed, under a seqlock, so readers never block it and it never waits
+ * for them. Only what the player can see goes out, the board's own mines never do. Moves come back through a single
+ * producer ring that's drained at the start of every frame, and go through the same checks as a click.
+ * Game thread only.
+ */
+class FMinesweeper3DSharedBoard
+{
+public:
+	DECLARE_DELEGATE_TwoParams(FOnCommand, EMinesweeper3DSharedCommand, int32);
+
+	FMinesweeper3DSharedBoard(const FString& Name, int32 MaxCells);
+	~FMinesweeper3DSharedBoard();
+
+	//Whether the segment could be mapped
+	bool IsValid() const { return Header != nullptr; }
+
+	//Each command taken off the ring, with the cell it's for
+	FOnCommand OnCommand;
+
+	//Writes the whole board, for a new one or one too changed to go by deltas
+	void PublishBoard(const FMinesweeper3DBoard& Board);
+
+	//Writes the cells a delta changed, already applied to the board it was published from
+	void PublishDelta(const FMinesweeper3DBoardDelta& Delta);
+
+	void PublishStatus(int32 NumMines, int32 MinesRemaining, int32 ElapsedTime, bool bGameWon, bool bGameLost);
+
+	//No board to show, for endless games
+	void Clear();
+
+private:
+	void OnBeginFrame();
+
+	void BeginWrite();
+	void EndWrite();
+
+	FPlatformMemory::FSharedMemoryRegion* Region = nullptr;
+	FMinesweeper3DSharedBoardHeader* Header = nullptr;
+	int8* Cells = nullptr;
+	FMinesweeper3DSharedCommandEntry* Commands = nullptr;
+
+	//The outside process can write anywhere in the segment, so the game keeps its own copy of everything it publishes
+	//there and only ever reads the command head and entries back, bounds checked against these
+	int32 CellCapacity = 0;
+	int32 NumCells = 0;
+	int32 Sequence = 0;
+	int32 BoardId = 0;
+	int32 CommandTail = 0;
+	int32 CommandsDone = 0;
+
+	FDelegateHandle BeginFrameHandle;
+};